@@ -0,0 +1,109 @@
+// bench_manifest_parse.cpp - Parse a synthetic many-component manifest: a full nlohmann DOM
+// versus the streaming parser, and the selected slot's index and lookups.
+//
+// Usage: bench_manifest_parse [components] [slots] [rounds]
+
+#include "ota/ota_install_services.hpp"
+#include "util/manifest_parser.hpp"
+#include "util/manifest_selector.hpp"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <nlohmann/json.hpp>
+#include <string>
+#include <utility>
+
+namespace {
+
+std::string BuildManifest(unsigned components, unsigned slots) {
+    std::string out = R"({"version":"5.1.0","hw_compatibility":"board")";
+    for (unsigned s = 0; s < slots; ++s) {
+        out += ",\"slot-" + std::string(1, static_cast<char>('a' + s)) + "\":{\"components\":[";
+        for (unsigned i = 0; i < components; ++i) {
+            const std::string n = std::to_string(i);
+            if (i > 0)
+                out += ',';
+            out += R"({"name":"cfg)" + n + R"(","type":"file","filename":"etc/app/dir)" +
+                   std::to_string(i / 100) + "/file" + n + R"(.conf","path":"/etc/app/dir)" +
+                   std::to_string(i / 100) + "/file" + n + R"(.conf","sha256":")" +
+                   std::string(64, static_cast<char>('a' + i % 6)) +
+                   R"(","size":2048,"version":"5.1.0","permissions":"0644"})";
+        }
+        out += "]}";
+    }
+    out += '}';
+    return out;
+}
+
+template <typename F> double BestMs(unsigned rounds, F&& f) {
+    double best = 0;
+    for (unsigned r = 0; r < rounds; ++r) {
+        const auto t0 = std::chrono::steady_clock::now();
+        f();
+        const double ms =
+            std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - t0)
+                .count();
+        if (r == 0 || ms < best)
+            best = ms;
+    }
+    return best;
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    const unsigned components = argc > 1 ? static_cast<unsigned>(std::atoi(argv[1])) : 10000;
+    const unsigned slots = argc > 2 ? static_cast<unsigned>(std::atoi(argv[2])) : 2;
+    const unsigned rounds = argc > 3 ? static_cast<unsigned>(std::atoi(argv[3])) : 5;
+
+    const std::string json = BuildManifest(components, slots);
+    std::printf("manifest: %u components x %u slots (%zu bytes)\n", components, slots, json.size());
+
+    flash::DeviceConfig device;
+    device.current_slot = "slot-a";
+    device.hw_compatibility = "board";
+
+    std::size_t sink = 0;
+    const double dom = BestMs(rounds, [&] { sink += nlohmann::json::parse(json).size(); });
+
+    const double all = BestMs(rounds, [&] {
+        auto m = flash::ManifestParser().Parse(json);
+        if (!m) {
+            std::fprintf(stderr, "parse failed: %s\n", m.error().c_str());
+            std::exit(1);
+        }
+        sink += m->slot_components.size();
+    });
+
+    flash::Manifest selected;
+    const double slot = BestMs(rounds, [&] {
+        auto m = flash::ManifestParser().Parse(json, flash::ManifestParser::Options{"slot-a"});
+        if (!m || !flash::ManifestSelector::SelectForDevice(std::move(*m), device, selected)
+                       .is_ok()) {
+            std::fprintf(stderr, "slot parse failed\n");
+            std::exit(1);
+        }
+    });
+
+    const double index = BestMs(rounds, [&] {
+        const flash::ComponentIndex idx(selected);
+        sink += idx.EntriesByFilename().size();
+    });
+
+    const flash::ComponentIndex idx(selected);
+    const double lookups = BestMs(rounds, [&] {
+        for (const auto& c : selected.components)
+            sink += idx.Find(std::string_view(c.filename)) != nullptr;
+    });
+
+    std::printf("%-22s %9.2f ms\n", "nlohmann DOM only", dom);
+    std::printf("%-22s %9.2f ms\n", "streaming, all slots", all);
+    std::printf("%-22s %9.2f ms\n", "streaming, one slot", slot);
+    std::printf("%-22s %9.2f ms\n", "index build", index);
+    std::printf("%-22s %9.2f ms %8.1f ns/lookup\n",
+                "index lookups",
+                lookups,
+                lookups * 1e6 / selected.components.size());
+    return sink == 0;
+}
@@ -0,0 +1,118 @@
+// bench_small_file_extract.cpp - Extract a synthetic many-small-files archive with and without
+// io_uring batching.
+//
+// Usage: bench_small_file_extract [files] [file_bytes] [work_dir]
+
+#include "io/io.hpp"
+#include "ota/extract_stats.hpp"
+#include "ota/tar_stream_extractor.hpp"
+#include "util/logger.hpp"
+
+#include <algorithm>
+#include <archive.h>
+#include <archive_entry.h>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <string>
+#include <vector>
+
+namespace {
+
+class MemoryReader final : public flash::IReader {
+  public:
+    explicit MemoryReader(const std::vector<std::uint8_t>& data) : data_(data) {}
+
+    ssize_t Read(std::span<std::uint8_t> out) override {
+        const size_t n = std::min(out.size(), data_.size() - pos_);
+        std::copy_n(data_.begin() + static_cast<std::ptrdiff_t>(pos_), n, out.begin());
+        pos_ += n;
+        return static_cast<ssize_t>(n);
+    }
+
+  private:
+    const std::vector<std::uint8_t>& data_;
+    size_t pos_ = 0;
+};
+
+std::vector<std::uint8_t> BuildArchive(unsigned files, size_t file_bytes) {
+    std::vector<std::uint8_t> out(static_cast<size_t>(files) * (file_bytes + 2048) + (1 << 20));
+    size_t used = 0;
+    archive* a = archive_write_new();
+    archive_write_set_format_ustar(a);
+    archive_write_open_memory(a, out.data(), out.size(), &used);
+
+    std::string payload(file_bytes, 'x');
+    const unsigned per_dir = 100;
+    for (unsigned i = 0; i < files; ++i) {
+        archive_entry* e = archive_entry_new();
+        if (i % per_dir == 0) {
+            const std::string dir = "dir" + std::to_string(i / per_dir);
+            archive_entry_set_pathname(e, dir.c_str());
+            archive_entry_set_filetype(e, AE_IFDIR);
+            archive_entry_set_perm(e, 0755);
+            archive_write_header(a, e);
+            archive_entry_clear(e);
+        }
+        const std::string path =
+            "dir" + std::to_string(i / per_dir) + "/file" + std::to_string(i) + ".conf";
+        payload[0] = static_cast<char>('a' + i % 26);
+        archive_entry_set_pathname(e, path.c_str());
+        archive_entry_set_filetype(e, AE_IFREG);
+        archive_entry_set_perm(e, 0644);
+        archive_entry_set_mtime(e, 1700000000, 0);
+        archive_entry_set_size(e, static_cast<la_int64_t>(payload.size()));
+        archive_write_header(a, e);
+        archive_write_data(a, payload.data(), payload.size());
+        archive_entry_free(e);
+    }
+    archive_write_close(a);
+    archive_write_free(a);
+    out.resize(used);
+    return out;
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    namespace fs = std::filesystem;
+    const unsigned files = argc > 1 ? static_cast<unsigned>(std::atoi(argv[1])) : 20000;
+    const size_t file_bytes = argc > 2 ? static_cast<size_t>(std::atoi(argv[2])) : 2048;
+    const fs::path work = argc > 3 ? fs::path(argv[3]) : fs::temp_directory_path();
+
+    flash::Logger::Instance().SetLevel(flash::LogLevel::Warn);
+    const auto tar = BuildArchive(files, file_bytes);
+    std::printf("archive: %u files x %zu bytes (%zu bytes)\n", files, file_bytes, tar.size());
+
+    for (const bool batch : {false, true}) {
+        const fs::path dst = work / (batch ? "bench-uring" : "bench-sync");
+        fs::remove_all(dst);
+        fs::create_directories(dst);
+
+        flash::ExtractStats stats;
+        flash::TarStreamExtractor::Options opt;
+        opt.progress = false;
+        opt.batch_small_files = batch;
+        opt.stats_out = &stats;
+        MemoryReader reader(tar);
+
+        const auto t0 = std::chrono::steady_clock::now();
+        auto res = flash::TarStreamExtractor(opt).ExtractToDir(reader, dst.string(), "bench");
+        const auto ms = std::chrono::duration<double, std::milli>(
+                            std::chrono::steady_clock::now() - t0)
+                            .count();
+        if (!res.is_ok()) {
+            std::fprintf(stderr, "extract failed: %s\n", res.msg.c_str());
+            return 1;
+        }
+        std::printf("%-6s %9.1f ms %10.0f files/s  batched=%llu submits=%llu\n",
+                    batch ? "uring" : "sync",
+                    ms,
+                    files / (ms / 1000.0),
+                    (unsigned long long)stats.batched_files,
+                    (unsigned long long)stats.batch_submits);
+        fs::remove_all(dst);
+    }
+    return 0;
+}
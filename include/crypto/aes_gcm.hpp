@@ -0,0 +1,75 @@
+#pragma once
+
+#include "util/result.hpp"
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <span>
+#include <string>
+#include <vector>
+
+namespace flash {
+
+// Chunked AES-256-GCM payloads ("encryption": "aes-256-gcm" in the manifest).
+//
+//   header:  "FLASHGCM" | chunk bytes (u32 LE) | base nonce (12 bytes)
+//   chunks:  ciphertext (chunk bytes, the last one may be shorter or empty) | tag (16 bytes)
+//
+// Chunk i uses the base nonce with i XORed into its last 8 bytes (big endian), and
+// authenticates i plus a final-chunk flag as AAD, so chunks cannot be reordered, dropped or
+// truncated without a tag failure. OpenSSL picks the AES-NI / ARMv8 crypto extension paths.
+
+using AesGcmKey = std::array<std::uint8_t, 32>;
+using AesGcmNonce = std::array<std::uint8_t, 12>;
+
+inline constexpr std::size_t kAesGcmTagBytes = 16;
+inline constexpr std::size_t kChunkedGcmHeaderBytes = 24;
+inline constexpr std::uint32_t kDefaultGcmChunkBytes = 64 * 1024;
+// Bounds what a header can make a reader allocate.
+inline constexpr std::uint32_t kMaxGcmChunkBytes = 16 * 1024 * 1024;
+
+struct ChunkedGcmHeader {
+    std::uint32_t chunk_bytes = kDefaultGcmChunkBytes;
+    AesGcmNonce nonce{};
+};
+
+Result ParseChunkedGcmHeader(std::span<const std::uint8_t> in, ChunkedGcmHeader& out);
+
+// Raw 32 bytes, or 64 hex digits optionally followed by a newline.
+Result LoadAesGcmKeyFile(const std::string& path, AesGcmKey& out);
+
+// One chunk at a time; keeps the EVP context between chunks.
+class AesGcmChunkCipher {
+  public:
+    AesGcmChunkCipher();
+    AesGcmChunkCipher(const AesGcmChunkCipher&) = delete;
+    AesGcmChunkCipher& operator=(const AesGcmChunkCipher&) = delete;
+    ~AesGcmChunkCipher();
+
+    Result Init(const AesGcmKey& key, const AesGcmNonce& base_nonce);
+
+    // `in` is ciphertext followed by its tag; the plaintext may overwrite it in place.
+    Result Decrypt(std::uint64_t index,
+                   bool final_chunk,
+                   std::span<const std::uint8_t> in,
+                   std::uint8_t* out);
+    // Writes ciphertext followed by the tag (in.size() + kAesGcmTagBytes bytes).
+    Result Encrypt(std::uint64_t index,
+                   bool final_chunk,
+                   std::span<const std::uint8_t> in,
+                   std::uint8_t* out);
+
+  private:
+    struct Impl;
+    std::unique_ptr<Impl> impl_;
+};
+
+// Builds a whole encrypted payload; for bundle tooling and tests.
+Result EncryptChunkedAesGcm(const AesGcmKey& key,
+                            const ChunkedGcmHeader& header,
+                            std::span<const std::uint8_t> plaintext,
+                            std::vector<std::uint8_t>& out);
+
+} // namespace flash
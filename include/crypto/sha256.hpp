@@ -7,12 +7,19 @@
 #include <memory>
 #include <span>
 #include <string>
+#include <string_view>
+#include <vector>
 
 namespace flash {
 
 std::string Sha256Hex(std::span<const std::uint8_t> data);
 std::string Sha256Hex(IReader& reader);
 Result Sha256HexFile(const std::string& path, std::string& out_hex);
+// Compares hex digests ignoring case; manifests may carry upper-case digests.
+bool Sha256HexEquals(std::string_view a, std::string_view b);
+// One digest per chunk_bytes of `data` (the manifest "chunk-sha256" list).
+std::vector<std::string> Sha256HexChunks(std::span<const std::uint8_t> data,
+                                         std::uint64_t chunk_bytes);
 
 class Sha256Hasher {
   public:
@@ -0,0 +1,101 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <span>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+namespace flash {
+
+// Process-wide source of I/O buffers for the streaming pipeline (bundle reader, gzip, staging,
+// writers). Buffers are aligned (page size at least), optionally backed by transparent huge
+// pages and locked in memory, and go back to the pool for reuse when released, so
+// allocations stay off the per-component path.
+class BufferPool {
+  public:
+    // Buffer size per pipeline stage.
+    struct Sizes {
+        std::size_t archive_read = 64 * 1024;
+        std::size_t gzip_input = 64 * 1024;
+        std::size_t staging = 1024 * 1024;
+        std::size_t pipe = 1024 * 1024;
+        std::size_t drain = 64 * 1024;
+    };
+
+    struct Options {
+        Sizes sizes{};
+        // Pipe buffer size for specific targets (device or file path), e.g. a multiple of a
+        // flash erase block.
+        std::unordered_map<std::string, std::size_t> pipe_by_target;
+        // Raised to the page size when smaller.
+        std::size_t alignment = 4096;
+        // madvise(MADV_HUGEPAGE) for buffers of at least 2 MiB.
+        bool huge_pages = false;
+        // mlock() buffers; failures (e.g. RLIMIT_MEMLOCK) are logged once and ignored.
+        bool lock = false;
+        // Released buffers kept per size.
+        std::size_t max_idle_per_size = 8;
+    };
+
+    // Move-only lease; the memory goes back to the pool when it is destroyed.
+    class Buffer {
+      public:
+        Buffer() = default;
+        Buffer(const Buffer&) = delete;
+        Buffer& operator=(const Buffer&) = delete;
+        Buffer(Buffer&& other) noexcept;
+        Buffer& operator=(Buffer&& other) noexcept;
+        ~Buffer();
+
+        std::uint8_t* data() const { return data_; }
+        std::size_t size() const { return size_; }
+        std::span<std::uint8_t> Span() const { return {data_, size_}; }
+
+      private:
+        friend class BufferPool;
+        Buffer(BufferPool* pool, std::uint8_t* data, std::size_t size)
+            : pool_(pool), data_(data), size_(size) {}
+        void Reset();
+
+        BufferPool* pool_ = nullptr;
+        std::uint8_t* data_ = nullptr;
+        std::size_t size_ = 0;
+    };
+
+    static BufferPool& Instance();
+
+    BufferPool() = default;
+    BufferPool(const BufferPool&) = delete;
+    BufferPool& operator=(const BufferPool&) = delete;
+    ~BufferPool();
+
+    // Drops idle buffers; outstanding ones are returned under the new settings.
+    void Configure(Options opt);
+    Sizes GetSizes() const;
+    std::size_t PipeBytes(std::string_view target) const;
+
+    // Returns at least `size` bytes (rounded up to the alignment); nullptr data on failure.
+    Buffer Acquire(std::size_t size);
+
+    // Buffers currently idle in the pool, for statistics and tests.
+    std::size_t Idle() const;
+
+  private:
+    std::size_t Alignment(std::size_t size) const;
+    std::size_t RoundUp(std::size_t size) const;
+    std::uint8_t* Allocate(std::size_t size);
+    void Free(std::uint8_t* data, std::size_t size);
+    void Release(std::uint8_t* data, std::size_t size);
+
+    mutable std::mutex mu_;
+    Options opt_{};
+    std::map<std::size_t, std::vector<std::uint8_t*>> idle_;
+    bool lock_warned_ = false;
+};
+
+} // namespace flash
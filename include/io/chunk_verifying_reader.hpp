@@ -0,0 +1,90 @@
+#pragma once
+
+#include "io/buffer_pool.hpp"
+#include "io/io.hpp"
+#include "util/result.hpp"
+
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <span>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace flash {
+
+// Checks a stream against a list of per-chunk SHA-256 digests ("chunk-sha256") and only hands
+// out chunks that matched, so a bad chunk stops an install before any of it is written. The
+// chunks after the one being consumed are read ahead and hashed on a small thread pool.
+class ChunkVerifyingReader final : public IReader {
+  public:
+    struct Options {
+        // Hashing threads; 0 uses up to 4 of the available cores.
+        unsigned threads = 0;
+        // Caps the chunk buffers held at once (fewer chunks are read ahead); 0 is no cap. Open
+        // fails when not even two chunks fit.
+        std::uint64_t max_buffer_bytes = 0;
+    };
+
+    ChunkVerifyingReader() = default;
+    ChunkVerifyingReader(const ChunkVerifyingReader&) = delete;
+    ChunkVerifyingReader& operator=(const ChunkVerifyingReader&) = delete;
+    ~ChunkVerifyingReader() override;
+
+    static Result Open(std::unique_ptr<IReader> source,
+                       std::uint64_t chunk_bytes,
+                       std::vector<std::string> chunk_sha256,
+                       const Options& opt,
+                       ChunkVerifyingReader& out);
+
+    ssize_t Read(std::span<std::uint8_t> out) override;
+    // Lends the verified chunk.
+    ssize_t ReadView(std::span<const std::uint8_t>& view, std::span<std::uint8_t> scratch) override;
+    std::optional<std::uint64_t> TotalSize() const override {
+        return source_ ? source_->TotalSize() : std::nullopt;
+    }
+
+    // Why the last read failed.
+    std::string Error() const;
+
+  private:
+    enum class State { Free, Hashing, Good, Bad };
+    struct Slot {
+        BufferPool::Buffer buffer;
+        std::size_t size = 0;
+        std::uint64_t index = 0;
+        State state = State::Free;
+    };
+
+    void HashLoop();
+    // Reads the next chunk into the free slot after the queued ones and queues it for hashing.
+    // Called without the lock; false on a read error or a length mismatch.
+    bool ReadAhead();
+    bool NextChunk(ssize_t& status);
+    void Fail(std::string msg);
+
+    std::unique_ptr<IReader> source_;
+    std::size_t chunk_bytes_ = 0;
+    std::vector<std::string> expected_;
+
+    mutable std::mutex mu_;
+    std::condition_variable cv_;
+    std::vector<Slot> slots_;
+    std::size_t head_ = 0;   // Oldest queued chunk, the one being consumed.
+    std::size_t queued_ = 0; // Chunks read and not yet drained.
+    std::deque<std::size_t> work_;
+    std::uint64_t chunks_read_ = 0;
+    bool eof_ = false;
+    bool stop_ = false;
+    std::string error_;
+
+    std::size_t pos_ = 0;
+    std::vector<std::thread> hashers_;
+};
+
+} // namespace flash
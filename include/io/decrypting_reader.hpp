@@ -0,0 +1,87 @@
+#pragma once
+
+#include "crypto/aes_gcm.hpp"
+#include "io/buffer_pool.hpp"
+#include "io/io.hpp"
+#include "util/result.hpp"
+
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <span>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace flash {
+
+// Decrypts a chunked AES-256-GCM payload (see aes_gcm.hpp) on a worker thread, which reads
+// and authenticates up to kMaxSlots chunks ahead of the consumer. Only authenticated plaintext
+// is handed out; a bad chunk or a truncated stream fails the read.
+class DecryptingReader final : public IReader {
+  public:
+    static constexpr std::size_t kMaxSlots = 4;
+
+    struct Options {
+        // Caps the chunk buffers held at once: the worker keeps two besides the decrypted
+        // slots, so fewer chunks are decrypted ahead; 0 is no cap. Open fails when not even
+        // one slot fits.
+        std::uint64_t max_buffer_bytes = 0;
+    };
+
+    DecryptingReader() = default;
+    DecryptingReader(const DecryptingReader&) = delete;
+    DecryptingReader& operator=(const DecryptingReader&) = delete;
+    ~DecryptingReader() override;
+
+    // Reads and checks the header, then starts the worker.
+    static Result Open(std::unique_ptr<IReader> source,
+                       const AesGcmKey& key,
+                       const Options& opt,
+                       DecryptingReader& out);
+
+    ssize_t Read(std::span<std::uint8_t> out) override;
+    // Lends the decrypted chunk.
+    ssize_t ReadView(std::span<const std::uint8_t>& view, std::span<std::uint8_t> scratch) override;
+    // Plaintext size, derived from the source size.
+    std::optional<std::uint64_t> TotalSize() const override;
+
+    // Why the last read failed.
+    std::string Error() const;
+
+  private:
+    struct Slot {
+        BufferPool::Buffer buffer;
+        std::size_t size = 0;
+    };
+
+    void Run();
+    // Fills `buf` with up to one encrypted chunk; returns the bytes read or -1.
+    ssize_t ReadChunk(BufferPool::Buffer& buf);
+    void Fail(std::string msg);
+    // Makes sure the consumer holds a chunk with bytes left; false at the end or on error.
+    bool NextChunk(ssize_t& status);
+
+    std::unique_ptr<IReader> source_;
+    ChunkedGcmHeader header_{};
+    AesGcmChunkCipher cipher_;
+    std::size_t encrypted_chunk_bytes_ = 0;
+
+    mutable std::mutex mu_;
+    std::condition_variable cv_;
+    std::vector<Slot> slots_;
+    std::size_t head_ = 0;  // Oldest decrypted slot.
+    std::size_t ready_ = 0; // Decrypted slots not yet drained by the consumer.
+    bool done_ = false;
+    bool stop_ = false;
+    std::string error_;
+
+    // Consumer side: read position in slots_[head_].
+    std::size_t pos_ = 0;
+    std::thread worker_;
+};
+
+} // namespace flash
@@ -17,11 +17,13 @@ class FileOrStdinReader final : public IReader {
 
     std::optional<std::uint64_t> TotalSize() const override;
     ssize_t Read(std::span<std::uint8_t> out) override;
+    std::int64_t Skip(std::uint64_t n) override;
 
   private:
     std::string path_;
     Fd fd_;
     std::optional<std::uint64_t> size_;
+    bool seekable_ = false;
 };
 
 } // namespace flash
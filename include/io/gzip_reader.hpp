@@ -1,27 +1,113 @@
 #pragma once
 
+#include "io/buffer_pool.hpp"
 #include "io/io.hpp"
 
+#include <cstddef>
+#include <cstdint>
 #include <memory>
-#include <vector>
+#include <span>
 #include <zlib.h>
 
 namespace flash {
 
+// gzip decoding state shared by GzipReader and InflateStage. Source is anything with
+// ReadView(), an IReader or a reader stage. Not movable: zlib keeps a pointer to strm_.
+class GzipInflater {
+  public:
+    // Throws std::runtime_error when the input buffer or zlib cannot be set up.
+    GzipInflater();
+    GzipInflater(const GzipInflater&) = delete;
+    GzipInflater& operator=(const GzipInflater&) = delete;
+    ~GzipInflater();
+
+    template <typename Source> ssize_t Read(Source& source, std::span<std::uint8_t> out);
+
+  private:
+    z_stream strm_{};
+    BufferPool::Buffer in_buffer_;
+    bool eof_reached_ = false;
+    bool drained_source_ = false;
+};
+
 class GzipReader final : public IReader {
   public:
     explicit GzipReader(std::unique_ptr<IReader> source);
-    ~GzipReader() override;
 
     // Implementation of IReader
     ssize_t Read(std::span<std::uint8_t> out) override;
 
   private:
     std::unique_ptr<IReader> source_;
-    z_stream strm_{};
-    std::vector<std::uint8_t> in_buffer_;
-    bool eof_reached_ = false;
-    bool drained_source_ = false;
+    GzipInflater inflater_;
 };
 
+template <typename Source>
+ssize_t GzipInflater::Read(Source& source, std::span<std::uint8_t> out) {
+    if (eof_reached_)
+        return 0;
+
+    strm_.next_out = out.data();
+    strm_.avail_out = static_cast<uInt>(out.size());
+
+    while (strm_.avail_out > 0) {
+        if (strm_.avail_in == 0) {
+            // The view stays valid until the next source read, which only happens once zlib
+            // has consumed all of it.
+            std::span<const std::uint8_t> in;
+            ssize_t n = source.ReadView(in, in_buffer_.Span());
+            if (n < 0)
+                return -1;
+            if (n == 0) {
+                // Source exhausted. If zlib hasn't finished, it's a truncated file.
+                break;
+            }
+            strm_.avail_in = static_cast<uInt>(n);
+            strm_.next_in = const_cast<Bytef*>(in.data());
+        }
+
+        int ret = inflate(&strm_, Z_NO_FLUSH);
+
+        if (ret == Z_STREAM_END) {
+            eof_reached_ = true;
+            if (!drained_source_) {
+                // Discard any buffered compressed bytes.
+                strm_.avail_in = 0;
+
+                // Drain remaining source bytes so downstream hash sees full entry.
+                while (true) {
+                    std::span<const std::uint8_t> discarded;
+                    const ssize_t n = source.ReadView(discarded, in_buffer_.Span());
+                    if (n < 0)
+                        return -1;
+                    if (n == 0)
+                        break;
+                }
+                drained_source_ = true;
+            }
+            break;
+        }
+
+        // Z_BUF_ERROR is not fatal; it just means we need more input or output space.
+        if (ret != Z_OK && ret != Z_BUF_ERROR) {
+            return -1;
+        }
+
+        // If we made no progress and have no more input, stop to avoid infinite loop
+        if (ret == Z_BUF_ERROR && strm_.avail_in == 0) {
+            break;
+        }
+    }
+
+    size_t produced = out.size() - strm_.avail_out;
+
+    // Safety: If we produced 0 bytes but haven't reached Z_STREAM_END,
+    // and the source is dead, then it's an actual error/EOF.
+    if (produced == 0 && !eof_reached_) {
+        return 0;
+    }
+
+    return static_cast<ssize_t>(produced);
+}
+
 } // namespace flash
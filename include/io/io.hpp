@@ -2,6 +2,7 @@
 
 #include "util/result.hpp"
 
+#include <cstddef>
 #include <cstdint>
 #include <optional>
 #include <span>
@@ -14,12 +15,37 @@ class IReader {
     virtual ~IReader() = default;
     virtual ssize_t Read(std::span<std::uint8_t> out) = 0;
     virtual std::optional<std::uint64_t> TotalSize() const { return std::nullopt; }
+    // Advances past up to n bytes without reading them. Returns the number skipped, 0 when
+    // the reader cannot seek (callers read and discard instead) or -1 on error.
+    virtual std::int64_t Skip(std::uint64_t n) {
+        (void)n;
+        return 0;
+    }
+    // Zero-copy read: points `view` at up to scratch.size() bytes that stay valid until the
+    // next call on this reader. Readers with their own buffers lend them; the default copies
+    // into `scratch`. Returns the view size, 0 at end of input or -1 on error.
+    virtual ssize_t ReadView(std::span<const std::uint8_t>& view,
+                             std::span<std::uint8_t> scratch) {
+        const ssize_t n = Read(scratch);
+        view = n > 0 ? scratch.first(static_cast<std::size_t>(n)) : std::span<std::uint8_t>();
+        return n;
+    }
 };
 
 class IWriter {
   public:
     virtual ~IWriter() = default;
     virtual Result WriteAll(std::span<const std::uint8_t> in) = 0;
+    // Writes the buffers back to back. Writers backed by a descriptor do it in one vectored
+    // syscall; the default writes them one by one.
+    virtual Result WriteV(std::span<const std::span<const std::uint8_t>> in) {
+        for (const auto& piece : in) {
+            auto r = WriteAll(piece);
+            if (!r.is_ok())
+                return r;
+        }
+        return Result::Ok();
+    }
     virtual Result FsyncNow() = 0;
 };
 
@@ -0,0 +1,45 @@
+#pragma once
+
+#include "io/io.hpp"
+#include "util/result.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <span>
+#include <string>
+
+namespace flash {
+
+// Reads a regular file (or memfd) through a read-only mapping advised MADV_SEQUENTIAL, so the
+// kernel reads ahead aggressively. Pages behind the reader are unmapped every
+// kReleaseBehindBytes, which keeps a multi-GB staged entry from growing the resident set.
+// Used for staged entries.
+class MmapReader final : public IReader {
+  public:
+    MmapReader() = default;
+    MmapReader(const MmapReader&) = delete;
+    MmapReader& operator=(const MmapReader&) = delete;
+    ~MmapReader() override;
+
+    static Result Open(const std::string& path, MmapReader& out);
+
+    ssize_t Read(std::span<std::uint8_t> out) override;
+    // Lends the mapping itself.
+    ssize_t ReadView(std::span<const std::uint8_t>& view, std::span<std::uint8_t> scratch) override;
+    std::optional<std::uint64_t> TotalSize() const override;
+    std::int64_t Skip(std::uint64_t n) override;
+
+    static constexpr std::size_t kReleaseBehindBytes = 2 * 1024 * 1024;
+
+  private:
+    void Unmap();
+    void ReleaseBehind();
+
+    const std::uint8_t* data_ = nullptr;
+    std::size_t size_ = 0;
+    std::size_t pos_ = 0;
+    std::size_t released_ = 0;
+};
+
+} // namespace flash
@@ -4,6 +4,7 @@
 #include "io/io.hpp"
 #include "util/result.hpp"
 
+#include <cstdint>
 #include <span>
 #include <string>
 
@@ -13,9 +14,21 @@ class PartitionWriter final : public IWriter {
   public:
     static Result Open(std::string path, PartitionWriter& out);
 
+    // Reopens a partially written target and continues at `offset` (used to resume). Regular
+    // files are not truncated first and must already hold at least `offset` bytes.
+    static Result OpenAt(std::string path, std::uint64_t offset, PartitionWriter& out);
+
     Result WriteAll(std::span<const std::uint8_t> in) override;
+    // writev(), resubmitting the remainder after a short write.
+    Result WriteV(std::span<const std::span<const std::uint8_t>> in) override;
     Result FsyncNow() override;
 
+    // Kicks off writeback of everything written so far without waiting for it, so a later
+    // FsyncNow() has little left to do.
+    Result StartWriteback();
+
+    const std::string& Path() const { return path_; }
+
   private:
     std::string path_;
     Fd fd_;
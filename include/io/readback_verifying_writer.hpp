@@ -0,0 +1,68 @@
+#pragma once
+
+#include "crypto/sha256.hpp"
+#include "io/fd.hpp"
+#include "io/io.hpp"
+#include "util/result.hpp"
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+
+namespace flash {
+
+// Forwards writes to an inner writer and, after every FsyncNow(), re-reads the range that was
+// just made durable from the target on a background thread and compares chunk hashes. Read
+// back runs in parallel with further writes; the first mismatch fails the next write.
+class ReadbackVerifyingWriter final : public IWriter {
+  public:
+    explicit ReadbackVerifyingWriter(IWriter& inner);
+    ReadbackVerifyingWriter(const ReadbackVerifyingWriter&) = delete;
+    ReadbackVerifyingWriter& operator=(const ReadbackVerifyingWriter&) = delete;
+    ~ReadbackVerifyingWriter() override;
+
+    // Opens target_path for reading back and starts the verifier thread.
+    Result Start(const std::string& target_path);
+
+    Result WriteAll(std::span<const std::uint8_t> in) override;
+    Result WriteV(std::span<const std::span<const std::uint8_t>> in) override;
+    Result FsyncNow() override;
+
+    // Syncs outstanding data, waits until every chunk has been verified and reports the result.
+    Result Finish();
+
+    std::uint64_t VerifiedBytes() const { return verified_bytes_.load(); }
+
+  private:
+    struct Chunk {
+        std::uint64_t offset = 0;
+        std::uint64_t length = 0;
+        std::string sha256;
+    };
+
+    void WorkerLoop();
+    Result VerifyChunk(const Chunk& chunk);
+    void StopWorker();
+    Result FailureIfAny();
+
+    IWriter& inner_;
+    Fd readback_fd_;
+    Sha256Hasher hasher_;
+    std::uint64_t pending_offset_ = 0;
+    std::uint64_t pending_length_ = 0;
+
+    std::mutex mu_;
+    std::condition_variable cv_;
+    std::deque<Chunk> queue_;
+    bool stop_ = false;
+    std::atomic_bool failed_{false};
+    Result failure_;
+    std::atomic<std::uint64_t> verified_bytes_{0};
+    std::thread worker_;
+};
+
+} // namespace flash
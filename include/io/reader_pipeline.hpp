@@ -0,0 +1,222 @@
+#pragma once
+
+#include "crypto/sha256.hpp"
+#include "io/gzip_reader.hpp"
+#include "io/io.hpp"
+
+#include <concepts>
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <span>
+#include <string>
+#include <sys/types.h>
+#include <utility>
+
+namespace flash {
+
+// Reader stages composed at compile time. Each stage holds the next one by value and calls it
+// directly, so a stack such as ProgressStage<InflateStage<CountStage<SourceStage>>> costs one
+// virtual call (into the source) per read. PipelineReader turns a finished stack back into an
+// IReader for code that takes one.
+
+template <typename S>
+concept ReaderStage = requires(S& s,
+                               const S& cs,
+                               std::span<std::uint8_t> out,
+                               std::span<const std::uint8_t>& view,
+                               std::uint64_t n) {
+    { s.Read(out) } -> std::same_as<ssize_t>;
+    { s.ReadView(view, out) } -> std::same_as<ssize_t>;
+    { s.Skip(n) } -> std::same_as<std::int64_t>;
+    { cs.TotalSize() } -> std::same_as<std::optional<std::uint64_t>>;
+};
+
+// A stack that contains a CountStage reports the source bytes consumed so far.
+template <typename S>
+concept CountsInput = requires(const S& s) {
+    { s.Consumed() } -> std::same_as<std::uint64_t>;
+    { s.ConsumedCounter() } -> std::same_as<const std::uint64_t*>;
+};
+
+// Bottom of every stack: the virtual source (bundle entry, staged file, stdin).
+class SourceStage {
+  public:
+    explicit SourceStage(std::unique_ptr<IReader> source) : source_(std::move(source)) {}
+
+    ssize_t Read(std::span<std::uint8_t> out) { return source_->Read(out); }
+    ssize_t ReadView(std::span<const std::uint8_t>& view, std::span<std::uint8_t> scratch) {
+        return source_->ReadView(view, scratch);
+    }
+    std::int64_t Skip(std::uint64_t n) { return source_->Skip(n); }
+    std::optional<std::uint64_t> TotalSize() const { return source_->TotalSize(); }
+
+  private:
+    std::unique_ptr<IReader> source_;
+};
+
+// Counts the bytes read (or skipped) from below.
+template <ReaderStage Inner> class CountStage {
+  public:
+    explicit CountStage(Inner inner) : inner_(std::move(inner)) {}
+
+    ssize_t Read(std::span<std::uint8_t> out) { return Add(inner_.Read(out)); }
+    ssize_t ReadView(std::span<const std::uint8_t>& view, std::span<std::uint8_t> scratch) {
+        return Add(inner_.ReadView(view, scratch));
+    }
+    std::int64_t Skip(std::uint64_t n) {
+        const std::int64_t k = inner_.Skip(n);
+        if (k > 0)
+            count_ += static_cast<std::uint64_t>(k);
+        return k;
+    }
+    std::optional<std::uint64_t> TotalSize() const { return inner_.TotalSize(); }
+
+    std::uint64_t Consumed() const { return count_; }
+    // Stable for the lifetime of the stage; handed to strategies as `in_read`.
+    const std::uint64_t* ConsumedCounter() const { return &count_; }
+
+  private:
+    ssize_t Add(ssize_t n) {
+        if (n > 0)
+            count_ += static_cast<std::uint64_t>(n);
+        return n;
+    }
+
+    Inner inner_;
+    std::uint64_t count_ = 0;
+};
+
+// gzip decoding. The decoded size is unknown and the stream cannot seek.
+template <ReaderStage Inner> class InflateStage {
+  public:
+    // Throws std::runtime_error like GzipReader.
+    explicit InflateStage(Inner inner)
+        : inner_(std::move(inner)), inflater_(std::make_unique<GzipInflater>()) {}
+
+    ssize_t Read(std::span<std::uint8_t> out) { return inflater_->Read(inner_, out); }
+    ssize_t ReadView(std::span<const std::uint8_t>& view, std::span<std::uint8_t> scratch) {
+        const ssize_t n = Read(scratch);
+        view = n > 0 ? scratch.first(static_cast<std::size_t>(n)) : std::span<std::uint8_t>();
+        return n;
+    }
+    std::int64_t Skip(std::uint64_t) { return 0; }
+    std::optional<std::uint64_t> TotalSize() const { return std::nullopt; }
+
+    std::uint64_t Consumed() const
+        requires CountsInput<Inner>
+    {
+        return inner_.Consumed();
+    }
+    const std::uint64_t* ConsumedCounter() const
+        requires CountsInput<Inner>
+    {
+        return inner_.ConsumedCounter();
+    }
+
+  private:
+    Inner inner_;
+    std::unique_ptr<GzipInflater> inflater_;
+};
+
+// SHA-256 of everything read through it. Refuses to skip, which would leave holes in the hash.
+template <ReaderStage Inner> class HashStage {
+  public:
+    explicit HashStage(Inner inner) : inner_(std::move(inner)) {}
+
+    ssize_t Read(std::span<std::uint8_t> out) {
+        const ssize_t n = inner_.Read(out);
+        if (n > 0)
+            hasher_.Update(out.first(static_cast<std::size_t>(n)));
+        return n;
+    }
+    ssize_t ReadView(std::span<const std::uint8_t>& view, std::span<std::uint8_t> scratch) {
+        const ssize_t n = inner_.ReadView(view, scratch);
+        if (n > 0)
+            hasher_.Update(view);
+        return n;
+    }
+    std::int64_t Skip(std::uint64_t) { return 0; }
+    std::optional<std::uint64_t> TotalSize() const { return inner_.TotalSize(); }
+
+    std::uint64_t Consumed() const
+        requires CountsInput<Inner>
+    {
+        return inner_.Consumed();
+    }
+    const std::uint64_t* ConsumedCounter() const
+        requires CountsInput<Inner>
+    {
+        return inner_.ConsumedCounter();
+    }
+
+    // Valid once the stream has been read to the end.
+    std::string FinalHex() { return hasher_.FinalHex(); }
+
+  private:
+    Inner inner_;
+    Sha256Hasher hasher_;
+};
+
+// Calls on_read(done) after every read or skip that made progress. `done` is the source bytes
+// consumed when the stack counts them, otherwise the bytes that passed through this stage.
+template <ReaderStage Inner, typename OnRead> class ProgressStage {
+  public:
+    ProgressStage(Inner inner, OnRead on_read)
+        : inner_(std::move(inner)), on_read_(std::move(on_read)) {}
+
+    ssize_t Read(std::span<std::uint8_t> out) { return Report(inner_.Read(out)); }
+    ssize_t ReadView(std::span<const std::uint8_t>& view, std::span<std::uint8_t> scratch) {
+        return Report(inner_.ReadView(view, scratch));
+    }
+    std::int64_t Skip(std::uint64_t n) { return Report(inner_.Skip(n)); }
+    std::optional<std::uint64_t> TotalSize() const { return inner_.TotalSize(); }
+
+    std::uint64_t Consumed() const
+        requires CountsInput<Inner>
+    {
+        return inner_.Consumed();
+    }
+    const std::uint64_t* ConsumedCounter() const
+        requires CountsInput<Inner>
+    {
+        return inner_.ConsumedCounter();
+    }
+
+  private:
+    template <typename N> N Report(N n) {
+        if (n <= 0)
+            return n;
+        passed_ += static_cast<std::uint64_t>(n);
+        if constexpr (CountsInput<Inner>)
+            on_read_(inner_.Consumed());
+        else
+            on_read_(passed_);
+        return n;
+    }
+
+    Inner inner_;
+    OnRead on_read_;
+    std::uint64_t passed_ = 0;
+};
+
+// The virtual boundary: exposes a composed stack as an IReader.
+template <ReaderStage Stack> class PipelineReader final : public IReader {
+  public:
+    explicit PipelineReader(Stack stack) : stack_(std::move(stack)) {}
+
+    ssize_t Read(std::span<std::uint8_t> out) override { return stack_.Read(out); }
+    ssize_t ReadView(std::span<const std::uint8_t>& view,
+                     std::span<std::uint8_t> scratch) override {
+        return stack_.ReadView(view, scratch);
+    }
+    std::int64_t Skip(std::uint64_t n) override { return stack_.Skip(n); }
+    std::optional<std::uint64_t> TotalSize() const override { return stack_.TotalSize(); }
+
+    Stack& Stages() { return stack_; }
+
+  private:
+    Stack stack_;
+};
+
+} // namespace flash
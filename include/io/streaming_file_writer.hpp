@@ -0,0 +1,45 @@
+#pragma once
+
+#include "io/fd.hpp"
+#include "io/io.hpp"
+#include "util/result.hpp"
+
+#include <cstdint>
+#include <span>
+#include <string>
+
+namespace flash {
+
+// Writer for large regular files. Preallocates the final size, starts writeback every
+// window_bytes with sync_file_range() and, once the previous window is on disk, drops it from
+// the page cache so a multi-GiB file does not evict everything else.
+class StreamingFileWriter final : public IWriter {
+  public:
+    struct Options {
+        std::uint64_t preallocate_bytes = 0;
+        std::uint64_t window_bytes = 8 * 1024 * 1024ULL;
+        bool drop_behind = true;
+    };
+
+    // Opens an existing file for writing; it is neither created nor truncated.
+    static Result Open(const std::string& path, const Options& opt, StreamingFileWriter& out);
+
+    Result WriteAt(std::span<const std::uint8_t> in, std::uint64_t offset);
+    Result WriteAll(std::span<const std::uint8_t> in) override;
+    Result FsyncNow() override;
+
+    // Starts writeback of the tail and closes the file. Does not wait for durability.
+    Result Close();
+
+  private:
+    Result AfterWrite(std::uint64_t end);
+
+    std::string path_;
+    Options opt_{};
+    Fd fd_;
+    std::uint64_t pos_ = 0;
+    std::uint64_t window_start_ = 0;
+    std::uint64_t flushed_start_ = 0;
+};
+
+} // namespace flash
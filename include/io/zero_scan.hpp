@@ -0,0 +1,25 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <vector>
+
+namespace flash {
+
+struct DataPiece {
+    std::uint64_t offset = 0;
+    std::span<const std::uint8_t> data;
+};
+
+bool IsAllZero(std::span<const std::uint8_t> data);
+
+// Splits data destined for file offset `offset` into the pieces that still have to be written.
+// Slices between multiples of block_bytes (in file offsets) that are entirely zero are dropped,
+// so skipping them leaves filesystem holes. Adjacent non-zero slices are merged.
+void SplitNonZero(std::span<const std::uint8_t> data,
+                  std::uint64_t offset,
+                  std::size_t block_bytes,
+                  std::vector<DataPiece>& out);
+
+} // namespace flash
@@ -5,12 +5,15 @@
 #include "util/result.hpp"
 
 #include <cstdint>
+#include <functional>
 #include <string>
 #include <string_view>
 #include <utility>
 
 namespace flash {
 
+class AsyncFinalizer;
+
 class ArchiveInstaller {
   public:
     struct Options {
@@ -26,9 +29,27 @@ class ArchiveInstaller {
         std::string mount_base_dir = "/mnt";
         std::string mount_prefix = "ota-";
         std::string fs_type = "ext4";
+        // Block device targets only: mkfs the partition before mounting instead of
+        // extracting over the previous contents.
+        bool format_before_mount = false;
 
         // Keep header portable: do NOT reference MS_* macros here.
         unsigned long mount_flags = 0;
+        // Filesystem specific mount(2) data, e.g. "commit=30" for ext4.
+        std::string mount_data;
+        // Named mount profile used only while extracting ("" or "bulk-extract"). The target is
+        // remounted with mount_flags/mount_data and synced before it is unmounted.
+        std::string mount_profile;
+
+        // Passed to TarStreamExtractor, except for ext4 under "bulk-extract", where syncfs is
+        // not a durability point. A resumed install never formats the target.
+        std::uint64_t resume_entries = 0;
+        std::function<Result(std::uint64_t bytes_done, std::uint64_t entries_done)> on_checkpoint;
+        // See TarStreamExtractor::Options::bounded_decoders.
+        bool bounded_decoders = false;
+
+        // Optional: block device targets are remounted, synced and unmounted there.
+        AsyncFinalizer* finalizer = nullptr;
     };
 
     ArchiveInstaller(); // default
@@ -0,0 +1,86 @@
+#pragma once
+
+#include "util/result.hpp"
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+namespace flash {
+
+// Runs the last steps of a component (final fsync, unmount, rename, chmod) on a background
+// thread, in submission order, so the next component does not wait for the previous flush.
+// Once a task fails the remaining ones are dropped; Barrier() reports the first failure.
+//
+// In group-commit mode commits are only collected; Barrier() then syncs all of them in
+// parallel and, only if every sync succeeded, publishes them in order, fsyncs their
+// directories once each and finally runs the plain tasks.
+class AsyncFinalizer {
+  public:
+    using Task = std::move_only_function<Result()>;
+
+    struct Options {
+        bool group_commit = false;
+    };
+
+    struct Commit {
+        Commit(std::string what_, Task sync_, Task publish_ = {}, std::string dir_ = {})
+            : what(std::move(what_)),
+              sync(std::move(sync_)),
+              publish(std::move(publish_)),
+              dir(std::move(dir_)) {}
+
+        std::string what;
+        // Makes the component's data durable.
+        Task sync;
+        // Optional, after sync: e.g. renames the component into place.
+        Task publish;
+        // Optional: directory whose entries publish changed, fsynced afterwards.
+        std::string dir;
+    };
+
+    AsyncFinalizer();
+    explicit AsyncFinalizer(Options opt);
+    AsyncFinalizer(const AsyncFinalizer&) = delete;
+    AsyncFinalizer& operator=(const AsyncFinalizer&) = delete;
+    // Runs whatever is still queued first; pending group commits are dropped.
+    ~AsyncFinalizer();
+
+    bool GroupCommit() const { return opt_.group_commit; }
+
+    // Thread safe. `what` names the task in the error message.
+    void Submit(std::string what, Task task);
+    void SubmitCommit(Commit commit);
+
+    // Waits until every task submitted so far has run.
+    Result Barrier();
+
+    // First failure so far, without waiting.
+    Result Error() const;
+
+  private:
+    void Run();
+    Result RunGroupCommit(std::vector<Commit>& commits,
+                          std::deque<std::pair<std::string, Task>>& after);
+
+    Options opt_{};
+    mutable std::mutex mu_;
+    std::condition_variable wake_;
+    std::condition_variable idle_;
+    std::deque<std::pair<std::string, Task>> queue_;
+    bool busy_ = false;
+    bool stop_ = false;
+    Result error_;
+    // Group-commit mode: commits and the tasks held back until they are durable.
+    std::vector<Commit> commits_;
+    std::deque<std::pair<std::string, Task>> after_commit_;
+    // Last, so it starts after and is joined before the state above.
+    std::thread thread_;
+};
+
+} // namespace flash
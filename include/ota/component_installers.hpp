@@ -1,12 +1,47 @@
 #pragma once
 
 #include "ota/update_module.hpp"
+#include "util/result.hpp"
 
+#include <cstdint>
 #include <memory>
+#include <string>
+#include <sys/types.h>
 #include <vector>
 
 namespace flash {
 
+void EmitProgress(const UpdateModule::Options& opt,
+                  const char* tag,
+                  std::uint64_t in_done,
+                  std::uint64_t out_written,
+                  bool final);
+
+// ProgressStage callback for strategies that report progress while their input is consumed:
+// emits an event every progress_interval_bytes.
+class ReadProgress {
+  public:
+    ReadProgress(const UpdateModule::Options& opt, const char* tag)
+        : opt_(&opt), tag_(tag), next_(opt.progress_interval_bytes),
+          enabled_((opt.progress || opt.progress_sink) && opt.progress_interval_bytes > 0) {}
+
+    void operator()(std::uint64_t done) {
+        if (!enabled_ || done < next_)
+            return;
+        EmitProgress(*opt_, tag_, done, done, false);
+        next_ = done + opt_->progress_interval_bytes;
+    }
+
+  private:
+    const UpdateModule::Options* opt_ = nullptr;
+    const char* tag_ = nullptr;
+    std::uint64_t next_ = 0;
+    bool enabled_ = false;
+};
+
+// Parses a manifest "permissions" value (octal, e.g. "0640").
+Result ParsePermissions(const std::string& perm_str, mode_t& out_mode);
+
 std::vector<std::unique_ptr<UpdateModule::IInstallerStrategy>> CreateDefaultInstallerStrategies();
 
 } // namespace flash
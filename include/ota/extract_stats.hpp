@@ -0,0 +1,67 @@
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace flash {
+
+// Counters collected by TarStreamExtractor. Timings are steady_clock nanoseconds; read time
+// includes decompression because libarchive inflates inside the read calls.
+struct ExtractStats {
+    struct SlowEntry {
+        std::string path;
+        std::uint64_t bytes = 0;
+        std::uint64_t ns = 0;
+    };
+
+    std::uint64_t files = 0;
+    std::uint64_t dirs = 0;
+    std::uint64_t symlinks = 0;
+    std::uint64_t hardlinks = 0;
+    std::uint64_t other = 0;
+    std::uint64_t large_files = 0;
+    std::uint64_t batched_files = 0;
+    std::uint64_t batch_fallbacks = 0;
+    std::uint64_t batch_submits = 0;
+    // Entries left alone because a previous, interrupted run had already written them.
+    std::uint64_t resumed = 0;
+    std::uint64_t checkpoints = 0;
+
+    std::uint64_t bytes = 0;
+    std::uint64_t sparse_bytes = 0;
+
+    std::uint64_t read_header_ns = 0;
+    std::uint64_t read_data_ns = 0;
+    std::uint64_t write_header_ns = 0;
+    std::uint64_t write_data_ns = 0;
+    std::uint64_t finish_ns = 0;
+    std::uint64_t batch_ns = 0;
+    std::uint64_t total_ns = 0;
+
+    // Slowest entries first, at most the max_slow passed to RecordEntry().
+    std::vector<SlowEntry> slowest;
+
+    std::uint64_t Entries() const { return files + dirs + symlinks + hardlinks + other; }
+
+    void RecordEntry(std::string_view path,
+                     std::uint64_t bytes,
+                     std::uint64_t ns,
+                     std::size_t max_slow);
+
+    // One line of space separated key=value pairs.
+    std::string Summary() const;
+    std::string SlowestSummary() const;
+
+    static std::uint64_t NowNs() {
+        return static_cast<std::uint64_t>(
+            std::chrono::duration_cast<std::chrono::nanoseconds>(
+                std::chrono::steady_clock::now().time_since_epoch())
+                .count());
+    }
+};
+
+} // namespace flash
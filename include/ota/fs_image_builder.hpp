@@ -0,0 +1,37 @@
+#pragma once
+
+#include "io/io.hpp"
+#include "ota/tar_stream_extractor.hpp"
+#include "util/result.hpp"
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+namespace flash {
+
+// Builds a filesystem on a target from a tar stream without mounting anything: the archive is
+// unpacked into a private staging tree and mke2fs populates the target from it (-d), writing
+// the partition (or image file) directly.
+class FsImageBuilder {
+  public:
+    struct Options {
+        // Where the staging tree goes; it needs room for the unpacked archive.
+        std::string staging_dir = "/tmp";
+        std::string fs_type = "ext4";
+        std::uint64_t image_size_bytes = 0;
+
+        TarStreamExtractor::Options extract{};
+    };
+
+    FsImageBuilder() = default;
+    explicit FsImageBuilder(Options opt) : opt_(std::move(opt)) {}
+
+    // target is a block device or an image file (created when missing).
+    Result Build(IReader& tar_stream, std::string_view tag, const std::string& target) const;
+
+  private:
+    Options opt_{};
+};
+
+} // namespace flash
@@ -0,0 +1,53 @@
+#pragma once
+
+#include "util/result.hpp"
+
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace flash {
+
+// Persistent record of install progress, used to resume after power loss or a kill. It is
+// rewritten atomically (temp file, fsync, rename, directory fsync) at every durability point.
+// Thread safe: a component may be completed by a finaliser while the next one checkpoints.
+class InstallJournal {
+  public:
+    // Loads path when it exists and was written for the same manifest; otherwise starts empty.
+    static Result
+    Open(const std::string& path, const std::string& manifest_sha256, InstallJournal& out);
+
+    bool IsCompleted(const std::string& component) const;
+
+    // Output bytes of `component` known to be durable, or 0 if it was not in progress.
+    std::uint64_t ResumeOffset(const std::string& component) const;
+    // Archive entries of `component` known to be extracted and synced.
+    std::uint64_t ResumeEntries(const std::string& component) const;
+
+    Result Begin(const std::string& component,
+                 std::uint64_t bytes_written,
+                 std::uint64_t entries_done = 0);
+    Result Checkpoint(std::uint64_t bytes_written, std::uint64_t entries_done = 0);
+    // Leaves the current component alone unless it is `component`.
+    Result Complete(const std::string& component);
+
+    // Removes the journal once the whole install has succeeded.
+    Result Discard();
+
+    const std::string& Path() const { return path_; }
+
+  private:
+    bool IsCompletedLocked(const std::string& component) const;
+    Result Save() const;
+
+    mutable std::mutex mu_;
+    std::string path_;
+    std::string manifest_sha256_;
+    std::vector<std::string> completed_;
+    std::string current_;
+    std::uint64_t current_bytes_ = 0;
+    std::uint64_t current_entries_ = 0;
+};
+
+} // namespace flash
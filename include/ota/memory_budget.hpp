@@ -0,0 +1,33 @@
+#pragma once
+
+#include "io/buffer_pool.hpp"
+#include "util/result.hpp"
+
+#include <cstdint>
+
+namespace flash {
+
+// How a total memory budget (--memory-budget) is split across the install pipeline. Whatever
+// the pipeline does not get is left for the process itself (code, libraries, heap, libarchive
+// and zlib state), which is kMemoryBudgetReserveBytes.
+struct MemoryPlan {
+    BufferPool::Options pool;
+    // StagingBackend::Options::memory_threshold_bytes. Two entries can be in RAM at once
+    // while staging overlaps an install.
+    std::uint64_t memory_staging_bytes = 0;
+    // InstallCoordinator::SetSmallFileBatchBytes.
+    std::uint64_t small_file_batch_bytes = 0;
+    // UpdateModule::Options::bounded_decoders.
+    bool bounded_decoders = true;
+    // UpdateModule::Options::read_ahead_bytes.
+    std::uint64_t read_ahead_bytes = 0;
+};
+
+constexpr std::uint64_t kMemoryBudgetReserveBytes = 12 * 1024 * 1024ULL;
+constexpr std::uint64_t kMinMemoryBudgetBytes = 16 * 1024 * 1024ULL;
+
+// Sizes buffers and RAM staging to fit budget_bytes. Fails with EINVAL below
+// kMinMemoryBudgetBytes.
+Result PlanMemoryBudget(std::uint64_t budget_bytes, MemoryPlan& out);
+
+} // namespace flash
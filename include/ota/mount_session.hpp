@@ -19,9 +19,13 @@ class MountSession {
         virtual Result Mount(std::string_view device,
                              std::string_view target_dir,
                              std::string_view fs_type,
-                             unsigned long mount_flags) const = 0;
+                             unsigned long mount_flags,
+                             std::string_view mount_data) const = 0;
         virtual Result Unmount(std::string_view target_dir) const = 0;
+        virtual Result SyncFilesystem(std::string_view target_dir) const = 0;
         virtual void RemoveDirectory(std::string_view dir) const = 0;
+        // Create a fresh, empty filesystem of fs_type on device (destroys its contents).
+        virtual Result Format(std::string_view device, std::string_view fs_type) const = 0;
     };
 
     MountSession();
@@ -37,17 +41,33 @@ class MountSession {
                               std::string_view mount_prefix,
                               std::string_view fs_type,
                               unsigned long mount_flags,
+                              std::string_view mount_data,
                               MountSession& out);
 
+    // Same as MountDevice, but first replaces whatever is on device with a new filesystem.
+    static Result FormatAndMountDevice(std::string_view device,
+                                       std::string_view mount_base_dir,
+                                       std::string_view mount_prefix,
+                                       std::string_view fs_type,
+                                       unsigned long mount_flags,
+                                       std::string_view mount_data,
+                                       MountSession& out);
+
+    // Change flags/fs-specific options of the active mount (MS_REMOUNT is added internally).
+    Result Remount(unsigned long mount_flags, std::string_view mount_data);
+    // syncfs() the mounted filesystem so everything written so far is durable.
+    Result Sync();
     Result Unmount();
     const std::string& Dir() const { return dir_; }
 
+    static std::shared_ptr<const ISystemOps> DefaultSystemOps();
+
   private:
     void Cleanup();
 
-    static std::shared_ptr<const ISystemOps> DefaultSystemOps();
-
     std::shared_ptr<const ISystemOps> system_ops_;
+    std::string device_;
+    std::string fs_type_;
     std::string dir_;
     bool mounted_ = false;
 };
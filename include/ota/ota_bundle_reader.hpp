@@ -5,6 +5,7 @@
 
 #include <archive.h>
 #include <archive_entry.h>
+#include <cstddef>
 #include <cstdint>
 #include <memory>
 #include <optional>
@@ -36,7 +37,8 @@ class OtaTarBundleReader {
     // Read current entry fully to string (for manifest.json).
     Result ReadCurrentToString(std::string& out);
 
-    // Open a reader that streams current entry data using archive_read_data().
+    // Open a reader that streams current entry data using archive_read_data_block(); its
+    // ReadView() lends libarchive's own block without copying.
     // Note: libarchive requires sequential access; you must finish reading (EOF) before calling
     // Next().
     Result OpenCurrentEntryReader(std::unique_ptr<IReader>& out_reader);
@@ -56,10 +58,17 @@ class OtaTarBundleReader {
       public:
         explicit EntryReader(OtaTarBundleReader* parent) : parent_(parent) {}
         ssize_t Read(std::span<std::uint8_t> out) override;
+        ssize_t ReadView(std::span<const std::uint8_t>& view,
+                         std::span<std::uint8_t> scratch) override;
         std::optional<std::uint64_t> TotalSize() const override;
 
       private:
         OtaTarBundleReader* parent_ = nullptr;
+        // Unconsumed part of the last data block and the entry offset it starts at.
+        const std::uint8_t* block_ = nullptr;
+        std::size_t block_left_ = 0;
+        std::int64_t block_offset_ = 0;
+        std::int64_t pos_ = 0;
     };
 };
 
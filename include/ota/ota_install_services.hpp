@@ -1,34 +1,45 @@
 #pragma once
 
 #include "io/file_reader.hpp"
+#include "ota/install_journal.hpp"
 #include "ota/ota_bundle_reader.hpp"
 #include "ota/progress.hpp"
+#include "ota/staging_backend.hpp"
+#include "ota/staging_cache.hpp"
 #include "ota/update_module.hpp"
 #include "util/manifest.hpp"
+#include "util/manifest_parser.hpp"
 #include "util/result.hpp"
 
 #include <cstdint>
 #include <string>
 #include <string_view>
 #include <unordered_map>
+#include <utility>
 
 namespace flash {
 
+// Keys and values borrow from the manifest, which must outlive the index.
 class ComponentIndex {
   public:
     explicit ComponentIndex(const Manifest& manifest);
 
     const Component* Find(std::string_view normalized_entry_name) const;
     bool Contains(std::string_view normalized_entry_name) const;
-    const std::unordered_map<std::string, const Component*>& EntriesByFilename() const;
+    const std::unordered_map<std::string_view, const Component*>& EntriesByFilename() const;
 
   private:
-    std::unordered_map<std::string, const Component*> by_filename_;
+    std::unordered_map<std::string_view, const Component*> by_filename_;
 };
 
 class ManifestLoader {
   public:
     static Result LoadFromFirstBundleEntry(OtaTarBundleReader& bundle, Manifest& out_manifest);
+    // Also returns the SHA-256 of the raw manifest.json, identifying the bundle.
+    static Result LoadFromFirstBundleEntry(OtaTarBundleReader& bundle,
+                                           Manifest& out_manifest,
+                                           std::string& out_manifest_sha256,
+                                           const ManifestParser::Options& parse_opt = {});
 };
 
 class BundlePreScanner {
@@ -41,6 +52,27 @@ class InstallCoordinator {
   public:
     explicit InstallCoordinator(UpdateModule& update_module, IProgress* progress_sink = nullptr);
 
+    // Optional: completed components are skipped and an interrupted one resumes.
+    void SetJournal(InstallJournal* journal) { journal_ = journal; }
+    // Optional: verified payloads are reused from and added to the cache.
+    void SetStagingCache(StagingCache* cache) { cache_ = cache; }
+    void SetStagingOptions(StagingBackend::Options opt) { staging_opt_ = std::move(opt); }
+    // Staged bytes allowed in flight while the previous component installs; 0 disables
+    // overlapping staging with installs.
+    void SetPipelineBudget(std::uint64_t bytes) { pipeline_budget_ = bytes; }
+    // Defer every component's final sync and rename to one commit phase at the end.
+    void SetGroupCommit(bool enable) { group_commit_ = enable; }
+    // Publish small file components per directory in batches (on by default).
+    void SetSmallFileBatching(bool enable) { batch_small_files_ = enable; }
+    // Batched small files are held in RAM until published.
+    void SetSmallFileBatchBytes(std::uint64_t bytes) { small_file_batch_bytes_ = bytes; }
+    // See UpdateModule::Options::bounded_decoders.
+    void SetBoundedDecoders(bool enable) { bounded_decoders_ = enable; }
+    // See UpdateModule::Options::read_ahead_bytes.
+    void SetReadAheadBytes(std::uint64_t bytes) { read_ahead_bytes_ = bytes; }
+    // Key for encrypted components; must outlive the install. Without one they fail.
+    void SetDecryptionKey(const AesGcmKey* key) { decryption_key_ = key; }
+
     Result InstallMatchingEntries(OtaTarBundleReader& bundle,
                                   const ComponentIndex& component_index,
                                   std::uint64_t overall_total);
@@ -53,6 +85,16 @@ class InstallCoordinator {
 
     UpdateModule& update_module_;
     IProgress* progress_sink_ = nullptr;
+    InstallJournal* journal_ = nullptr;
+    StagingCache* cache_ = nullptr;
+    StagingBackend::Options staging_opt_{};
+    std::uint64_t pipeline_budget_ = 1024 * 1024 * 1024ULL;
+    bool group_commit_ = false;
+    bool batch_small_files_ = true;
+    std::uint64_t small_file_batch_bytes_ = 16 * 1024 * 1024ULL;
+    bool bounded_decoders_ = false;
+    std::uint64_t read_ahead_bytes_ = 0;
+    const AesGcmKey* decryption_key_ = nullptr;
 };
 
 } // namespace flash
@@ -1,9 +1,13 @@
 #pragma once
 
+#include "ota/staging_backend.hpp"
+#include "ota/staging_cache.hpp"
 #include "ota/update_module.hpp"
 #include "util/result.hpp"
 
+#include <cstdint>
 #include <string>
+#include <utility>
 
 namespace flash {
 
@@ -14,11 +18,32 @@ class OtaInstaller {
 
     void SetProgressSink(IProgress* sink) { progress_sink_ = sink; }
 
+    // Records progress in `path` so an interrupted install resumes on the next run.
+    void SetJournalPath(std::string path) { journal_path_ = std::move(path); }
+
+    // Keeps verified payloads in a staging cache so a retried install can reuse them.
+    void SetStagingCache(StagingCache::Options opt) { cache_opt_ = std::move(opt); }
+    void SetStagingOptions(StagingBackend::Options opt) { staging_opt_ = std::move(opt); }
+    // Syncs and publishes all components together at the end instead of one by one.
+    void SetGroupCommit(bool enable) { group_commit_ = enable; }
+    // Bounds pipeline buffers, RAM staging and archive decoders to fit `bytes` (see
+    // PlanMemoryBudget); 0 leaves the defaults. Overrides the BufferPool configuration.
+    void SetMemoryBudget(std::uint64_t bytes) { memory_budget_ = bytes; }
+    // Decrypts "encryption": "aes-256-gcm" components with the key in `path` (see
+    // LoadAesGcmKeyFile).
+    void SetDecryptionKeyFile(std::string path) { key_path_ = std::move(path); }
+
     Result Run(const std::string& input_path);
 
   private:
     UpdateModule update_module_;
     IProgress* progress_sink_ = nullptr;
+    std::string journal_path_;
+    StagingCache::Options cache_opt_{};
+    StagingBackend::Options staging_opt_{};
+    bool group_commit_ = false;
+    std::uint64_t memory_budget_ = 0;
+    std::string key_path_;
 };
 
 } // namespace flash
@@ -0,0 +1,32 @@
+#pragma once
+
+#include "util/result.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <span>
+#include <string_view>
+
+namespace flash {
+
+enum class ReadOnlyImageType {
+    Erofs,
+    Squashfs,
+};
+
+// Both superblocks fit in the first 4 KiB (squashfs at 0, erofs at 1024).
+inline constexpr std::size_t kReadOnlyImageHeaderBytes = 4096;
+
+std::optional<ReadOnlyImageType> ReadOnlyImageTypeFromName(std::string_view type);
+
+struct ReadOnlyImageInfo {
+    // Bytes the filesystem claims to occupy; the written image must be at least this long.
+    std::uint64_t fs_bytes = 0;
+};
+
+Result ParseReadOnlyImageHeader(ReadOnlyImageType type,
+                                std::span<const std::uint8_t> head,
+                                ReadOnlyImageInfo& out);
+
+} // namespace flash
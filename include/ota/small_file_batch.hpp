@@ -0,0 +1,56 @@
+#pragma once
+
+#include "io/fd.hpp"
+#include "util/result.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <sys/types.h>
+#include <unordered_map>
+#include <vector>
+
+namespace flash {
+
+// Installs many small, already verified files with a constant number of syscalls per
+// destination directory rather than several fsyncs per file. Files are grouped by directory;
+// Stage() writes each under "<name>.tmp" through one directory fd and syncs each filesystem
+// once, Publish() renames them into place with renameat2() and fsyncs each directory once.
+// Temporaries that were never published are removed by the destructor.
+class SmallFileBatch {
+  public:
+    SmallFileBatch() = default;
+    SmallFileBatch(const SmallFileBatch&) = delete;
+    SmallFileBatch& operator=(const SmallFileBatch&) = delete;
+    ~SmallFileBatch();
+
+    // `path`'s directory must exist. A later Add for the same path replaces the earlier one.
+    void Add(const std::string& path, std::vector<std::uint8_t> data, mode_t mode);
+
+    bool Empty() const { return files_ == 0; }
+    std::size_t Files() const { return files_; }
+    std::uint64_t Bytes() const { return bytes_; }
+
+    Result Stage();
+    Result Publish();
+
+  private:
+    struct File {
+        std::string name;
+        std::vector<std::uint8_t> data;
+        mode_t mode = 0;
+        bool staged = false;
+    };
+    struct Dir {
+        std::string path;
+        Fd fd;
+        std::vector<File> files;
+    };
+
+    std::vector<Dir> dirs_;
+    std::unordered_map<std::string, std::size_t> dir_index_;
+    std::size_t files_ = 0;
+    std::uint64_t bytes_ = 0;
+};
+
+} // namespace flash
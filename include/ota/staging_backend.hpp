@@ -0,0 +1,55 @@
+#pragma once
+
+#include "util/result.hpp"
+
+#include <cstdint>
+#include <string>
+#include <utility>
+
+namespace flash {
+
+// Where one bundle entry is staged before it is verified and installed.
+struct StagingPlacement {
+    enum class Tier {
+        kMemory,      // memfd_create
+        kDirectory,   // a file in the staging directory
+        kDestination, // unnamed file next to the target, published by rename
+    };
+
+    Tier tier = Tier::kDirectory;
+    std::string dir;
+};
+
+const char* ToString(StagingPlacement::Tier tier);
+
+// Picks a staging tier per entry from its size and the free space where it would go.
+class StagingBackend {
+  public:
+    struct Options {
+        // Large entries; typically a data partition with room for multi-GB payloads.
+        std::string dir = "/tmp";
+        // Entries smaller than this are kept in RAM (memfd). 0 disables the memory tier.
+        std::uint64_t memory_threshold_bytes = 8 * 1024 * 1024ULL;
+        // Free space a staging filesystem must keep after taking an entry.
+        std::uint64_t min_free_bytes = 64 * 1024 * 1024ULL;
+    };
+
+    StagingBackend() = default;
+    explicit StagingBackend(Options opt) : opt_(std::move(opt)) {}
+
+    const Options& GetOptions() const { return opt_; }
+
+    // publish_dir is the destination directory a verified payload could be renamed into, or
+    // "" when that does not apply. Fails when no tier has room for `size` bytes.
+    Result Choose(std::uint64_t size, const std::string& publish_dir, StagingPlacement& out) const;
+
+    // Bytes available to unprivileged writers on the filesystem holding dir, or 0 on error.
+    static std::uint64_t FreeBytes(const std::string& dir);
+
+  private:
+    bool HasRoom(const std::string& dir, std::uint64_t size) const;
+
+    Options opt_{};
+};
+
+} // namespace flash
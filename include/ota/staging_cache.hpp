@@ -0,0 +1,59 @@
+#pragma once
+
+#include "io/io.hpp"
+#include "util/result.hpp"
+
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <string>
+#include <unordered_map>
+
+namespace flash {
+
+// On-disk cache of staged, verified bundle entries keyed by SHA-256, so a retried install does
+// not stage and hash the same payloads again. Files are named by their hash and written only
+// after verification. Least recently used entries (by mtime, which Lookup refreshes) are
+// evicted to stay within max_bytes.
+class StagingCache {
+  public:
+    struct Options {
+        std::string dir;
+        std::uint64_t max_bytes = 1024 * 1024 * 1024ULL;
+    };
+
+    // Creates dir if needed, indexes the entries already in it and drops stale temp files.
+    static Result Open(const Options& opt, StagingCache& out);
+
+    const std::string& Dir() const { return opt_.dir; }
+    std::uint64_t Bytes() const { return bytes_; }
+    std::size_t Size() const { return index_.size(); }
+
+    // Opens the cached payload for sha256, if any. The file is hashed again first; an entry
+    // that no longer matches its name is dropped.
+    bool Lookup(const std::string& sha256, std::unique_ptr<IReader>& out);
+
+    // Adds a verified file under sha256, hard-linking it when it is on the cache filesystem
+    // and copying it otherwise, and syncs the file and the cache directory. Payloads larger
+    // than max_bytes are not cached.
+    Result Insert(const std::string& sha256, const std::string& verified_path);
+
+  private:
+    struct Item {
+        std::string key;
+        std::uint64_t bytes = 0;
+    };
+
+    std::string PathOf(const std::string& key) const { return opt_.dir + "/" + key; }
+    void Touch(std::list<Item>::iterator it);
+    void EvictFor(std::uint64_t incoming);
+    void Remove(std::list<Item>::iterator it);
+
+    Options opt_{};
+    // Least recently used first.
+    std::list<Item> lru_;
+    std::unordered_map<std::string, std::list<Item>::iterator> index_;
+    std::uint64_t bytes_ = 0;
+};
+
+} // namespace flash
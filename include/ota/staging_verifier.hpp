@@ -2,10 +2,13 @@
 
 #include "io/fd.hpp"
 #include "io/io.hpp"
+#include "ota/staging_backend.hpp"
 #include "util/result.hpp"
 
 #include <memory>
+#include <sys/types.h>
 #include <string>
+#include <utility>
 
 namespace flash {
 
@@ -14,6 +17,12 @@ class Fd;
 class TempFile {
   public:
     static Result Create(TempFile& out);
+    static Result CreateIn(const std::string& dir, TempFile& out);
+    // Unnamed O_TMPFILE in dir (nothing to clean up after a crash); falls back to CreateIn
+    // when the filesystem does not support it.
+    static Result CreateUnnamedIn(const std::string& dir, TempFile& out);
+    // Anonymous memory-backed file (memfd); cannot be published.
+    static Result CreateInMemory(TempFile& out);
 
     TempFile();
     TempFile(const TempFile&) = delete;
@@ -23,14 +32,24 @@ class TempFile {
     ~TempFile();
 
     int GetFd() const;
+    // A path that opens this file, also while it is unnamed (/proc/self/fd/N).
     const std::string& Path() const;
     void Close();
 
+    Result Sync() const;
+    // Gives the file `mode` and atomically renames it to dst, which must be on the same
+    // filesystem, then fsyncs dst's directory unless the caller does. The TempFile is empty
+    // afterwards.
+    Result Publish(const std::string& dst, mode_t mode, bool sync_dir = true);
+
   private:
     void Cleanup();
 
     Fd fd_;
     std::string path_;
+    // Set for unnamed files: the directory they live in.
+    std::string unnamed_dir_;
+    bool in_memory_ = false;
 };
 
 struct StagedEntry {
@@ -40,9 +59,18 @@ struct StagedEntry {
 
 class OtaEntryStager {
   public:
+    OtaEntryStager() = default;
+    // Stage into staging_dir instead of /tmp (e.g. a staging cache, so entries can be linked).
+    explicit OtaEntryStager(std::string staging_dir)
+        : placement_{StagingPlacement::Tier::kDirectory, std::move(staging_dir)} {}
+    explicit OtaEntryStager(StagingPlacement placement) : placement_(std::move(placement)) {}
+
     Result StageAndVerify(std::unique_ptr<IReader>& entry_reader,
                           const std::string& expected_sha256,
                           StagedEntry& out) const;
+
+  private:
+    StagingPlacement placement_{StagingPlacement::Tier::kDirectory, "/tmp"};
 };
 
 } // namespace flash
@@ -1,10 +1,13 @@
 #pragma once
 
 #include "io/io.hpp"
+#include "ota/extract_stats.hpp"
 #include "ota/progress.hpp"
 #include "util/result.hpp"
 
+#include <cstddef>
 #include <cstdint>
+#include <functional>
 #include <string>
 #include <string_view>
 
@@ -16,6 +19,36 @@ class TarStreamExtractor {
         bool progress = true;
         std::uint64_t progress_interval_bytes = 4 * 1024 * 1024ULL;
         bool safe_paths_only = true;
+        // Unlink existing files before replacing them. Not needed on a freshly formatted target.
+        bool unlink_existing = true;
+        // Regular files at least this large bypass libarchive's data path and are streamed by
+        // StreamingFileWriter (preallocated, windowed writeback, drop-behind). 0 disables.
+        std::uint64_t large_file_threshold_bytes = 16 * 1024 * 1024ULL;
+        // Skip all-zero runs of regular files (at sparse_block_bytes granularity) so they
+        // become holes; the file size is unchanged.
+        bool sparse_files = true;
+        std::size_t sparse_block_bytes = 4096;
+        // Regular files up to this size are created in io_uring batches (UringFileBatcher)
+        // when the kernel allows it, and one by one otherwise.
+        bool batch_small_files = true;
+        std::uint64_t small_file_threshold_bytes = 16 * 1024;
+        // Accept only tar, plain or gzip-compressed (a 32 KiB decoder window), instead of every
+        // format and filter libarchive has. For bounded-memory installs.
+        bool bounded_decoders = false;
+
+        // Resume support. Entries before resume_entries were extracted and synced by an
+        // interrupted run; they are skipped when they are still on disk (same type, and for
+        // regular files the same size and mtime) and extracted again otherwise.
+        std::uint64_t resume_entries = 0;
+        // When set, every checkpoint_interval_bytes of finished entries the target filesystem
+        // is synced (syncfs) and then told how many entries and bytes are durable. A final
+        // checkpoint follows the last entry.
+        std::function<Result(std::uint64_t bytes_done, std::uint64_t entries_done)> on_checkpoint;
+        std::uint64_t checkpoint_interval_bytes = 64 * 1024 * 1024ULL;
+
+        // Counters are always collected and logged at the end; stats_out also receives them.
+        ExtractStats* stats_out = nullptr;
+        std::size_t slow_entry_count = 5;
 
         IProgress* progress_sink = nullptr;
         std::uint64_t component_total_bytes = 0;
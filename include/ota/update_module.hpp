@@ -1,16 +1,23 @@
 #pragma once
 
+#include "crypto/aes_gcm.hpp"
 #include "io/io.hpp"
 #include "ota/progress.hpp"
 #include "util/manifest.hpp"
 #include "util/result.hpp"
 
 #include <cstdint>
+#include <functional>
 #include <memory>
+#include <string>
+#include <sys/types.h>
 #include <vector>
 
 namespace flash {
 
+class AsyncFinalizer;
+class TempFile;
+
 class UpdateModule {
   public:
     struct Options {
@@ -24,6 +31,35 @@ class UpdateModule {
         std::uint64_t overall_total_bytes = 0;   // 0 => unknown
         std::uint64_t overall_done_base_bytes =
             0; // sum completed entry sizes before current component
+
+        // Resume support: output bytes (raw/file) or archive entries already durable from an
+        // interrupted run, and a callback told each time more output becomes durable.
+        std::uint64_t resume_offset = 0;
+        std::uint64_t resume_entries = 0;
+        std::function<Result(std::uint64_t durable_bytes, std::uint64_t durable_entries)>
+            on_durable;
+
+        // Set when the verified payload was staged in the component's destination directory:
+        // it is renamed into place instead of copied through the reader. Shared so a commit
+        // queued on the finalizer keeps it alive.
+        std::shared_ptr<TempFile> staged_file;
+
+        // Optional: the final fsync/rename/unmount is queued here instead of awaited, so the
+        // component is only durable after the caller's AsyncFinalizer::Barrier().
+        AsyncFinalizer* finalizer = nullptr;
+
+        // Bounded-memory install: archives only go through decoders with small fixed windows.
+        bool bounded_decoders = false;
+        // Bounded-memory install: what chunk verification and decryption may hold in read-ahead
+        // buffers, together; 0 is no cap.
+        std::uint64_t read_ahead_bytes = 0;
+
+        // Device key for components with "encryption" set.
+        const AesGcmKey* decryption_key = nullptr;
+
+        // Scratch directory for components unpacked before they are installed (build-image);
+        // "" uses /tmp.
+        std::string staging_dir;
     };
 
     class IInstallerStrategy {
@@ -35,6 +71,11 @@ class UpdateModule {
                                const Options& opt,
                                const char* tag,
                                const std::uint64_t* in_read) const = 0;
+        // Whether Install honours Options::resume_offset / resume_entries.
+        virtual bool Resumable() const { return false; }
+        // Whether progress is reported as the reader is consumed (for consumers that never see
+        // output bytes, like libarchive); UpdateModule then adds it to the read pipeline.
+        virtual bool ReportsReadProgress() const { return false; }
     };
 
     UpdateModule();
@@ -0,0 +1,94 @@
+#pragma once
+
+#include "io/fd.hpp"
+#include "system/io_uring.hpp"
+#include "util/result.hpp"
+
+#include <archive_entry.h>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <sys/types.h>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+namespace flash {
+
+// Creates many small regular files with a handful of io_uring_enter calls. Each queued file
+// becomes one linked chain: unlinkat -> openat (direct descriptor) -> write -> close. Mode and
+// timestamps, which io_uring cannot set, are applied after the batch completes.
+//
+// Callers must Flush() before anything that could change the directory tree (directories,
+// links, other files) so extraction order is preserved, and ResetDirCache() afterwards.
+class UringFileBatcher {
+  public:
+    struct Options {
+        unsigned max_files = 64;
+        std::size_t max_bytes = 1024 * 1024;
+        bool unlink_existing = true;
+    };
+
+    struct EntryDeleter {
+        void operator()(archive_entry* e) const { archive_entry_free(e); }
+    };
+    using EntryPtr = std::unique_ptr<archive_entry, EntryDeleter>;
+
+    // A queued file whose chain failed; the caller writes it the regular way.
+    struct Failed {
+        EntryPtr entry;
+        std::vector<std::uint8_t> data;
+    };
+
+    UringFileBatcher() = default;
+    UringFileBatcher(const UringFileBatcher&) = delete;
+    UringFileBatcher& operator=(const UringFileBatcher&) = delete;
+
+    // Fails when io_uring (or direct descriptors) are unavailable.
+    static Result Open(const std::string& base_dir, const Options& opt, UringFileBatcher& out);
+
+    bool Empty() const { return items_.empty(); }
+    bool Full() const;
+    bool Contains(const std::string& rel) const { return queued_.contains(rel); }
+
+    // Queues rel (relative to base_dir), taking data. Returns false without queuing (and
+    // leaves data alone) when its parent is not an existing real directory below base_dir;
+    // such entries need the regular path.
+    bool Add(archive_entry* entry, const std::string& rel, std::vector<std::uint8_t>&& data);
+
+    // Runs the queued chains. Chains that failed are appended to `failed`.
+    Result Flush(std::vector<Failed>& failed);
+
+    void ResetDirCache() { dirs_.clear(); }
+
+    // Number of io_uring_enter calls issued, for statistics.
+    std::uint64_t Submits() const { return submits_; }
+
+  private:
+    struct Item {
+        EntryPtr entry;
+        int dirfd = -1;
+        std::string name;
+        std::vector<std::uint8_t> data;
+        mode_t mode = 0;
+        bool set_times = false;
+        timespec times[2]{};
+        int result = 0;
+    };
+
+    int ParentDirFd(const std::string& rel_dir);
+
+    Options opt_{};
+    Fd base_fd_;
+    mode_t umask_ = 022;
+    std::unordered_map<std::string, Fd> dirs_;
+    std::unordered_set<std::string> queued_;
+    std::vector<Item> items_;
+    std::size_t queued_bytes_ = 0;
+    std::uint64_t submits_ = 0;
+    // Last, so the ring is torn down before the buffers in-flight requests point at.
+    IoUring ring_;
+};
+
+} // namespace flash
@@ -0,0 +1,63 @@
+#pragma once
+
+#include "io/fd.hpp"
+#include "util/result.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <linux/io_uring.h>
+
+namespace flash {
+
+// Minimal io_uring wrapper on top of the raw syscalls (no liburing dependency). Single
+// threaded: one owner prepares SQEs, submits and reaps completions.
+class IoUring {
+  public:
+    IoUring() = default;
+    IoUring(const IoUring&) = delete;
+    IoUring& operator=(const IoUring&) = delete;
+    ~IoUring();
+
+    // Fails with ENOSYS/EPERM/... when the kernel or a seccomp policy does not allow io_uring.
+    static Result Open(unsigned entries, IoUring& out);
+
+    // Registers `count` empty fixed-file slots for direct descriptors.
+    Result RegisterSparseFiles(unsigned count);
+
+    // Returns a zeroed SQE, or nullptr when the submission queue is full.
+    io_uring_sqe* GetSqe();
+
+    // Submits everything prepared so far and waits until at least wait_nr completions exist.
+    Result SubmitAndWait(unsigned wait_nr);
+
+    // Pops one completion if available.
+    bool PopCqe(io_uring_cqe& out);
+
+    unsigned Entries() const { return sq_entries_; }
+
+  private:
+    void Unmap();
+
+    Fd ring_fd_;
+    void* sq_ring_ = nullptr;
+    std::size_t sq_ring_size_ = 0;
+    void* cq_ring_ = nullptr;
+    std::size_t cq_ring_size_ = 0;
+    io_uring_sqe* sqes_ = nullptr;
+    std::size_t sqes_size_ = 0;
+
+    unsigned* sq_head_ = nullptr;
+    unsigned* sq_tail_ = nullptr;
+    unsigned* sq_array_ = nullptr;
+    unsigned sq_mask_ = 0;
+    unsigned sq_entries_ = 0;
+    unsigned sqe_tail_ = 0;
+    unsigned submitted_tail_ = 0;
+
+    unsigned* cq_head_ = nullptr;
+    unsigned* cq_tail_ = nullptr;
+    io_uring_cqe* cqes_ = nullptr;
+    unsigned cq_mask_ = 0;
+};
+
+} // namespace flash
@@ -0,0 +1,18 @@
+#pragma once
+
+#include "util/result.hpp"
+
+#include <string>
+#include <sys/types.h>
+#include <vector>
+
+namespace flash {
+
+// Spawn argv[0] (looked up in PATH), wait for it and fail unless it exits with status 0.
+Result RunProcess(const std::vector<std::string>& argv);
+
+// The process umask, read on the first call and cached. Call it before starting threads:
+// reading the umask means briefly changing it, which would race with files being created.
+mode_t ProcessUmask();
+
+} // namespace flash
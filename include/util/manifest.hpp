@@ -3,14 +3,28 @@
 #include <cstdint>
 #include <expected>
 #include <string>
+#include <string_view>
 #include <unordered_map>
 #include <vector>
 
 namespace flash {
 
+enum class ComponentType {
+    Unknown,
+    File,
+    Raw,
+    Archive,
+    Erofs,
+    Squashfs,
+};
+
+// Manifest spelling ("file", "raw", ...). Unrecognised names map to Unknown.
+ComponentType ComponentTypeFromName(std::string_view name);
+const char* ComponentTypeName(ComponentType type);
+
 struct Component {
     std::string name;
-    std::string type;
+    ComponentType type = ComponentType::Unknown;
     std::string filename;
     std::uint64_t size = 0;
     std::string sha256;
@@ -21,6 +35,18 @@ struct Component {
     std::string path;
     std::string permissions = "";
     bool create_destination = false;
+    bool format_destination = false;
+    std::string mount_options;
+    std::string mount_profile;
+    bool build_image = false;
+    std::uint64_t image_size = 0;
+    bool verify_readback = false;
+    // "" (plaintext) or "aes-256-gcm"; see crypto/aes_gcm.hpp.
+    std::string encryption;
+    // Optional SHA-256 of every chunk_size bytes of the bundle entry (the last chunk may be
+    // shorter), checked as the entry streams.
+    std::uint64_t chunk_size = 0;
+    std::vector<std::string> chunk_sha256;
 };
 
 struct Manifest {
@@ -7,9 +7,18 @@
 
 namespace flash {
 
+// Streams the JSON through a SAX handler; no document tree is built and strings are moved
+// straight into the components.
 class ManifestParser {
   public:
-    std::expected<Manifest, std::string> Parse(const std::string& json_input) const;
+    struct Options {
+        // When set, only this slot's components are kept. Other slots are still listed in
+        // slot_components, with no components.
+        std::string slot;
+    };
+
+    std::expected<Manifest, std::string> Parse(const std::string& json_input,
+                                               const Options& opt = {}) const;
 };
 
 } // namespace flash
@@ -8,7 +8,10 @@ namespace flash {
 
 class ManifestSelector {
   public:
+    // `out` gets the manifest header and the device slot's components; slot_components is
+    // left empty. The rvalue overload moves the components instead of copying them.
     static Result SelectForDevice(const Manifest& input, const DeviceConfig& device, Manifest& out);
+    static Result SelectForDevice(Manifest&& input, const DeviceConfig& device, Manifest& out);
 };
 
 } // namespace flash
@@ -157,4 +157,5 @@ cat > "$WORKDIR/ota.conf" <<'EOF'
 EOF
 popd
 
-OTA_CONFIG_PATH=$WORKDIR/ota.conf ./build/flash_tool -i $WORKDIR/ota.tar
+# FLASH_TOOL=true only builds the sample.
+OTA_CONFIG_PATH=$WORKDIR/ota.conf ${FLASH_TOOL:-./build/flash_tool} -i $WORKDIR/ota.tar
@@ -8,7 +8,7 @@ if ! command -v clang-format >/dev/null 2>&1; then
   exit 1
 fi
 
-mapfile -t FILES < <(find include src tests -type f \( -name '*.h' -o -name '*.hpp' -o -name '*.c' -o -name '*.cpp' \) | sort)
+mapfile -t FILES < <(find include src tests bench -type f \( -name '*.h' -o -name '*.hpp' -o -name '*.c' -o -name '*.cpp' \) | sort)
 
 if [[ "${#FILES[@]}" -eq 0 ]]; then
   echo "No source files found."
@@ -0,0 +1,196 @@
+#include "crypto/aes_gcm.hpp"
+
+#include <algorithm>
+#include <cctype>
+#include <cerrno>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <openssl/evp.h>
+
+namespace flash {
+
+namespace {
+
+constexpr char kMagic[8] = {'F', 'L', 'A', 'S', 'H', 'G', 'C', 'M'};
+
+int HexValue(char c) {
+    if (c >= '0' && c <= '9')
+        return c - '0';
+    c = static_cast<char>(std::tolower(static_cast<unsigned char>(c)));
+    if (c >= 'a' && c <= 'f')
+        return c - 'a' + 10;
+    return -1;
+}
+
+// Chunk i's nonce and AAD.
+void ChunkParams(const AesGcmNonce& base,
+                 std::uint64_t index,
+                 bool final_chunk,
+                 AesGcmNonce& nonce,
+                 std::array<std::uint8_t, 9>& aad) {
+    nonce = base;
+    for (int b = 0; b < 8; ++b) {
+        const auto byte = static_cast<std::uint8_t>(index >> (56 - 8 * b));
+        nonce[4 + b] ^= byte;
+        aad[b] = byte;
+    }
+    aad[8] = final_chunk ? 1 : 0;
+}
+
+} // namespace
+
+Result ParseChunkedGcmHeader(std::span<const std::uint8_t> in, ChunkedGcmHeader& out) {
+    if (in.size() < kChunkedGcmHeaderBytes)
+        return Result::Fail(-1, "encrypted payload header truncated");
+    if (std::memcmp(in.data(), kMagic, sizeof(kMagic)) != 0)
+        return Result::Fail(-1, "encrypted payload header: bad magic");
+    out.chunk_bytes = static_cast<std::uint32_t>(in[8]) | static_cast<std::uint32_t>(in[9]) << 8 |
+                      static_cast<std::uint32_t>(in[10]) << 16 |
+                      static_cast<std::uint32_t>(in[11]) << 24;
+    if (out.chunk_bytes == 0 || out.chunk_bytes > kMaxGcmChunkBytes) {
+        return Result::Fail(-1,
+                            "encrypted payload header: bad chunk size " +
+                                std::to_string(out.chunk_bytes));
+    }
+    std::copy_n(in.begin() + 12, out.nonce.size(), out.nonce.begin());
+    return Result::Ok();
+}
+
+Result LoadAesGcmKeyFile(const std::string& path, AesGcmKey& out) {
+    std::ifstream is(path, std::ios::binary);
+    if (!is)
+        return Result::Fail(-1, "cannot open key file: " + path);
+    std::string raw((std::istreambuf_iterator<char>(is)), std::istreambuf_iterator<char>());
+
+    if (raw.size() == out.size()) {
+        std::memcpy(out.data(), raw.data(), out.size());
+        return Result::Ok();
+    }
+    while (!raw.empty() && (raw.back() == '\n' || raw.back() == '\r'))
+        raw.pop_back();
+    if (raw.size() != out.size() * 2)
+        return Result::Fail(-1, "key file must hold 32 bytes or 64 hex digits: " + path);
+    for (std::size_t i = 0; i < out.size(); ++i) {
+        const int hi = HexValue(raw[2 * i]);
+        const int lo = HexValue(raw[2 * i + 1]);
+        if (hi < 0 || lo < 0)
+            return Result::Fail(-1, "key file has a non-hex digit: " + path);
+        out[i] = static_cast<std::uint8_t>(hi << 4 | lo);
+    }
+    return Result::Ok();
+}
+
+struct AesGcmChunkCipher::Impl {
+    EVP_CIPHER_CTX* ctx = nullptr;
+    AesGcmKey key{};
+    AesGcmNonce base{};
+
+    ~Impl() {
+        if (ctx)
+            EVP_CIPHER_CTX_free(ctx);
+    }
+};
+
+AesGcmChunkCipher::AesGcmChunkCipher() : impl_(std::make_unique<Impl>()) {}
+AesGcmChunkCipher::~AesGcmChunkCipher() = default;
+
+Result AesGcmChunkCipher::Init(const AesGcmKey& key, const AesGcmNonce& base_nonce) {
+    if (!impl_->ctx)
+        impl_->ctx = EVP_CIPHER_CTX_new();
+    if (!impl_->ctx)
+        return Result::Fail(ENOMEM, "EVP_CIPHER_CTX_new failed");
+    impl_->key = key;
+    impl_->base = base_nonce;
+    // The cipher is bound once; each chunk only sets a new IV.
+    if (EVP_CipherInit_ex(impl_->ctx, EVP_aes_256_gcm(), nullptr, nullptr, nullptr, 0) != 1)
+        return Result::Fail(-1, "AES-256-GCM init failed");
+    return Result::Ok();
+}
+
+Result AesGcmChunkCipher::Decrypt(std::uint64_t index,
+                                  bool final_chunk,
+                                  std::span<const std::uint8_t> in,
+                                  std::uint8_t* out) {
+    if (in.size() < kAesGcmTagBytes)
+        return Result::Fail(-1, "encrypted chunk " + std::to_string(index) + " truncated");
+    const std::size_t n = in.size() - kAesGcmTagBytes;
+    // The tag is needed after the plaintext has possibly overwritten `in`.
+    std::array<std::uint8_t, kAesGcmTagBytes> tag{};
+    std::copy_n(in.begin() + static_cast<std::ptrdiff_t>(n), tag.size(), tag.begin());
+
+    AesGcmNonce nonce{};
+    std::array<std::uint8_t, 9> aad{};
+    ChunkParams(impl_->base, index, final_chunk, nonce, aad);
+
+    EVP_CIPHER_CTX* ctx = impl_->ctx;
+    int len = 0;
+    if (EVP_DecryptInit_ex(ctx, nullptr, nullptr, impl_->key.data(), nonce.data()) != 1 ||
+        EVP_DecryptUpdate(ctx, nullptr, &len, aad.data(), static_cast<int>(aad.size())) != 1 ||
+        EVP_DecryptUpdate(ctx, out, &len, in.data(), static_cast<int>(n)) != 1 ||
+        EVP_CIPHER_CTX_ctrl(
+            ctx, EVP_CTRL_GCM_SET_TAG, static_cast<int>(tag.size()), tag.data()) != 1) {
+        return Result::Fail(-1, "AES-256-GCM decrypt failed");
+    }
+    if (EVP_DecryptFinal_ex(ctx, out + len, &len) != 1) {
+        return Result::Fail(
+            -1, "encrypted chunk " + std::to_string(index) + " failed authentication");
+    }
+    return Result::Ok();
+}
+
+Result AesGcmChunkCipher::Encrypt(std::uint64_t index,
+                                  bool final_chunk,
+                                  std::span<const std::uint8_t> in,
+                                  std::uint8_t* out) {
+    AesGcmNonce nonce{};
+    std::array<std::uint8_t, 9> aad{};
+    ChunkParams(impl_->base, index, final_chunk, nonce, aad);
+
+    EVP_CIPHER_CTX* ctx = impl_->ctx;
+    int len = 0;
+    if (EVP_EncryptInit_ex(ctx, nullptr, nullptr, impl_->key.data(), nonce.data()) != 1 ||
+        EVP_EncryptUpdate(ctx, nullptr, &len, aad.data(), static_cast<int>(aad.size())) != 1 ||
+        EVP_EncryptUpdate(ctx, out, &len, in.data(), static_cast<int>(in.size())) != 1 ||
+        EVP_EncryptFinal_ex(ctx, out + len, &len) != 1 ||
+        EVP_CIPHER_CTX_ctrl(ctx,
+                            EVP_CTRL_GCM_GET_TAG,
+                            static_cast<int>(kAesGcmTagBytes),
+                            out + in.size()) != 1) {
+        return Result::Fail(-1, "AES-256-GCM encrypt failed");
+    }
+    return Result::Ok();
+}
+
+Result EncryptChunkedAesGcm(const AesGcmKey& key,
+                            const ChunkedGcmHeader& header,
+                            std::span<const std::uint8_t> plaintext,
+                            std::vector<std::uint8_t>& out) {
+    if (header.chunk_bytes == 0 || header.chunk_bytes > kMaxGcmChunkBytes)
+        return Result::Fail(-1, "bad chunk size " + std::to_string(header.chunk_bytes));
+    AesGcmChunkCipher cipher;
+    auto r = cipher.Init(key, header.nonce);
+    if (!r.is_ok())
+        return r;
+
+    const std::size_t chunk = header.chunk_bytes;
+    const std::size_t chunks = std::max<std::size_t>(1, (plaintext.size() + chunk - 1) / chunk);
+    out.assign(kChunkedGcmHeaderBytes + plaintext.size() + chunks * kAesGcmTagBytes, 0);
+    std::memcpy(out.data(), kMagic, sizeof(kMagic));
+    for (int b = 0; b < 4; ++b)
+        out[8 + b] = static_cast<std::uint8_t>(header.chunk_bytes >> (8 * b));
+    std::copy(header.nonce.begin(), header.nonce.end(), out.begin() + 12);
+
+    std::uint8_t* dst = out.data() + kChunkedGcmHeaderBytes;
+    for (std::size_t i = 0; i < chunks; ++i) {
+        const auto piece =
+            plaintext.subspan(i * chunk, std::min(chunk, plaintext.size() - i * chunk));
+        r = cipher.Encrypt(i, i + 1 == chunks, piece, dst);
+        if (!r.is_ok())
+            return r;
+        dst += piece.size() + kAesGcmTagBytes;
+    }
+    return Result::Ok();
+}
+
+} // namespace flash
@@ -2,7 +2,9 @@
 
 #include "io/file_reader.hpp"
 
+#include <algorithm>
 #include <array>
+#include <cctype>
 #include <cstdint>
 #include <openssl/evp.h>
 #include <vector>
@@ -111,14 +113,14 @@ std::string Sha256Hex(IReader& reader) {
 
     std::vector<std::uint8_t> buf(64 * 1024);
     while (true) {
-        const ssize_t n = reader.Read(std::span<std::uint8_t>(buf.data(), buf.size()));
+        std::span<const std::uint8_t> chunk;
+        const ssize_t n = reader.ReadView(chunk, std::span<std::uint8_t>(buf.data(), buf.size()));
         if (n == 0)
             break;
         if (n < 0)
             return {};
-        if (!UpdateSha256(ctx, std::span<const std::uint8_t>(buf.data(), static_cast<size_t>(n)))) {
+        if (!UpdateSha256(ctx, chunk))
             return {};
-        }
     }
 
     std::array<std::uint8_t, 32> digest{};
@@ -127,6 +129,22 @@ std::string Sha256Hex(IReader& reader) {
     return HexEncode(digest);
 }
 
+bool Sha256HexEquals(std::string_view a, std::string_view b) {
+    return std::equal(a.begin(), a.end(), b.begin(), b.end(), [](char x, char y) {
+        return std::tolower(static_cast<unsigned char>(x)) ==
+               std::tolower(static_cast<unsigned char>(y));
+    });
+}
+
+std::vector<std::string> Sha256HexChunks(std::span<const std::uint8_t> data,
+                                         std::uint64_t chunk_bytes) {
+    std::vector<std::string> out;
+    for (std::uint64_t off = 0; off < data.size(); off += chunk_bytes)
+        out.push_back(Sha256Hex(data.subspan(off, std::min<std::uint64_t>(chunk_bytes,
+                                                                         data.size() - off))));
+    return out;
+}
+
 Result Sha256HexFile(const std::string& path, std::string& out_hex) {
     FileOrStdinReader reader;
     auto r = FileOrStdinReader::Open(path, reader);
@@ -0,0 +1,150 @@
+// buffer_pool.cpp - Aligned, reusable I/O buffers shared by the streaming pipeline.
+
+#include "io/buffer_pool.hpp"
+
+#include "util/logger.hpp"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <sys/mman.h>
+#include <unistd.h>
+#include <utility>
+
+namespace flash {
+
+namespace {
+
+constexpr std::size_t kHugePageBytes = 2 * 1024 * 1024;
+
+std::size_t PageSize() {
+    const long n = ::sysconf(_SC_PAGESIZE);
+    return n > 0 ? static_cast<std::size_t>(n) : 4096;
+}
+
+} // namespace
+
+BufferPool::Buffer::Buffer(Buffer&& other) noexcept
+    : pool_(std::exchange(other.pool_, nullptr)), data_(std::exchange(other.data_, nullptr)),
+      size_(std::exchange(other.size_, 0)) {}
+
+BufferPool::Buffer& BufferPool::Buffer::operator=(Buffer&& other) noexcept {
+    if (this != &other) {
+        Reset();
+        pool_ = std::exchange(other.pool_, nullptr);
+        data_ = std::exchange(other.data_, nullptr);
+        size_ = std::exchange(other.size_, 0);
+    }
+    return *this;
+}
+
+BufferPool::Buffer::~Buffer() { Reset(); }
+
+void BufferPool::Buffer::Reset() {
+    if (pool_ && data_)
+        pool_->Release(data_, size_);
+    pool_ = nullptr;
+    data_ = nullptr;
+    size_ = 0;
+}
+
+BufferPool& BufferPool::Instance() {
+    static BufferPool pool;
+    return pool;
+}
+
+BufferPool::~BufferPool() {
+    for (auto& [size, list] : idle_) {
+        for (std::uint8_t* p : list)
+            Free(p, size);
+    }
+}
+
+void BufferPool::Configure(Options opt) {
+    std::lock_guard<std::mutex> lock(mu_);
+    for (auto& [size, list] : idle_) {
+        for (std::uint8_t* p : list)
+            Free(p, size);
+    }
+    idle_.clear();
+    opt_ = std::move(opt);
+    opt_.alignment = std::max(opt_.alignment, PageSize());
+}
+
+BufferPool::Sizes BufferPool::GetSizes() const {
+    std::lock_guard<std::mutex> lock(mu_);
+    return opt_.sizes;
+}
+
+std::size_t BufferPool::PipeBytes(std::string_view target) const {
+    std::lock_guard<std::mutex> lock(mu_);
+    if (const auto it = opt_.pipe_by_target.find(std::string(target));
+        it != opt_.pipe_by_target.end()) {
+        return it->second;
+    }
+    return opt_.sizes.pipe;
+}
+
+BufferPool::Buffer BufferPool::Acquire(std::size_t size) {
+    std::lock_guard<std::mutex> lock(mu_);
+    const std::size_t rounded = RoundUp(std::max<std::size_t>(size, 1));
+    if (auto it = idle_.find(rounded); it != idle_.end() && !it->second.empty()) {
+        std::uint8_t* p = it->second.back();
+        it->second.pop_back();
+        return Buffer(this, p, rounded);
+    }
+    std::uint8_t* p = Allocate(rounded);
+    return p ? Buffer(this, p, rounded) : Buffer();
+}
+
+std::size_t BufferPool::Idle() const {
+    std::lock_guard<std::mutex> lock(mu_);
+    std::size_t n = 0;
+    for (const auto& [size, list] : idle_)
+        n += list.size();
+    return n;
+}
+
+std::size_t BufferPool::Alignment(std::size_t size) const {
+    if (opt_.huge_pages && size >= kHugePageBytes)
+        return kHugePageBytes;
+    return std::max(opt_.alignment, PageSize());
+}
+
+std::size_t BufferPool::RoundUp(std::size_t size) const {
+    const std::size_t align = Alignment(size);
+    return (size + align - 1) / align * align;
+}
+
+std::uint8_t* BufferPool::Allocate(std::size_t size) {
+    const std::size_t align = Alignment(size);
+    auto* p = static_cast<std::uint8_t*>(std::aligned_alloc(align, size));
+    if (!p)
+        return nullptr;
+    if (align == kHugePageBytes)
+        (void)::madvise(p, size, MADV_HUGEPAGE);
+    if (opt_.lock && ::mlock(p, size) != 0 && !lock_warned_) {
+        lock_warned_ = true;
+        LogWarn("mlock of I/O buffers failed: %s", std::strerror(errno));
+    }
+    return p;
+}
+
+void BufferPool::Free(std::uint8_t* data, std::size_t size) {
+    if (opt_.lock)
+        (void)::munlock(data, size);
+    std::free(data);
+}
+
+void BufferPool::Release(std::uint8_t* data, std::size_t size) {
+    std::lock_guard<std::mutex> lock(mu_);
+    auto& list = idle_[size];
+    if (size == RoundUp(size) && list.size() < opt_.max_idle_per_size) {
+        list.push_back(data);
+        return;
+    }
+    Free(data, size);
+}
+
+} // namespace flash
@@ -0,0 +1,208 @@
+#include "io/chunk_verifying_reader.hpp"
+
+#include "crypto/sha256.hpp"
+#include "util/logger.hpp"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <utility>
+
+namespace flash {
+
+namespace {
+
+// Bounds what a manifest can make the reader allocate per slot.
+constexpr std::uint64_t kMaxChunkBytes = 64 * 1024 * 1024ULL;
+
+} // namespace
+
+Result ChunkVerifyingReader::Open(std::unique_ptr<IReader> source,
+                                  std::uint64_t chunk_bytes,
+                                  std::vector<std::string> chunk_sha256,
+                                  const Options& opt,
+                                  ChunkVerifyingReader& out) {
+    if (!source)
+        return Result::Fail(-1, "Null source reader");
+    if (chunk_bytes == 0 || chunk_bytes > kMaxChunkBytes)
+        return Result::Fail(-1, "chunk-size must be 1.." + std::to_string(kMaxChunkBytes));
+    if (chunk_sha256.empty())
+        return Result::Fail(-1, "chunk-sha256 list is empty");
+
+    unsigned threads = opt.threads;
+    if (threads == 0)
+        threads = std::clamp(std::thread::hardware_concurrency(), 1U, 4U);
+    // One chunk being consumed and one being read on top of one per hashing thread.
+    std::uint64_t slots = threads + 2;
+    if (opt.max_buffer_bytes > 0) {
+        const std::uint64_t fit = opt.max_buffer_bytes / chunk_bytes;
+        if (fit < 2) {
+            return Result::Fail(ENOMEM,
+                                "chunk-size " + std::to_string(chunk_bytes) +
+                                    " needs two chunks of read-ahead, only " +
+                                    std::to_string(opt.max_buffer_bytes) + " bytes allowed");
+        }
+        slots = std::min(slots, fit);
+        threads = std::min<unsigned>(threads, static_cast<unsigned>(slots - 1));
+    }
+
+    out.source_ = std::move(source);
+    out.chunk_bytes_ = static_cast<std::size_t>(chunk_bytes);
+    out.expected_ = std::move(chunk_sha256);
+    out.slots_.resize(static_cast<std::size_t>(slots));
+    auto& pool = BufferPool::Instance();
+    for (Slot& slot : out.slots_) {
+        slot.buffer = pool.Acquire(out.chunk_bytes_);
+        if (!slot.buffer.data())
+            return Result::Fail(ENOMEM, "chunk buffer allocation failed");
+    }
+    for (unsigned i = 0; i < threads; ++i)
+        out.hashers_.emplace_back([&out] { out.HashLoop(); });
+    return Result::Ok();
+}
+
+ChunkVerifyingReader::~ChunkVerifyingReader() {
+    {
+        std::lock_guard<std::mutex> lock(mu_);
+        stop_ = true;
+    }
+    cv_.notify_all();
+    for (auto& t : hashers_)
+        t.join();
+}
+
+void ChunkVerifyingReader::Fail(std::string msg) {
+    LogError("chunk verify: %s", msg.c_str());
+    std::lock_guard<std::mutex> lock(mu_);
+    if (error_.empty())
+        error_ = std::move(msg);
+    cv_.notify_all();
+}
+
+std::string ChunkVerifyingReader::Error() const {
+    std::lock_guard<std::mutex> lock(mu_);
+    return error_;
+}
+
+void ChunkVerifyingReader::HashLoop() {
+    std::unique_lock<std::mutex> lock(mu_);
+    while (true) {
+        cv_.wait(lock, [&] { return stop_ || !work_.empty(); });
+        if (stop_)
+            return;
+        Slot& slot = slots_[work_.front()];
+        work_.pop_front();
+        lock.unlock();
+
+        const std::string actual = Sha256Hex(std::span<const std::uint8_t>(
+            slot.buffer.data(), slot.size));
+        const std::string& expected = expected_[slot.index];
+
+        lock.lock();
+        slot.state = Sha256HexEquals(actual, expected) ? State::Good : State::Bad;
+        if (slot.state == State::Bad && error_.empty()) {
+            error_ = "chunk " + std::to_string(slot.index) + " sha256 mismatch: expected=" +
+                     expected + " actual=" + actual;
+            LogError("chunk verify: %s", error_.c_str());
+        }
+        cv_.notify_all();
+    }
+}
+
+bool ChunkVerifyingReader::ReadAhead() {
+    // Free slots belong to the consumer, so the read needs no lock.
+    Slot& slot = slots_[(head_ + queued_) % slots_.size()];
+    std::size_t got = 0;
+    while (got < chunk_bytes_) {
+        const ssize_t n =
+            source_->Read(std::span<std::uint8_t>(slot.buffer.data() + got, chunk_bytes_ - got));
+        if (n < 0) {
+            Fail("read failed");
+            return false;
+        }
+        if (n == 0)
+            break;
+        got += static_cast<std::size_t>(n);
+    }
+    eof_ = got < chunk_bytes_;
+
+    if (got > 0 && chunks_read_ >= expected_.size()) {
+        Fail("entry is longer than its " + std::to_string(expected_.size()) + " chunks");
+        return false;
+    }
+    if (got > 0)
+        ++chunks_read_;
+    if (eof_ && chunks_read_ != expected_.size()) {
+        Fail("entry truncated: " + std::to_string(chunks_read_) + " of " +
+             std::to_string(expected_.size()) + " chunks");
+        return false;
+    }
+    if (got == 0)
+        return true;
+
+    std::lock_guard<std::mutex> lock(mu_);
+    slot.size = got;
+    slot.index = chunks_read_ - 1;
+    slot.state = State::Hashing;
+    work_.push_back(static_cast<std::size_t>(&slot - slots_.data()));
+    ++queued_;
+    cv_.notify_all();
+    return true;
+}
+
+bool ChunkVerifyingReader::NextChunk(ssize_t& status) {
+    while (true) {
+        // Keep every slot busy: the hashers work ahead while the caller writes.
+        while (!eof_ && queued_ < slots_.size()) {
+            if (!ReadAhead()) {
+                status = -1;
+                return false;
+            }
+        }
+
+        std::unique_lock<std::mutex> lock(mu_);
+        if (queued_ == 0) {
+            status = 0;
+            return false;
+        }
+        Slot& head = slots_[head_];
+        cv_.wait(lock, [&] { return head.state != State::Hashing || !error_.empty(); });
+        if (!error_.empty()) {
+            status = -1;
+            return false;
+        }
+        if (pos_ < head.size)
+            return true;
+        // Drained: the slot takes the next chunk.
+        head.state = State::Free;
+        head_ = (head_ + 1) % slots_.size();
+        --queued_;
+        pos_ = 0;
+    }
+}
+
+ssize_t ChunkVerifyingReader::Read(std::span<std::uint8_t> out) {
+    std::span<const std::uint8_t> view;
+    const ssize_t n = ReadView(view, out);
+    if (n > 0 && view.data() != out.data())
+        std::memcpy(out.data(), view.data(), view.size());
+    return n;
+}
+
+ssize_t ChunkVerifyingReader::ReadView(std::span<const std::uint8_t>& view,
+                                       std::span<std::uint8_t> scratch) {
+    view = {};
+    if (scratch.empty())
+        return 0;
+    ssize_t status = 0;
+    if (!NextChunk(status))
+        return status;
+    // Good slots are left alone by the hashers.
+    const Slot& slot = slots_[head_];
+    const std::size_t n = std::min(scratch.size(), slot.size - pos_);
+    view = std::span<const std::uint8_t>(slot.buffer.data() + pos_, n);
+    pos_ += n;
+    return static_cast<ssize_t>(n);
+}
+
+} // namespace flash
@@ -0,0 +1,209 @@
+#include "io/decrypting_reader.hpp"
+
+#include "util/logger.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cerrno>
+#include <cstring>
+#include <utility>
+
+namespace flash {
+
+Result DecryptingReader::Open(std::unique_ptr<IReader> source,
+                              const AesGcmKey& key,
+                              const Options& opt,
+                              DecryptingReader& out) {
+    if (!source)
+        return Result::Fail(-1, "Null source reader");
+
+    std::array<std::uint8_t, kChunkedGcmHeaderBytes> head{};
+    std::size_t got = 0;
+    while (got < head.size()) {
+        const ssize_t n = source->Read(std::span<std::uint8_t>(head).subspan(got));
+        if (n < 0)
+            return Result::Fail(-1, "read failed on encrypted payload header");
+        if (n == 0)
+            break;
+        got += static_cast<std::size_t>(n);
+    }
+    auto r = ParseChunkedGcmHeader(std::span<const std::uint8_t>(head.data(), got), out.header_);
+    if (!r.is_ok())
+        return r;
+    r = out.cipher_.Init(key, out.header_.nonce);
+    if (!r.is_ok())
+        return r;
+
+    out.encrypted_chunk_bytes_ = out.header_.chunk_bytes + kAesGcmTagBytes;
+    std::uint64_t slots = kMaxSlots;
+    if (opt.max_buffer_bytes > 0) {
+        // The worker's current and lookahead chunks come on top of the slots.
+        const std::uint64_t fit = opt.max_buffer_bytes / out.encrypted_chunk_bytes_;
+        if (fit < 3) {
+            return Result::Fail(ENOMEM,
+                                "encrypted chunk size " +
+                                    std::to_string(out.encrypted_chunk_bytes_) +
+                                    " needs three chunks of buffers, only " +
+                                    std::to_string(opt.max_buffer_bytes) + " bytes allowed");
+        }
+        slots = std::min(slots, fit - 2);
+    }
+    out.slots_.resize(static_cast<std::size_t>(slots));
+    auto& pool = BufferPool::Instance();
+    for (Slot& slot : out.slots_) {
+        slot.buffer = pool.Acquire(out.encrypted_chunk_bytes_);
+        if (!slot.buffer.data())
+            return Result::Fail(ENOMEM, "decrypt buffer allocation failed");
+    }
+    out.source_ = std::move(source);
+    out.worker_ = std::thread([&out] { out.Run(); });
+    return Result::Ok();
+}
+
+DecryptingReader::~DecryptingReader() {
+    {
+        std::lock_guard<std::mutex> lock(mu_);
+        stop_ = true;
+    }
+    cv_.notify_all();
+    if (worker_.joinable())
+        worker_.join();
+}
+
+void DecryptingReader::Fail(std::string msg) {
+    LogError("decrypt: %s", msg.c_str());
+    std::lock_guard<std::mutex> lock(mu_);
+    if (error_.empty())
+        error_ = std::move(msg);
+    done_ = true;
+    cv_.notify_all();
+}
+
+std::string DecryptingReader::Error() const {
+    std::lock_guard<std::mutex> lock(mu_);
+    return error_;
+}
+
+ssize_t DecryptingReader::ReadChunk(BufferPool::Buffer& buf) {
+    std::size_t got = 0;
+    while (got < encrypted_chunk_bytes_) {
+        const ssize_t n = source_->Read(std::span<std::uint8_t>(buf.data() + got,
+                                                               encrypted_chunk_bytes_ - got));
+        if (n < 0)
+            return -1;
+        if (n == 0)
+            break;
+        got += static_cast<std::size_t>(n);
+    }
+    return static_cast<ssize_t>(got);
+}
+
+void DecryptingReader::Run() {
+    auto& pool = BufferPool::Instance();
+    BufferPool::Buffer cur = pool.Acquire(encrypted_chunk_bytes_);
+    BufferPool::Buffer next = pool.Acquire(encrypted_chunk_bytes_);
+    if (!cur.data() || !next.data())
+        return Fail("decrypt buffer allocation failed");
+
+    // One chunk of lookahead: a chunk is only known to be the last once the next read ends.
+    ssize_t cur_n = ReadChunk(cur);
+    for (std::uint64_t index = 0;; ++index) {
+        if (cur_n < 0)
+            return Fail("read failed on encrypted payload");
+        const bool full = static_cast<std::size_t>(cur_n) == encrypted_chunk_bytes_;
+        ssize_t next_n = 0;
+        if (full) {
+            next_n = ReadChunk(next);
+            if (next_n < 0)
+                return Fail("read failed on encrypted payload");
+        }
+        const bool final_chunk = next_n == 0;
+
+        auto r = cipher_.Decrypt(index,
+                                 final_chunk,
+                                 std::span<const std::uint8_t>(cur.data(),
+                                                               static_cast<std::size_t>(cur_n)),
+                                 cur.data());
+        if (!r.is_ok())
+            return Fail(r.message());
+
+        {
+            std::unique_lock<std::mutex> lock(mu_);
+            cv_.wait(lock, [&] { return stop_ || ready_ < slots_.size(); });
+            if (stop_)
+                return;
+            Slot& slot = slots_[(head_ + ready_) % slots_.size()];
+            std::swap(slot.buffer, cur);
+            slot.size = static_cast<std::size_t>(cur_n) - kAesGcmTagBytes;
+            ++ready_;
+            if (final_chunk)
+                done_ = true;
+        }
+        cv_.notify_all();
+        if (final_chunk)
+            return;
+
+        std::swap(cur, next);
+        cur_n = next_n;
+    }
+}
+
+bool DecryptingReader::NextChunk(ssize_t& status) {
+    std::unique_lock<std::mutex> lock(mu_);
+    while (true) {
+        if (!error_.empty()) {
+            status = -1;
+            return false;
+        }
+        if (ready_ > 0 && pos_ < slots_[head_].size)
+            return true;
+        if (ready_ > 0) {
+            // Drained: hand the slot back to the worker.
+            head_ = (head_ + 1) % slots_.size();
+            --ready_;
+            pos_ = 0;
+            cv_.notify_all();
+            continue;
+        }
+        if (done_) {
+            status = 0;
+            return false;
+        }
+        cv_.wait(lock);
+    }
+}
+
+ssize_t DecryptingReader::Read(std::span<std::uint8_t> out) {
+    std::span<const std::uint8_t> view;
+    const ssize_t n = ReadView(view, out);
+    if (n > 0 && view.data() != out.data())
+        std::memcpy(out.data(), view.data(), view.size());
+    return n;
+}
+
+ssize_t DecryptingReader::ReadView(std::span<const std::uint8_t>& view,
+                                   std::span<std::uint8_t> scratch) {
+    view = {};
+    if (scratch.empty())
+        return 0;
+    ssize_t status = 0;
+    if (!NextChunk(status))
+        return status;
+    // The slot stays with the consumer until a later call finds it drained.
+    const Slot& slot = slots_[head_];
+    const std::size_t n = std::min(scratch.size(), slot.size - pos_);
+    view = std::span<const std::uint8_t>(slot.buffer.data() + pos_, n);
+    pos_ += n;
+    return static_cast<ssize_t>(n);
+}
+
+std::optional<std::uint64_t> DecryptingReader::TotalSize() const {
+    const auto total = source_ ? source_->TotalSize() : std::nullopt;
+    if (!total || *total < kChunkedGcmHeaderBytes + kAesGcmTagBytes)
+        return std::nullopt;
+    const std::uint64_t body = *total - kChunkedGcmHeaderBytes;
+    const std::uint64_t chunks = (body + encrypted_chunk_bytes_ - 1) / encrypted_chunk_bytes_;
+    return body - chunks * kAesGcmTagBytes;
+}
+
+} // namespace flash
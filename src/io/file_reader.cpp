@@ -1,5 +1,6 @@
 #include "io/file_reader.hpp"
 
+#include <algorithm>
 #include <cerrno>
 #include <cstring>
 #include <fcntl.h>
@@ -14,6 +15,7 @@ Result FileOrStdinReader::Open(std::string path, FileOrStdinReader& out) {
     if (out.path_ == "-") {
         out.fd_.Reset(STDIN_FILENO);
         out.size_ = std::nullopt;
+        out.seekable_ = false;
         return Result::Ok();
     }
 
@@ -25,7 +27,8 @@ Result FileOrStdinReader::Open(std::string path, FileOrStdinReader& out) {
     out.fd_.Reset(fd);
 
     struct stat st{};
-    if (::fstat(fd, &st) == 0 && st.st_size > 0) {
+    out.seekable_ = ::fstat(fd, &st) == 0 && S_ISREG(st.st_mode);
+    if (out.seekable_ && st.st_size > 0) {
         out.size_ = static_cast<std::uint64_t>(st.st_size);
     } else {
         out.size_ = std::nullopt;
@@ -49,4 +52,19 @@ ssize_t FileOrStdinReader::Read(std::span<std::uint8_t> out) {
     }
 }
 
+std::int64_t FileOrStdinReader::Skip(std::uint64_t n) {
+    if (!seekable_ || !size_ || n == 0)
+        return 0;
+    const off_t cur = ::lseek(fd_.Get(), 0, SEEK_CUR);
+    if (cur < 0)
+        return 0;
+    const std::uint64_t pos = static_cast<std::uint64_t>(cur);
+    const std::uint64_t step = pos >= *size_ ? 0 : std::min(n, *size_ - pos);
+    if (step == 0)
+        return 0;
+    if (::lseek(fd_.Get(), static_cast<off_t>(step), SEEK_CUR) < 0)
+        return -1;
+    return static_cast<std::int64_t>(step);
+}
+
 } // namespace flash
@@ -0,0 +1,93 @@
+// mmap_reader.cpp - Sequential reader over a read-only file mapping.
+
+#include "io/mmap_reader.hpp"
+
+#include "io/fd.hpp"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace flash {
+
+MmapReader::~MmapReader() { Unmap(); }
+
+void MmapReader::Unmap() {
+    if (data_)
+        ::munmap(const_cast<std::uint8_t*>(data_), size_);
+    data_ = nullptr;
+    size_ = 0;
+    pos_ = 0;
+    released_ = 0;
+}
+
+// Only called at the start of a read: the previous view is no longer in use by then.
+void MmapReader::ReleaseBehind() {
+    static const auto page = static_cast<std::size_t>(::sysconf(_SC_PAGESIZE));
+    const std::size_t end = pos_ - pos_ % page;
+    if (end - released_ < kReleaseBehindBytes)
+        return;
+    // The page cache keeps the data; only this mapping's references go.
+    (void)::madvise(const_cast<std::uint8_t*>(data_) + released_, end - released_, MADV_DONTNEED);
+    released_ = end;
+}
+
+Result MmapReader::Open(const std::string& path, MmapReader& out) {
+    out.Unmap();
+
+    Fd fd(::open(path.c_str(), O_RDONLY | O_CLOEXEC));
+    if (!fd.Valid()) {
+        return Result::Fail(errno,
+                            "Failed to open input: " + path + " (" + std::strerror(errno) + ")");
+    }
+    struct stat st {};
+    if (::fstat(fd.Get(), &st) != 0)
+        return Result::Fail(errno, "fstat failed: " + path);
+    if (!S_ISREG(st.st_mode))
+        return Result::Fail(EINVAL, "not a regular file: " + path);
+    if (st.st_size == 0)
+        return Result::Ok();
+
+    const auto size = static_cast<std::size_t>(st.st_size);
+    void* p = ::mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd.Get(), 0);
+    if (p == MAP_FAILED) {
+        return Result::Fail(errno, "mmap failed: " + path + " (" + std::strerror(errno) + ")");
+    }
+    (void)::madvise(p, size, MADV_SEQUENTIAL);
+    out.data_ = static_cast<const std::uint8_t*>(p);
+    out.size_ = size;
+    return Result::Ok();
+}
+
+ssize_t MmapReader::Read(std::span<std::uint8_t> out) {
+    ReleaseBehind();
+    const std::size_t n = std::min(out.size(), size_ - pos_);
+    if (n == 0)
+        return 0;
+    std::memcpy(out.data(), data_ + pos_, n);
+    pos_ += n;
+    return static_cast<ssize_t>(n);
+}
+
+ssize_t MmapReader::ReadView(std::span<const std::uint8_t>& view,
+                             std::span<std::uint8_t> scratch) {
+    ReleaseBehind();
+    const std::size_t n = std::min(scratch.size(), size_ - pos_);
+    view = std::span<const std::uint8_t>(data_ + pos_, n);
+    pos_ += n;
+    return static_cast<ssize_t>(n);
+}
+
+std::optional<std::uint64_t> MmapReader::TotalSize() const { return size_; }
+
+std::int64_t MmapReader::Skip(std::uint64_t n) {
+    const auto step = static_cast<std::size_t>(std::min<std::uint64_t>(n, size_ - pos_));
+    pos_ += step;
+    return static_cast<std::int64_t>(step);
+}
+
+} // namespace flash
@@ -4,13 +4,24 @@
 
 #include "util/path_utils.hpp"
 
+#include <array>
 #include <cerrno>
 #include <cstring>
 #include <fcntl.h>
+#include <string>
+#include <sys/stat.h>
+#include <sys/uio.h>
 #include <unistd.h>
 
 namespace flash {
 
+namespace {
+
+// iovecs handed to one writev(); longer lists are written in groups of this size.
+constexpr std::size_t kMaxIov = 16;
+
+} // namespace
+
 Result PartitionWriter::Open(std::string path, PartitionWriter& out) {
     out.path_ = std::move(path);
 
@@ -28,6 +39,35 @@ Result PartitionWriter::Open(std::string path, PartitionWriter& out) {
     return Result::Ok();
 }
 
+Result PartitionWriter::OpenAt(std::string path, std::uint64_t offset, PartitionWriter& out) {
+    out.path_ = std::move(path);
+
+    int fd = ::open(out.path_.c_str(), O_WRONLY | O_CLOEXEC);
+    if (fd < 0) {
+        return Result::Fail(
+            errno, "Failed to open output: " + out.path_ + " (" + std::strerror(errno) + ")");
+    }
+    out.fd_.Reset(fd);
+
+    if (!IsDevPath(out.path_)) {
+        struct stat st {};
+        if (::fstat(fd, &st) != 0) {
+            return Result::Fail(errno, "fstat failed: " + out.path_);
+        }
+        if (static_cast<std::uint64_t>(st.st_size) < offset) {
+            return Result::Fail(ERANGE,
+                                "Output shorter than resume offset: " + out.path_ + " (" +
+                                    std::to_string(st.st_size) + " < " + std::to_string(offset) +
+                                    ")");
+        }
+    }
+    if (::lseek(fd, static_cast<off_t>(offset), SEEK_SET) < 0) {
+        return Result::Fail(errno,
+                            "Seek failed: " + out.path_ + " (" + std::strerror(errno) + ")");
+    }
+    return Result::Ok();
+}
+
 Result PartitionWriter::WriteAll(std::span<const std::uint8_t> in) {
     size_t rem = in.size();
     const std::uint8_t* p = in.data();
@@ -48,6 +88,39 @@ Result PartitionWriter::WriteAll(std::span<const std::uint8_t> in) {
     return Result::Ok();
 }
 
+Result PartitionWriter::WriteV(std::span<const std::span<const std::uint8_t>> in) {
+    std::array<iovec, kMaxIov> iov{};
+    while (!in.empty()) {
+        std::size_t cnt = 0;
+        for (; cnt < iov.size() && cnt < in.size(); ++cnt)
+            iov[cnt] = {const_cast<std::uint8_t*>(in[cnt].data()), in[cnt].size()};
+        in = in.subspan(cnt);
+
+        iovec* cur = iov.data();
+        while (cnt > 0) {
+            const ssize_t n = ::writev(fd_.Get(), cur, static_cast<int>(cnt));
+            if (n < 0) {
+                if (errno == EINTR)
+                    continue;
+                return Result::Fail(errno,
+                                    "Write failed (" + std::string(std::strerror(errno)) + ")");
+            }
+            // Drop what was written; a short write leaves the rest of one iovec.
+            auto done = static_cast<std::size_t>(n);
+            while (cnt > 0 && done >= cur->iov_len) {
+                done -= cur->iov_len;
+                ++cur;
+                --cnt;
+            }
+            if (cnt > 0) {
+                cur->iov_base = static_cast<std::uint8_t*>(cur->iov_base) + done;
+                cur->iov_len -= done;
+            }
+        }
+    }
+    return Result::Ok();
+}
+
 Result PartitionWriter::FsyncNow() {
     if (::fsync(fd_.Get()) == -1) {
         return Result::Fail(errno, "fsync failed (" + std::string(std::strerror(errno)) + ")");
@@ -55,4 +128,12 @@ Result PartitionWriter::FsyncNow() {
     return Result::Ok();
 }
 
+Result PartitionWriter::StartWriteback() {
+    if (::sync_file_range(fd_.Get(), 0, 0, SYNC_FILE_RANGE_WRITE) == -1) {
+        return Result::Fail(
+            errno, "sync_file_range failed (" + std::string(std::strerror(errno)) + ")");
+    }
+    return Result::Ok();
+}
+
 } // namespace flash
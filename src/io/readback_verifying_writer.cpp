@@ -0,0 +1,159 @@
+// readback_verifying_writer.cpp - On-device chunk verification running beside the writer.
+
+#include "io/readback_verifying_writer.hpp"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <unistd.h>
+#include <vector>
+
+namespace flash {
+
+ReadbackVerifyingWriter::ReadbackVerifyingWriter(IWriter& inner) : inner_(inner) {}
+
+ReadbackVerifyingWriter::~ReadbackVerifyingWriter() { StopWorker(); }
+
+Result ReadbackVerifyingWriter::Start(const std::string& target_path) {
+    const int fd = ::open(target_path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        return Result::Fail(errno,
+                            "readback open failed: " + target_path + " (" + std::strerror(errno) +
+                                ")");
+    }
+    readback_fd_.Reset(fd);
+    worker_ = std::thread([this] { WorkerLoop(); });
+    return Result::Ok();
+}
+
+Result ReadbackVerifyingWriter::WriteAll(std::span<const std::uint8_t> in) {
+    if (failed_.load(std::memory_order_acquire))
+        return FailureIfAny();
+
+    auto r = inner_.WriteAll(in);
+    if (!r.is_ok())
+        return r;
+    hasher_.Update(in);
+    pending_length_ += in.size();
+    return Result::Ok();
+}
+
+Result ReadbackVerifyingWriter::WriteV(std::span<const std::span<const std::uint8_t>> in) {
+    if (failed_.load(std::memory_order_acquire))
+        return FailureIfAny();
+
+    auto r = inner_.WriteV(in);
+    if (!r.is_ok())
+        return r;
+    for (const auto& piece : in) {
+        hasher_.Update(piece);
+        pending_length_ += piece.size();
+    }
+    return Result::Ok();
+}
+
+Result ReadbackVerifyingWriter::FsyncNow() {
+    auto r = inner_.FsyncNow();
+    if (!r.is_ok())
+        return r;
+
+    if (pending_length_ > 0) {
+        Chunk chunk{pending_offset_, pending_length_, hasher_.FinalHex()};
+        hasher_ = Sha256Hasher();
+        pending_offset_ += pending_length_;
+        pending_length_ = 0;
+        {
+            std::lock_guard<std::mutex> lk(mu_);
+            queue_.push_back(std::move(chunk));
+        }
+        cv_.notify_one();
+    }
+    return FailureIfAny();
+}
+
+Result ReadbackVerifyingWriter::Finish() {
+    auto r = FsyncNow();
+    StopWorker();
+    if (!r.is_ok())
+        return r;
+    return FailureIfAny();
+}
+
+void ReadbackVerifyingWriter::StopWorker() {
+    {
+        std::lock_guard<std::mutex> lk(mu_);
+        stop_ = true;
+    }
+    cv_.notify_one();
+    if (worker_.joinable())
+        worker_.join();
+}
+
+Result ReadbackVerifyingWriter::FailureIfAny() {
+    if (!failed_.load(std::memory_order_acquire))
+        return Result::Ok();
+    std::lock_guard<std::mutex> lk(mu_);
+    return failure_;
+}
+
+void ReadbackVerifyingWriter::WorkerLoop() {
+    while (true) {
+        Chunk chunk;
+        {
+            std::unique_lock<std::mutex> lk(mu_);
+            cv_.wait(lk, [this] { return stop_ || !queue_.empty(); });
+            if (queue_.empty())
+                return; // stop_ with nothing left to verify
+            chunk = std::move(queue_.front());
+            queue_.pop_front();
+        }
+
+        if (failed_.load(std::memory_order_acquire))
+            continue;
+
+        auto r = VerifyChunk(chunk);
+        if (!r.is_ok()) {
+            std::lock_guard<std::mutex> lk(mu_);
+            failure_ = std::move(r);
+            failed_.store(true, std::memory_order_release);
+            continue;
+        }
+        verified_bytes_.fetch_add(chunk.length);
+    }
+}
+
+Result ReadbackVerifyingWriter::VerifyChunk(const Chunk& chunk) {
+    const int fd = readback_fd_.Get();
+    const auto off = static_cast<off_t>(chunk.offset);
+    const auto len = static_cast<off_t>(chunk.length);
+
+    // The range was just fsync'ed, so its pages are clean: drop them to read from the device.
+    (void)::posix_fadvise(fd, off, len, POSIX_FADV_DONTNEED);
+
+    Sha256Hasher hasher;
+    std::vector<std::uint8_t> buf(1024 * 1024);
+    std::uint64_t done = 0;
+    while (done < chunk.length) {
+        const size_t want =
+            static_cast<size_t>(std::min<std::uint64_t>(buf.size(), chunk.length - done));
+        const ssize_t n = ::pread(fd, buf.data(), want, off + static_cast<off_t>(done));
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n <= 0) {
+            return Result::Fail(n < 0 ? errno : EIO,
+                                "readback failed at offset " + std::to_string(chunk.offset + done));
+        }
+        hasher.Update(std::span<const std::uint8_t>(buf.data(), static_cast<size_t>(n)));
+        done += static_cast<std::uint64_t>(n);
+    }
+
+    if (hasher.FinalHex() != chunk.sha256) {
+        return Result::Fail(EIO,
+                            "readback mismatch in chunk at offset " + std::to_string(chunk.offset) +
+                                " (" + std::to_string(chunk.length) + " bytes)");
+    }
+    return Result::Ok();
+}
+
+} // namespace flash
@@ -0,0 +1,124 @@
+// streaming_file_writer.cpp - Large-file writer with windowed writeback and drop-behind.
+
+#include "io/streaming_file_writer.hpp"
+
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <unistd.h>
+
+namespace flash {
+
+namespace {
+
+Result ErrnoFail(const std::string& what, const std::string& path) {
+    const int err = errno;
+    return Result::Fail(err, what + " failed: " + path + " (" + std::strerror(err) + ")");
+}
+
+} // namespace
+
+Result StreamingFileWriter::Open(const std::string& path,
+                                 const Options& opt,
+                                 StreamingFileWriter& out) {
+    out.path_ = path;
+    out.opt_ = opt;
+    out.pos_ = 0;
+    out.window_start_ = 0;
+    out.flushed_start_ = 0;
+
+    const int fd = ::open(path.c_str(), O_WRONLY | O_NOFOLLOW | O_CLOEXEC);
+    if (fd < 0)
+        return ErrnoFail("open", path);
+    out.fd_.Reset(fd);
+
+    if (opt.preallocate_bytes > 0) {
+        // Best effort: not every filesystem supports it and the data path does not need it.
+        if (::fallocate(fd, 0, 0, static_cast<off_t>(opt.preallocate_bytes)) != 0 &&
+            errno != EOPNOTSUPP) {
+            return ErrnoFail("fallocate", path);
+        }
+    }
+    return Result::Ok();
+}
+
+Result StreamingFileWriter::WriteAt(std::span<const std::uint8_t> in, std::uint64_t offset) {
+    const std::uint8_t* p = in.data();
+    size_t rem = in.size();
+    std::uint64_t off = offset;
+
+    while (rem > 0) {
+        const ssize_t n = ::pwrite(fd_.Get(), p, rem, static_cast<off_t>(off));
+        if (n > 0) {
+            p += static_cast<size_t>(n);
+            rem -= static_cast<size_t>(n);
+            off += static_cast<std::uint64_t>(n);
+            continue;
+        }
+        if (n == -1 && errno == EINTR)
+            continue;
+        return ErrnoFail("write", path_);
+    }
+
+    pos_ = off;
+    return AfterWrite(off);
+}
+
+Result StreamingFileWriter::WriteAll(std::span<const std::uint8_t> in) { return WriteAt(in, pos_); }
+
+Result StreamingFileWriter::AfterWrite(std::uint64_t end) {
+    if (opt_.window_bytes == 0 || end < window_start_ + opt_.window_bytes)
+        return Result::Ok();
+
+    const int fd = fd_.Get();
+    // Kick off writeback of the window that just filled up...
+    if (::sync_file_range(fd,
+                          static_cast<off_t>(window_start_),
+                          static_cast<off_t>(end - window_start_),
+                          SYNC_FILE_RANGE_WRITE) != 0) {
+        return ErrnoFail("sync_file_range", path_);
+    }
+
+    // ...and wait for the one before it, which has had a whole window's time to complete.
+    if (window_start_ > flushed_start_) {
+        const auto off = static_cast<off_t>(flushed_start_);
+        const auto len = static_cast<off_t>(window_start_ - flushed_start_);
+        if (::sync_file_range(fd,
+                              off,
+                              len,
+                              SYNC_FILE_RANGE_WAIT_BEFORE | SYNC_FILE_RANGE_WRITE |
+                                  SYNC_FILE_RANGE_WAIT_AFTER) != 0) {
+            return ErrnoFail("sync_file_range", path_);
+        }
+        if (opt_.drop_behind)
+            (void)::posix_fadvise(fd, off, len, POSIX_FADV_DONTNEED);
+        flushed_start_ = window_start_;
+    }
+    window_start_ = end;
+    return Result::Ok();
+}
+
+Result StreamingFileWriter::FsyncNow() {
+    if (::fsync(fd_.Get()) == -1)
+        return ErrnoFail("fsync", path_);
+    if (opt_.drop_behind)
+        (void)::posix_fadvise(fd_.Get(), 0, 0, POSIX_FADV_DONTNEED);
+    flushed_start_ = window_start_ = pos_;
+    return Result::Ok();
+}
+
+Result StreamingFileWriter::Close() {
+    if (!fd_.Valid())
+        return Result::Ok();
+
+    if (pos_ > window_start_) {
+        (void)::sync_file_range(fd_.Get(),
+                                static_cast<off_t>(window_start_),
+                                static_cast<off_t>(pos_ - window_start_),
+                                SYNC_FILE_RANGE_WRITE);
+    }
+    fd_.Close();
+    return Result::Ok();
+}
+
+} // namespace flash
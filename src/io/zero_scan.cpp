@@ -0,0 +1,49 @@
+// zero_scan.cpp - Zero-run detection used to leave holes instead of writing zeros.
+
+#include "io/zero_scan.hpp"
+
+#include <algorithm>
+#include <cstring>
+
+namespace flash {
+
+bool IsAllZero(std::span<const std::uint8_t> data) {
+    if (data.empty())
+        return true;
+    // Comparing the buffer with itself shifted by one byte lets memcmp's vectorised loop do
+    // the scan; it only returns 0 when every byte equals the (zero) first one.
+    return data[0] == 0 && std::memcmp(data.data(), data.data() + 1, data.size() - 1) == 0;
+}
+
+void SplitNonZero(std::span<const std::uint8_t> data,
+                  std::uint64_t offset,
+                  std::size_t block_bytes,
+                  std::vector<DataPiece>& out) {
+    out.clear();
+    if (block_bytes == 0) {
+        out.push_back(DataPiece{offset, data});
+        return;
+    }
+
+    std::size_t pos = 0;
+    while (pos < data.size()) {
+        const std::uint64_t file_off = offset + pos;
+        const std::size_t to_boundary =
+            block_bytes - static_cast<std::size_t>(file_off % block_bytes);
+        const std::size_t len = std::min(to_boundary, data.size() - pos);
+        const auto slice = data.subspan(pos, len);
+
+        if (!IsAllZero(slice)) {
+            if (!out.empty() && out.back().offset + out.back().data.size() == file_off) {
+                out.back().data = data.subspan(
+                    static_cast<std::size_t>(out.back().offset - offset),
+                    out.back().data.size() + len);
+            } else {
+                out.push_back(DataPiece{file_off, slice});
+            }
+        }
+        pos += len;
+    }
+}
+
+} // namespace flash
@@ -1,10 +1,12 @@
 #define _FILE_OFFSET_BITS 64
 
+#include "io/buffer_pool.hpp"
 #include "ota/ota_installer.hpp"
 #include "ota/progress_sinks.hpp"
 #include "system/signals.hpp"
 #include "util/logger.hpp"
 
+#include <cstdint>
 #include <getopt.h>
 #include <string>
 
@@ -13,18 +15,37 @@ namespace {
 struct CliOptions {
     std::string input_path;
     std::string progress_file;
+    std::string journal_path;
+    std::string cache_dir;
+    std::string staging_dir;
+    std::string key_file;
+    std::uint64_t cache_max_mb = 0;
+    std::uint64_t io_buffer_kb = 0;
+    std::uint64_t memory_budget_mb = 0;
+    bool group_commit = false;
     bool verbose = false;
     bool show_help = false;
 };
 
 void PrintUsage(const char* argv0) {
-    LogError("Usage: %s -i <ota.tar | -> [-v] [--progress-file <path>]", argv0);
+    LogError("Usage: %s -i <ota.tar | -> [-v] [--progress-file <path>] [--journal <path>] "
+             "[--cache-dir <dir> [--cache-max-mb <n>]] [--staging-dir <dir>] [--group-commit] "
+             "[--io-buffer-kb <n>] [--memory-budget <MiB>] [--decryption-key <file>]",
+             argv0);
 }
 
 bool ParseCliOptions(int argc, char** argv, CliOptions& out) {
     static option long_opts[] = {
         {"input", required_argument, nullptr, 'i'},
         {"progress-file", required_argument, nullptr, 'p'},
+        {"journal", required_argument, nullptr, 'j'},
+        {"cache-dir", required_argument, nullptr, 'c'},
+        {"cache-max-mb", required_argument, nullptr, 'm'},
+        {"staging-dir", required_argument, nullptr, 's'},
+        {"group-commit", no_argument, nullptr, 'g'},
+        {"io-buffer-kb", required_argument, nullptr, 'b'},
+        {"memory-budget", required_argument, nullptr, 'M'},
+        {"decryption-key", required_argument, nullptr, 'k'},
         {"verbose", no_argument, nullptr, 'v'},
         {"help", no_argument, nullptr, 'h'},
         {nullptr, 0, nullptr, 0},
@@ -32,17 +53,53 @@ bool ParseCliOptions(int argc, char** argv, CliOptions& out) {
 
     int idx = 0;
     int c;
-    while ((c = getopt_long(argc, argv, "hi:p:v", long_opts, &idx)) != -1) {
+    while ((c = getopt_long(argc, argv, "M:b:c:ghi:j:k:m:p:s:v", long_opts, &idx)) != -1) {
         switch (c) {
+        case 'M':
+            try {
+                out.memory_budget_mb = std::stoull(optarg);
+            } catch (const std::exception&) {
+                return false;
+            }
+            break;
+        case 'b':
+            try {
+                out.io_buffer_kb = std::stoull(optarg);
+            } catch (const std::exception&) {
+                return false;
+            }
+            break;
+        case 'c':
+            out.cache_dir = optarg;
+            break;
+        case 'g':
+            out.group_commit = true;
+            break;
         case 'h':
             out.show_help = true;
             return true;
         case 'i':
             out.input_path = optarg;
             break;
+        case 'j':
+            out.journal_path = optarg;
+            break;
+        case 'k':
+            out.key_file = optarg;
+            break;
+        case 'm':
+            try {
+                out.cache_max_mb = std::stoull(optarg);
+            } catch (const std::exception&) {
+                return false;
+            }
+            break;
         case 'p':
             out.progress_file = optarg;
             break;
+        case 's':
+            out.staging_dir = optarg;
+            break;
         case 'v':
             out.verbose = true;
             break;
@@ -72,6 +129,12 @@ int main(int argc, char** argv) {
         flash::Logger::Instance().SetLevel(flash::LogLevel::Debug);
     }
 
+    if (options.io_buffer_kb > 0) {
+        flash::BufferPool::Options pool_opt;
+        pool_opt.sizes.pipe = pool_opt.sizes.staging = options.io_buffer_kb * 1024;
+        flash::BufferPool::Instance().Configure(pool_opt);
+    }
+
     flash::OtaInstaller installer;
     std::unique_ptr<flash::IProgress> progress_sink;
     if (!options.progress_file.empty()) {
@@ -80,6 +143,26 @@ int main(int argc, char** argv) {
         progress_sink = std::make_unique<flash::ConsoleProgressSink>();
     }
     installer.SetProgressSink(progress_sink.get());
+    if (!options.journal_path.empty()) {
+        installer.SetJournalPath(options.journal_path);
+    }
+    installer.SetGroupCommit(options.group_commit);
+    installer.SetMemoryBudget(options.memory_budget_mb * 1024 * 1024);
+    if (!options.key_file.empty()) {
+        installer.SetDecryptionKeyFile(options.key_file);
+    }
+    if (!options.staging_dir.empty()) {
+        flash::StagingBackend::Options staging_opt;
+        staging_opt.dir = options.staging_dir;
+        installer.SetStagingOptions(staging_opt);
+    }
+    if (!options.cache_dir.empty()) {
+        flash::StagingCache::Options cache_opt;
+        cache_opt.dir = options.cache_dir;
+        if (options.cache_max_mb > 0)
+            cache_opt.max_bytes = options.cache_max_mb * 1024 * 1024;
+        installer.SetStagingCache(cache_opt);
+    }
     auto r = installer.Run(options.input_path);
     if (!r.is_ok()) {
         LogError("%s", r.message().c_str());
@@ -1,19 +1,62 @@
 #include "ota/archive_installer.hpp"
 
+#include "io/buffer_pool.hpp"
+#include "ota/async_finalizer.hpp"
 #include "ota/mount_session.hpp"
 #include "ota/tar_stream_extractor.hpp"
 #include "util/logger.hpp"
 #include "util/path_utils.hpp"
 
+#include <cerrno>
 #include <filesystem>
 #include <span>
 #include <sys/mount.h>
-#include <vector>
 
 namespace fs = std::filesystem;
 
 namespace flash {
 
+namespace {
+
+constexpr std::string_view kBulkExtractProfile = "bulk-extract";
+
+struct MountProfile {
+    unsigned long flags = 0;
+    std::string data;
+    bool remount_after = false;
+};
+
+// One-shot bulk extraction does not need atime updates, per-commit barriers or ordered data
+// journalling; the remount + syncfs at the end restores normal options and makes the result
+// durable before the slot can be marked good.
+Result ResolveMountProfile(std::string_view profile,
+                           std::string_view fs_type,
+                           unsigned long base_flags,
+                           const std::string& base_data,
+                           MountProfile& out) {
+    out.flags = base_flags;
+    out.data = base_data;
+    out.remount_after = false;
+
+    if (profile.empty())
+        return Result::Ok();
+    if (profile != kBulkExtractProfile)
+        return Result::Fail(-1, "unknown mount profile: " + std::string(profile));
+
+    out.flags = base_flags & ~static_cast<unsigned long>(MS_RELATIME);
+    out.flags |= MS_NOATIME | MS_LAZYTIME;
+    if (fs_type == "ext4") {
+        std::string data = "data=writeback,barrier=0,commit=60";
+        if (!base_data.empty())
+            data += "," + base_data;
+        out.data = std::move(data);
+    }
+    out.remount_after = true;
+    return Result::Ok();
+}
+
+} // namespace
+
 ArchiveInstaller::ArchiveInstaller() : opt_() { opt_.mount_flags = MS_RELATIME; }
 
 ArchiveInstaller::ArchiveInstaller(Options opt) : opt_(std::move(opt)) {
@@ -31,17 +74,42 @@ Result ArchiveInstaller::InstallTarStreamToTarget(IReader& tar_stream,
     xopt.progress = opt_.progress;
     xopt.progress_interval_bytes = opt_.progress_interval_bytes;
     xopt.safe_paths_only = opt_.safe_paths_only;
+    const bool format = opt_.format_before_mount && opt_.resume_entries == 0;
+    if (opt_.format_before_mount && !format) {
+        LogInfo("[%.*s] resuming; keeping the partially extracted filesystem",
+                (int)tag.size(),
+                tag.data());
+    }
+    xopt.unlink_existing = !(format && IsDevPath(install_to));
     xopt.progress_sink = opt_.progress_sink;
     xopt.component_total_bytes = opt_.component_total_bytes;
     xopt.overall_total_bytes = opt_.overall_total_bytes;
     xopt.overall_done_base_bytes = opt_.overall_done_base_bytes;
+    xopt.resume_entries = opt_.resume_entries;
+    xopt.bounded_decoders = opt_.bounded_decoders;
+    // bulk-extract turns ext4 barriers off, so syncfs does not reach the media and a checkpoint
+    // could record entries a power cut loses. Those installs only become durable at the final
+    // remount + syncfs.
+    const bool barriers_off = IsDevPath(install_to) && opt_.mount_profile == kBulkExtractProfile &&
+                              opt_.fs_type == "ext4";
+    if (barriers_off && opt_.on_checkpoint) {
+        LogInfo("[%.*s] %s: no resume checkpoints without barriers",
+                (int)tag.size(),
+                tag.data(),
+                opt_.mount_profile.c_str());
+    }
+    if (!barriers_off)
+        xopt.on_checkpoint = opt_.on_checkpoint;
     TarStreamExtractor extractor(xopt);
 
     auto drain_stream = [&]() -> Result {
-        std::vector<std::uint8_t> drain_buf(64 * 1024);
+        auto& pool = BufferPool::Instance();
+        BufferPool::Buffer drain_buf = pool.Acquire(pool.GetSizes().drain);
+        if (!drain_buf.data())
+            return Result::Fail(ENOMEM, "drain buffer allocation failed");
         while (true) {
-            const ssize_t n =
-                tar_stream.Read(std::span<std::uint8_t>(drain_buf.data(), drain_buf.size()));
+            std::span<const std::uint8_t> discarded;
+            const ssize_t n = tar_stream.ReadView(discarded, drain_buf.Span());
             if (n == 0)
                 break;
             if (n < 0)
@@ -51,6 +119,12 @@ Result ArchiveInstaller::InstallTarStreamToTarget(IReader& tar_stream,
     };
 
     if (IsDevPath(install_to)) {
+        MountProfile profile;
+        auto pr = ResolveMountProfile(
+            opt_.mount_profile, opt_.fs_type, opt_.mount_flags, opt_.mount_data, profile);
+        if (!pr.is_ok())
+            return pr;
+
         MountSession session;
         LogInfo("[%.*s] mount %.*s",
                 (int)tag.size(),
@@ -58,12 +132,30 @@ Result ArchiveInstaller::InstallTarStreamToTarget(IReader& tar_stream,
                 (int)install_to.size(),
                 install_to.data());
 
-        auto mr = MountSession::MountDevice(install_to,
-                                            opt_.mount_base_dir,
-                                            opt_.mount_prefix,
-                                            opt_.fs_type,
-                                            opt_.mount_flags,
-                                            session);
+        Result mr;
+        if (format) {
+            LogInfo("[%.*s] format %.*s as %s",
+                    (int)tag.size(),
+                    tag.data(),
+                    (int)install_to.size(),
+                    install_to.data(),
+                    opt_.fs_type.c_str());
+            mr = MountSession::FormatAndMountDevice(install_to,
+                                                    opt_.mount_base_dir,
+                                                    opt_.mount_prefix,
+                                                    opt_.fs_type,
+                                                    profile.flags,
+                                                    profile.data,
+                                                    session);
+        } else {
+            mr = MountSession::MountDevice(install_to,
+                                           opt_.mount_base_dir,
+                                           opt_.mount_prefix,
+                                           opt_.fs_type,
+                                           profile.flags,
+                                           profile.data,
+                                           session);
+        }
         if (!mr.is_ok())
             return mr;
 
@@ -77,14 +169,42 @@ Result ArchiveInstaller::InstallTarStreamToTarget(IReader& tar_stream,
         if (!dr.is_ok())
             return dr;
 
-        auto ur = session.Unmount();
-        if (!ur.is_ok())
-            return ur;
+        // Re-enable barriers so the final syncfs also flushes the device write cache.
+        std::string data = opt_.mount_data;
+        if (opt_.fs_type == "ext4")
+            data = data.empty() ? "barrier=1" : "barrier=1," + data;
+        auto finish = [session = std::move(session),
+                       remount = profile.remount_after,
+                       flags = opt_.mount_flags,
+                       data = std::move(data)]() mutable {
+            if (remount) {
+                auto rr = session.Remount(flags, data);
+                if (!rr.is_ok())
+                    return rr;
+            }
+            auto sr = session.Sync();
+            if (!sr.is_ok())
+                return sr;
+            return session.Unmount();
+        };
+        if (opt_.finalizer) {
+            opt_.finalizer->SubmitCommit({std::string(tag) + " unmount", std::move(finish)});
+        } else {
+            auto fr = finish();
+            if (!fr.is_ok())
+                return fr;
+        }
 
         LogInfo("[%.*s] archive install done", (int)tag.size(), tag.data());
         return Result::Ok();
     }
 
+    if (opt_.format_before_mount) {
+        LogWarn("[%.*s] format requested for non-device target, ignored",
+                (int)tag.size(),
+                tag.data());
+    }
+
     fs::path dst(install_to);
     std::error_code ec;
     fs::create_directories(dst, ec);
@@ -0,0 +1,181 @@
+// async_finalizer.cpp - Background, ordered execution of component finalisation steps.
+
+#include "ota/async_finalizer.hpp"
+
+#include "io/fd.hpp"
+#include "util/logger.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cstddef>
+#include <cstring>
+#include <fcntl.h>
+#include <unistd.h>
+
+namespace flash {
+
+namespace {
+
+// Upper bound on concurrent syncs during a group commit.
+constexpr std::size_t kCommitThreads = 8;
+
+Result FailTask(const std::string& what, const Result& r) {
+    return Result::Fail(r.err, "finalize '" + what + "' failed: " + r.message());
+}
+
+Result FsyncDir(const std::string& dir) {
+    Fd fd(::open(dir.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC));
+    if (!fd.Valid() || ::fsync(fd.Get()) != 0) {
+        const int err = errno;
+        return Result::Fail(err, "fsync failed: " + dir + " (" + std::strerror(err) + ")");
+    }
+    return Result::Ok();
+}
+
+Result RunCommit(AsyncFinalizer::Commit& c) {
+    auto r = c.sync();
+    if (r.is_ok() && c.publish)
+        r = c.publish();
+    if (r.is_ok() && !c.dir.empty())
+        r = FsyncDir(c.dir);
+    return r;
+}
+
+} // namespace
+
+AsyncFinalizer::AsyncFinalizer() : AsyncFinalizer(Options{}) {}
+
+AsyncFinalizer::AsyncFinalizer(Options opt) : opt_(opt), thread_([this] { Run(); }) {}
+
+AsyncFinalizer::~AsyncFinalizer() {
+    {
+        std::lock_guard<std::mutex> lock(mu_);
+        stop_ = true;
+    }
+    wake_.notify_one();
+    thread_.join();
+}
+
+void AsyncFinalizer::Submit(std::string what, Task task) {
+    {
+        std::lock_guard<std::mutex> lock(mu_);
+        if (opt_.group_commit)
+            after_commit_.emplace_back(std::move(what), std::move(task));
+        else
+            queue_.emplace_back(std::move(what), std::move(task));
+    }
+    wake_.notify_one();
+}
+
+void AsyncFinalizer::SubmitCommit(Commit commit) {
+    if (!opt_.group_commit) {
+        std::string what = commit.what;
+        Submit(std::move(what), [c = std::move(commit)]() mutable { return RunCommit(c); });
+        return;
+    }
+    std::lock_guard<std::mutex> lock(mu_);
+    commits_.push_back(std::move(commit));
+}
+
+Result AsyncFinalizer::Barrier() {
+    std::unique_lock<std::mutex> lock(mu_);
+    idle_.wait(lock, [this] { return queue_.empty() && !busy_; });
+    if (commits_.empty() && after_commit_.empty())
+        return error_;
+
+    auto commits = std::move(commits_);
+    auto after = std::move(after_commit_);
+    commits_.clear();
+    after_commit_.clear();
+    if (!error_.is_ok())
+        return error_;
+
+    lock.unlock();
+    auto r = RunGroupCommit(commits, after);
+    lock.lock();
+    if (!r.is_ok() && error_.is_ok())
+        error_ = r;
+    return error_;
+}
+
+Result AsyncFinalizer::Error() const {
+    std::lock_guard<std::mutex> lock(mu_);
+    return error_;
+}
+
+void AsyncFinalizer::Run() {
+    std::unique_lock<std::mutex> lock(mu_);
+    while (true) {
+        wake_.wait(lock, [this] { return stop_ || !queue_.empty(); });
+        if (queue_.empty())
+            return;
+
+        auto [what, task] = std::move(queue_.front());
+        queue_.pop_front();
+        if (!error_.is_ok()) {
+            LogDebug("finalize skipped after failure: %s", what.c_str());
+        } else {
+            busy_ = true;
+            lock.unlock();
+            Result r = task();
+            lock.lock();
+            busy_ = false;
+            if (!r.is_ok())
+                error_ = FailTask(what, r);
+        }
+        if (queue_.empty())
+            idle_.notify_all();
+    }
+}
+
+Result AsyncFinalizer::RunGroupCommit(std::vector<Commit>& commits,
+                                      std::deque<std::pair<std::string, Task>>& after) {
+    LogDebug("group commit: %zu commits, %zu tasks", commits.size(), after.size());
+
+    // Phase 1: every sync, in parallel. Nothing is published unless all of them succeed.
+    std::vector<Result> synced(commits.size());
+    std::atomic<std::size_t> next{0};
+    auto worker = [&] {
+        for (std::size_t i = next++; i < commits.size(); i = next++)
+            synced[i] = commits[i].sync();
+    };
+    std::vector<std::thread> threads;
+    const std::size_t n_threads = std::min(commits.size(), kCommitThreads);
+    for (std::size_t t = 1; t < n_threads; ++t)
+        threads.emplace_back(worker);
+    worker();
+    for (auto& t : threads)
+        t.join();
+    for (std::size_t i = 0; i < commits.size(); ++i) {
+        if (!synced[i].is_ok())
+            return FailTask(commits[i].what, synced[i]);
+    }
+
+    // Phase 2: publish in order, then make the directory entries durable once per directory.
+    std::vector<std::string> dirs;
+    for (auto& c : commits) {
+        if (c.publish) {
+            auto r = c.publish();
+            if (!r.is_ok())
+                return FailTask(c.what, r);
+        }
+        if (!c.dir.empty() && std::find(dirs.begin(), dirs.end(), c.dir) == dirs.end())
+            dirs.push_back(c.dir);
+    }
+    for (const auto& dir : dirs) {
+        auto r = FsyncDir(dir);
+        if (!r.is_ok())
+            return r;
+    }
+
+    // Phase 3: whatever depended on the commit (e.g. journal updates).
+    for (auto& [what, task] : after) {
+        auto r = task();
+        if (!r.is_ok())
+            return FailTask(what, r);
+    }
+    return Result::Ok();
+}
+
+} // namespace flash
@@ -1,22 +1,33 @@
 #include "ota/component_installers.hpp"
 
+#include "io/buffer_pool.hpp"
+#include "io/fd.hpp"
 #include "io/partition_writer.hpp"
+#include "io/readback_verifying_writer.hpp"
 #include "ota/archive_installer.hpp"
+#include "ota/async_finalizer.hpp"
+#include "ota/fs_image_builder.hpp"
+#include "ota/readonly_image.hpp"
+#include "ota/staging_verifier.hpp"
+#include "system/process.hpp"
 #include "util/logger.hpp"
 #include "util/path_utils.hpp"
 
+#include <algorithm>
+#include <array>
 #include <cerrno>
 #include <cstring>
+#include <fcntl.h>
 #include <filesystem>
+#include <linux/fs.h>
 #include <optional>
+#include <sys/ioctl.h>
 #include <sys/stat.h>
 #include <unistd.h>
 #include <vector>
 
 namespace flash {
 
-namespace {
-
 void EmitProgress(const UpdateModule::Options& opt,
                   const char* tag,
                   std::uint64_t in_done,
@@ -70,31 +81,76 @@ void EmitProgress(const UpdateModule::Options& opt,
     }
 }
 
+namespace {
+
+// Consumes exactly n bytes of input, seeking when the reader allows it.
+Result SkipInput(IReader& r, std::uint64_t n, std::span<std::uint8_t> scratch) {
+    while (n > 0) {
+        const std::int64_t k = r.Skip(n);
+        if (k < 0)
+            return Result::Fail(errno, "Skip failed during resume");
+        if (k > 0) {
+            n -= static_cast<std::uint64_t>(k);
+            continue;
+        }
+        const size_t want = static_cast<size_t>(std::min<std::uint64_t>(n, scratch.size()));
+        std::span<const std::uint8_t> discarded;
+        const ssize_t got = r.ReadView(discarded, scratch.first(want));
+        if (got < 0)
+            return Result::Fail(errno, "Read failed during resume");
+        if (got == 0)
+            return Result::Fail(-1, "Input ended before resume offset");
+        n -= static_cast<std::uint64_t>(got);
+    }
+    return Result::Ok();
+}
+
+// `target` selects the buffer size. Without final_sync the caller owns the last fsync (and
+// reports durability through it).
 Result PipeReaderToWriter(IReader& r,
                           IWriter& w,
+                          std::string_view target,
                           const UpdateModule::Options& opt,
                           const char* tag,
-                          const std::uint64_t* in_read) {
-    std::vector<std::uint8_t> buffer(1024 * 1024);
+                          const std::uint64_t* in_read,
+                          bool final_sync = true) {
+    auto& pool = BufferPool::Instance();
+    BufferPool::Buffer buffer = pool.Acquire(pool.PipeBytes(target));
+    if (!buffer.data())
+        return Result::Fail(ENOMEM, "pipe buffer allocation failed");
+
+    if (opt.resume_offset > 0) {
+        auto sr = SkipInput(r, opt.resume_offset, buffer.Span());
+        if (!sr.is_ok())
+            return sr;
+        LogInfo("[%s] resuming at out=%llu bytes", tag, (unsigned long long)opt.resume_offset);
+    }
 
-    std::uint64_t written = 0;
+    std::uint64_t written = opt.resume_offset;
     std::uint64_t next_progress = opt.progress_interval_bytes;
-    std::uint64_t next_fsync = opt.fsync_interval_bytes;
+    std::uint64_t next_fsync = written + opt.fsync_interval_bytes;
 
     EmitProgress(opt, tag, in_read ? *in_read : 0, written, false);
 
-    while (true) {
-        const ssize_t n = r.Read(std::span<std::uint8_t>(buffer.data(), buffer.size()));
-        if (n == 0)
-            break;
-        if (n < 0)
-            return Result::Fail(errno, "Read failed during pipe");
-
-        auto res = w.WriteAll({buffer.data(), static_cast<size_t>(n)});
+    // Short reads copied into the buffer (pipes, stdin) are collected until it is full; a lent
+    // view is written together with what was collected before it in one vectored write.
+    std::size_t pending = 0;
+    auto flush = [&](std::span<const std::uint8_t> lent) -> Result {
+        const std::array<std::span<const std::uint8_t>, 2> pieces{
+            std::span<const std::uint8_t>(buffer.data(), pending), lent};
+        const std::uint64_t n = pending + lent.size();
+        Result res;
+        if (pending == 0)
+            res = w.WriteAll(lent);
+        else if (lent.empty())
+            res = w.WriteAll(pieces[0]);
+        else
+            res = w.WriteV(pieces);
         if (!res.is_ok())
             return res;
+        pending = 0;
 
-        written += static_cast<std::uint64_t>(n);
+        written += n;
 
         const std::uint64_t in_done = in_read ? *in_read : written;
 
@@ -109,23 +165,79 @@ Result PipeReaderToWriter(IReader& r,
                 return fr;
             LogDebug("[%s] fsync at out=%llu bytes", tag, (unsigned long long)written);
             next_fsync = written + opt.fsync_interval_bytes;
+            if (opt.on_durable) {
+                auto dr = opt.on_durable(written, 0);
+                if (!dr.is_ok())
+                    return dr;
+            }
+        }
+        return Result::Ok();
+    };
+
+    while (true) {
+        std::span<const std::uint8_t> chunk;
+        const ssize_t n = r.ReadView(chunk, buffer.Span().subspan(pending));
+        if (n == 0)
+            break;
+        if (n < 0)
+            return Result::Fail(errno, "Read failed during pipe");
+
+        if (chunk.data() == buffer.data() + pending) {
+            pending += static_cast<std::size_t>(n);
+            if (pending < buffer.size())
+                continue;
+            chunk = {};
         }
+        auto fr = flush(chunk);
+        if (!fr.is_ok())
+            return fr;
+    }
+    if (pending > 0) {
+        auto fr = flush({});
+        if (!fr.is_ok())
+            return fr;
     }
 
-    auto fr = w.FsyncNow();
-    if (!fr.is_ok())
-        return fr;
+    if (final_sync) {
+        auto fr = w.FsyncNow();
+        if (!fr.is_ok())
+            return fr;
+        if (opt.on_durable) {
+            auto dr = opt.on_durable(written, 0);
+            if (!dr.is_ok())
+                return dr;
+        }
+    }
 
     EmitProgress(opt, tag, in_read ? *in_read : written, written, true);
     return Result::Ok();
 }
 
-Result ParsePermissions(const std::string& perm_str, mode_t& out_mode) {
-    try {
-        out_mode = static_cast<mode_t>(std::stoul(perm_str, nullptr, 8));
-    } catch (const std::exception&) {
-        return Result::Fail(-1, "Invalid permissions value: " + perm_str);
-    }
+// Group commit defers every fsync to the end; get the data moving towards the device now.
+void StartWriteback(PartitionWriter& writer, const UpdateModule::Options& opt, const char* tag) {
+    if (!opt.finalizer->GroupCommit())
+        return;
+    auto wr = writer.StartWriteback();
+    if (!wr.is_ok())
+        LogDebug("[%s] %s", tag, wr.message().c_str());
+}
+
+// Pipes r into writer and finishes with a final fsync, which is queued on opt.finalizer
+// (taking the writer along) when there is one.
+Result PipeAndFinalize(IReader& r,
+                       PartitionWriter writer,
+                       const UpdateModule::Options& opt,
+                       const char* tag,
+                       const std::uint64_t* in_read) {
+    if (!opt.finalizer)
+        return PipeReaderToWriter(r, writer, writer.Path(), opt, tag, in_read);
+
+    auto pr = PipeReaderToWriter(r, writer, writer.Path(), opt, tag, in_read, false);
+    if (!pr.is_ok())
+        return pr;
+    StartWriteback(writer, opt, tag);
+    opt.finalizer->SubmitCommit(
+        {std::string(tag) + " fsync", [w = std::move(writer)]() mutable { return w.FsyncNow(); }});
     return Result::Ok();
 }
 
@@ -142,47 +254,130 @@ std::string ResolveArchiveTarget(const Component& comp) {
     return {};
 }
 
-class ProgressReader final : public IReader {
+Result ResolveImageSize(const Component& comp, const std::string& target, std::uint64_t& out) {
+    if (comp.image_size > 0) {
+        out = comp.image_size;
+        return Result::Ok();
+    }
+    if (!IsDevPath(target)) {
+        return Result::Fail(-1, "image-size is required for non-device target: " + comp.name);
+    }
+
+    Fd fd(::open(target.c_str(), O_RDONLY | O_CLOEXEC));
+    if (!fd.Valid()) {
+        return Result::Fail(errno, "open " + target + " failed: " + std::strerror(errno));
+    }
+    std::uint64_t size = 0;
+    if (::ioctl(fd.Get(), BLKGETSIZE64, &size) != 0) {
+        return Result::Fail(errno, "BLKGETSIZE64 " + target + " failed: " + std::strerror(errno));
+    }
+    out = size;
+    return Result::Ok();
+}
+
+// Opens path for writing, continuing at opt.resume_offset when that output is still there.
+// Otherwise the resume offset is dropped and the target is written from the start.
+Result OpenForResume(const std::string& path,
+                     PartitionWriter& writer,
+                     UpdateModule::Options& opt,
+                     const char* tag) {
+    if (opt.resume_offset > 0) {
+        auto r = PartitionWriter::OpenAt(path, opt.resume_offset, writer);
+        if (r.is_ok())
+            return r;
+        LogWarn("[%s] cannot resume (%s); starting over", tag, r.message().c_str());
+        opt.resume_offset = 0;
+    }
+    return PartitionWriter::Open(path, writer);
+}
+
+
+class RawInstallerStrategy final : public UpdateModule::IInstallerStrategy {
   public:
-    ProgressReader(IReader& inner,
+    bool Supports(const Component& comp) const override { return comp.type == ComponentType::Raw; }
+
+    Result Install(const Component& comp,
+                   IReader& reader,
                    const UpdateModule::Options& opt,
                    const char* tag,
-                   const std::uint64_t* in_read)
-        : inner_(inner), opt_(opt), tag_(tag), in_read_(in_read),
-          next_progress_(opt.progress_interval_bytes) {}
-
-    ssize_t Read(std::span<std::uint8_t> out) override {
-        const ssize_t n = inner_.Read(out);
-        if (n <= 0)
-            return n;
-
-        local_read_ += static_cast<std::uint64_t>(n);
-        const std::uint64_t in_done = (in_read_ && *in_read_ > 0) ? *in_read_ : local_read_;
-
-        if ((opt_.progress || opt_.progress_sink) && opt_.progress_interval_bytes > 0) {
-            if (in_done >= next_progress_) {
-                EmitProgress(opt_, tag_, in_done, in_done, false);
-                next_progress_ = in_done + opt_.progress_interval_bytes;
-            }
+                   const std::uint64_t* in_read) const override {
+        if (comp.install_to.empty()) {
+            return Result::Fail(-1, "install_to empty for raw component: " + comp.name);
         }
 
-        return n;
+        PartitionWriter writer;
+        UpdateModule::Options eff = opt;
+        auto open_res = OpenForResume(comp.install_to, writer, eff, tag);
+        if (!open_res.is_ok())
+            return open_res;
+
+        return PipeAndFinalize(reader, std::move(writer), eff, tag, in_read);
     }
 
-    std::optional<std::uint64_t> TotalSize() const override { return inner_.TotalSize(); }
+    bool Resumable() const override { return true; }
+};
+
+// Holds back the start of the image until its superblock has been validated, so a wrong or
+// corrupt image never reaches the partition. Also counts the bytes that went through.
+class SuperblockCheckingWriter final : public IWriter {
+  public:
+    SuperblockCheckingWriter(IWriter& inner, ReadOnlyImageType type) : inner_(inner), type_(type) {
+        head_.reserve(kReadOnlyImageHeaderBytes);
+    }
+
+    Result WriteAll(std::span<const std::uint8_t> in) override {
+        written_ += in.size();
+        if (head_checked_)
+            return inner_.WriteAll(in);
+
+        const size_t take = std::min(in.size(), kReadOnlyImageHeaderBytes - head_.size());
+        head_.insert(head_.end(), in.begin(), in.begin() + static_cast<std::ptrdiff_t>(take));
+        if (head_.size() < kReadOnlyImageHeaderBytes)
+            return Result::Ok();
+
+        auto r = ParseReadOnlyImageHeader(type_, head_, info_);
+        if (!r.is_ok())
+            return r;
+        head_checked_ = true;
+
+        const std::array<std::span<const std::uint8_t>, 2> pieces{
+            std::span<const std::uint8_t>(head_), in.subspan(take)};
+        return inner_.WriteV(pieces);
+    }
+
+    Result WriteV(std::span<const std::span<const std::uint8_t>> in) override {
+        if (!head_checked_)
+            return IWriter::WriteV(in);
+        for (const auto& piece : in)
+            written_ += piece.size();
+        return inner_.WriteV(in);
+    }
+
+    Result FsyncNow() override {
+        if (!head_checked_) {
+            // Only reachable at the end of a stream shorter than the header.
+            return ParseReadOnlyImageHeader(type_, head_, info_);
+        }
+        return inner_.FsyncNow();
+    }
+
+    const ReadOnlyImageInfo& Info() const { return info_; }
+    std::uint64_t Written() const { return written_; }
 
   private:
-    IReader& inner_;
-    const UpdateModule::Options& opt_;
-    const char* tag_ = nullptr;
-    const std::uint64_t* in_read_ = nullptr;
-    std::uint64_t local_read_ = 0;
-    std::uint64_t next_progress_ = 0;
+    IWriter& inner_;
+    ReadOnlyImageType type_;
+    std::vector<std::uint8_t> head_;
+    bool head_checked_ = false;
+    ReadOnlyImageInfo info_{};
+    std::uint64_t written_ = 0;
 };
 
-class RawInstallerStrategy final : public UpdateModule::IInstallerStrategy {
+class ReadOnlyImageInstallerStrategy final : public UpdateModule::IInstallerStrategy {
   public:
-    bool Supports(const Component& comp) const override { return comp.type == "raw"; }
+    bool Supports(const Component& comp) const override {
+        return ReadOnlyImageTypeFromName(ComponentTypeName(comp.type)).has_value();
+    }
 
     Result Install(const Component& comp,
                    IReader& reader,
@@ -190,33 +385,77 @@ class RawInstallerStrategy final : public UpdateModule::IInstallerStrategy {
                    const char* tag,
                    const std::uint64_t* in_read) const override {
         if (comp.install_to.empty()) {
-            return Result::Fail(-1, "install_to empty for raw component: " + comp.name);
+            return Result::Fail(
+                -1,
+                std::string("install_to empty for ") + ComponentTypeName(comp.type) +
+                    " component: " + comp.name);
         }
+        const ReadOnlyImageType type = *ReadOnlyImageTypeFromName(ComponentTypeName(comp.type));
 
         PartitionWriter writer;
         auto open_res = PartitionWriter::Open(comp.install_to, writer);
         if (!open_res.is_ok())
             return open_res;
 
-        return PipeReaderToWriter(reader, writer, opt, tag, in_read);
+        ReadbackVerifyingWriter verifier(writer);
+        IWriter* sink = &writer;
+        if (comp.verify_readback) {
+            auto vr = verifier.Start(comp.install_to);
+            if (!vr.is_ok())
+                return vr;
+            sink = &verifier;
+        }
+
+        SuperblockCheckingWriter checked(*sink, type);
+        auto pipe_res = PipeReaderToWriter(reader, checked, comp.install_to, opt, tag, in_read);
+        if (comp.verify_readback) {
+            auto fr = verifier.Finish();
+            if (pipe_res.is_ok() && !fr.is_ok())
+                return fr;
+        }
+        if (!pipe_res.is_ok())
+            return pipe_res;
+
+        const ReadOnlyImageInfo& info = checked.Info();
+        if (info.fs_bytes > checked.Written()) {
+            return Result::Fail(-1,
+                                std::string(ComponentTypeName(comp.type)) +
+                                    " image truncated: superblock needs " +
+                                    std::to_string(info.fs_bytes) + " bytes, got " +
+                                    std::to_string(checked.Written()));
+        }
+
+        LogInfo("[%s] %s image ok (fs %llu bytes, written %llu, verified %llu)",
+                tag,
+                ComponentTypeName(comp.type),
+                (unsigned long long)info.fs_bytes,
+                (unsigned long long)checked.Written(),
+                (unsigned long long)verifier.VerifiedBytes());
+        return Result::Ok();
     }
 };
 
 class ArchiveInstallerStrategy final : public UpdateModule::IInstallerStrategy {
   public:
-    bool Supports(const Component& comp) const override { return comp.type == "archive"; }
+    bool Supports(const Component& comp) const override {
+        return comp.type == ComponentType::Archive;
+    }
 
     Result Install(const Component& comp,
                    IReader& reader,
                    const UpdateModule::Options& opt,
                    const char* tag,
-                   const std::uint64_t* in_read) const override {
+                   const std::uint64_t*) const override {
+        // Read progress comes from the pipeline (ReportsReadProgress).
         std::string target = ResolveArchiveTarget(comp);
         if (target.empty()) {
             return Result::Fail(
                 -1, "archive component needs install_to(/dev/...) or path(folder): " + comp.name);
         }
 
+        if (comp.build_image)
+            return InstallAsImage(comp, target, reader, opt, tag);
+
         ArchiveInstaller::Options aopt;
         aopt.progress = opt.progress && (opt.progress_sink == nullptr);
         aopt.progress_interval_bytes = opt.progress_interval_bytes;
@@ -224,16 +463,52 @@ class ArchiveInstallerStrategy final : public UpdateModule::IInstallerStrategy {
         aopt.component_total_bytes = opt.component_total_bytes;
         aopt.overall_total_bytes = opt.overall_total_bytes;
         aopt.overall_done_base_bytes = opt.overall_done_base_bytes;
+        aopt.format_before_mount = comp.format_destination;
+        aopt.mount_data = comp.mount_options;
+        aopt.mount_profile = comp.mount_profile;
+        aopt.resume_entries = opt.resume_entries;
+        aopt.on_checkpoint = opt.on_durable;
+        aopt.finalizer = opt.finalizer;
+        aopt.bounded_decoders = opt.bounded_decoders;
 
         ArchiveInstaller installer(aopt);
-        ProgressReader progress_reader(reader, opt, tag, in_read);
-        return installer.InstallTarStreamToTarget(progress_reader, target, comp.name);
+        return installer.InstallTarStreamToTarget(reader, target, comp.name);
+    }
+
+    // Directory extraction resumes by entry; image builds always start over.
+    bool Resumable() const override { return true; }
+    bool ReportsReadProgress() const override { return true; }
+
+  private:
+    // Unpack into a staging tree and let mke2fs build the filesystem on the target from it:
+    // no mount(2) and no per-file I/O through the target's VFS.
+    static Result InstallAsImage(const Component& comp,
+                                 const std::string& target,
+                                 IReader& reader,
+                                 const UpdateModule::Options& opt,
+                                 const char* tag) {
+        FsImageBuilder::Options bopt;
+        auto sr = ResolveImageSize(comp, target, bopt.image_size_bytes);
+        if (!sr.is_ok())
+            return sr;
+        if (!opt.staging_dir.empty())
+            bopt.staging_dir = opt.staging_dir;
+        bopt.extract.progress = opt.progress && (opt.progress_sink == nullptr);
+        bopt.extract.progress_interval_bytes = opt.progress_interval_bytes;
+        bopt.extract.progress_sink = opt.progress_sink;
+        bopt.extract.component_total_bytes = opt.component_total_bytes;
+        bopt.extract.overall_total_bytes = opt.overall_total_bytes;
+        bopt.extract.overall_done_base_bytes = opt.overall_done_base_bytes;
+        bopt.extract.bounded_decoders = opt.bounded_decoders;
+
+        LogInfo("[%s] build image -> %s", tag, target.c_str());
+        return FsImageBuilder(bopt).Build(reader, comp.name, target);
     }
 };
 
 class AtomicFileInstallerStrategy final : public UpdateModule::IInstallerStrategy {
   public:
-    bool Supports(const Component& comp) const override { return comp.type == "file"; }
+    bool Supports(const Component& comp) const override { return comp.type == ComponentType::File; }
 
     Result Install(const Component& comp,
                    IReader& reader,
@@ -264,32 +539,64 @@ class AtomicFileInstallerStrategy final : public UpdateModule::IInstallerStrateg
             LogInfo("Created destination directory: %s", parent.string().c_str());
         }
 
+        if (opt.staged_file)
+            return PublishStaged(comp, opt, tag, in_read);
+
         std::string tmp_path = comp.path + ".tmp";
 
         PartitionWriter writer;
-        auto open_res = PartitionWriter::Open(tmp_path, writer);
+        UpdateModule::Options eff = opt;
+        auto open_res = OpenForResume(tmp_path, writer, eff, tag);
         if (!open_res.is_ok())
             return open_res;
 
-        auto pipe_res = PipeReaderToWriter(reader, writer, opt, tag, in_read);
+        const bool defer = opt.finalizer != nullptr;
+        auto pipe_res =
+            PipeReaderToWriter(reader, writer, comp.path, eff, tag, in_read, !defer);
         if (!pipe_res.is_ok()) {
             ::unlink(tmp_path.c_str());
             return pipe_res;
         }
+        if (!defer)
+            return RenameIntoPlace(tmp_path, comp.path, comp.permissions);
+
+        StartWriteback(writer, opt, tag);
+        std::string dir = fs::path(comp.path).parent_path().string();
+        opt.finalizer->SubmitCommit({std::string(tag) + " rename",
+                                     [w = std::move(writer), tmp_path]() mutable {
+                                         auto fr = w.FsyncNow();
+                                         if (!fr.is_ok())
+                                             ::unlink(tmp_path.c_str());
+                                         return fr;
+                                     },
+                                     [tmp_path,
+                                      path = comp.path,
+                                      permissions = comp.permissions]() {
+                                         return RenameIntoPlace(tmp_path, path, permissions);
+                                     },
+                                     dir.empty() ? "." : dir});
+        return Result::Ok();
+    }
 
-        if (::rename(tmp_path.c_str(), comp.path.c_str()) != 0) {
+    bool Resumable() const override { return true; }
+
+  private:
+    static Result RenameIntoPlace(const std::string& tmp_path,
+                                  const std::string& path,
+                                  const std::string& permissions) {
+        if (::rename(tmp_path.c_str(), path.c_str()) != 0) {
             const int err = errno;
             ::unlink(tmp_path.c_str());
             return Result::Fail(err, "Atomic rename failed: " + std::string(std::strerror(err)));
         }
 
-        if (!comp.permissions.empty()) {
+        if (!permissions.empty()) {
             mode_t mode = 0;
-            auto perm_res = ParsePermissions(comp.permissions, mode);
+            auto perm_res = ParsePermissions(permissions, mode);
             if (!perm_res.is_ok()) {
                 return perm_res;
             }
-            if (::chmod(comp.path.c_str(), mode) != 0) {
+            if (::chmod(path.c_str(), mode) != 0) {
                 const int err = errno;
                 return Result::Fail(err, "chmod failed: " + std::string(std::strerror(err)));
             }
@@ -297,13 +604,63 @@ class AtomicFileInstallerStrategy final : public UpdateModule::IInstallerStrateg
 
         return Result::Ok();
     }
+
+    // The verified payload already sits in the destination directory: give it its final mode
+    // and rename it into place instead of copying it through the reader.
+    static Result PublishStaged(const Component& comp,
+                                const UpdateModule::Options& opt,
+                                const char* tag,
+                                const std::uint64_t* in_read) {
+        mode_t mode = 0;
+        if (!comp.permissions.empty()) {
+            auto perm_res = ParsePermissions(comp.permissions, mode);
+            if (!perm_res.is_ok())
+                return perm_res;
+        } else {
+            // What a freshly created file would get.
+            mode = 0644 & ~ProcessUmask();
+        }
+
+        std::shared_ptr<TempFile> staged = opt.staged_file;
+        if (!opt.finalizer) {
+            auto pr = staged->Sync();
+            if (pr.is_ok())
+                pr = staged->Publish(comp.path, mode);
+            if (!pr.is_ok())
+                return pr;
+            LogDebug("[%s] published staged payload -> %s", tag, comp.path.c_str());
+        } else {
+            // Like the copy path: under group commit it only goes live once every sync passed.
+            const std::string dir = std::filesystem::path(comp.path).parent_path().string();
+            opt.finalizer->SubmitCommit({std::string(tag) + " publish",
+                                         [staged] { return staged->Sync(); },
+                                         [staged, path = comp.path, mode] {
+                                             return staged->Publish(path, mode, false);
+                                         },
+                                         dir.empty() ? "." : dir});
+        }
+
+        const std::uint64_t done = in_read && *in_read > 0 ? *in_read : opt.component_total_bytes;
+        EmitProgress(opt, tag, done, opt.component_total_bytes, true);
+        return Result::Ok();
+    }
 };
 
 } // namespace
 
+Result ParsePermissions(const std::string& perm_str, mode_t& out_mode) {
+    try {
+        out_mode = static_cast<mode_t>(std::stoul(perm_str, nullptr, 8));
+    } catch (const std::exception&) {
+        return Result::Fail(-1, "Invalid permissions value: " + perm_str);
+    }
+    return Result::Ok();
+}
+
 std::vector<std::unique_ptr<UpdateModule::IInstallerStrategy>> CreateDefaultInstallerStrategies() {
     std::vector<std::unique_ptr<UpdateModule::IInstallerStrategy>> out;
     out.emplace_back(std::make_unique<RawInstallerStrategy>());
+    out.emplace_back(std::make_unique<ReadOnlyImageInstallerStrategy>());
     out.emplace_back(std::make_unique<ArchiveInstallerStrategy>());
     out.emplace_back(std::make_unique<AtomicFileInstallerStrategy>());
     return out;
@@ -0,0 +1,74 @@
+#include "ota/extract_stats.hpp"
+
+#include <algorithm>
+#include <cstdio>
+
+namespace flash {
+
+namespace {
+
+unsigned long long Ms(std::uint64_t ns) { return static_cast<unsigned long long>(ns / 1000000); }
+
+} // namespace
+
+void ExtractStats::RecordEntry(std::string_view path,
+                               std::uint64_t entry_bytes,
+                               std::uint64_t ns,
+                               std::size_t max_slow) {
+    if (max_slow == 0)
+        return;
+    if (slowest.size() >= max_slow && ns <= slowest.back().ns)
+        return;
+
+    auto pos = std::find_if(
+        slowest.begin(), slowest.end(), [ns](const SlowEntry& e) { return e.ns < ns; });
+    slowest.insert(pos, SlowEntry{std::string(path), entry_bytes, ns});
+    if (slowest.size() > max_slow)
+        slowest.pop_back();
+}
+
+std::string ExtractStats::Summary() const {
+    char buf[1024];
+    std::snprintf(buf,
+                  sizeof(buf),
+                  "entries=%llu files=%llu dirs=%llu symlinks=%llu hardlinks=%llu other=%llu "
+                  "large_files=%llu batched_files=%llu batch_fallbacks=%llu batch_submits=%llu "
+                  "resumed=%llu checkpoints=%llu bytes=%llu sparse_bytes=%llu "
+                  "read_header_ms=%llu read_data_ms=%llu "
+                  "write_header_ms=%llu write_data_ms=%llu finish_ms=%llu batch_ms=%llu "
+                  "total_ms=%llu",
+                  (unsigned long long)Entries(),
+                  (unsigned long long)files,
+                  (unsigned long long)dirs,
+                  (unsigned long long)symlinks,
+                  (unsigned long long)hardlinks,
+                  (unsigned long long)other,
+                  (unsigned long long)large_files,
+                  (unsigned long long)batched_files,
+                  (unsigned long long)batch_fallbacks,
+                  (unsigned long long)batch_submits,
+                  (unsigned long long)resumed,
+                  (unsigned long long)checkpoints,
+                  (unsigned long long)bytes,
+                  (unsigned long long)sparse_bytes,
+                  Ms(read_header_ns),
+                  Ms(read_data_ns),
+                  Ms(write_header_ns),
+                  Ms(write_data_ns),
+                  Ms(finish_ns),
+                  Ms(batch_ns),
+                  Ms(total_ns));
+    return buf;
+}
+
+std::string ExtractStats::SlowestSummary() const {
+    std::string out;
+    for (const auto& e : slowest) {
+        if (!out.empty())
+            out += ' ';
+        out += e.path + "=" + std::to_string(e.ns / 1000) + "us/" + std::to_string(e.bytes) + "B";
+    }
+    return out;
+}
+
+} // namespace flash
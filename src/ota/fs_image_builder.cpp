@@ -0,0 +1,113 @@
+#include "ota/fs_image_builder.hpp"
+
+#include "io/fd.hpp"
+#include "system/process.hpp"
+#include "util/logger.hpp"
+
+#include <cerrno>
+#include <cstdlib>
+#include <fcntl.h>
+#include <filesystem>
+#include <span>
+#include <unistd.h>
+#include <vector>
+
+namespace fs = std::filesystem;
+
+namespace flash {
+
+namespace {
+
+bool IsExtFamily(std::string_view fs_type) {
+    return fs_type == "ext2" || fs_type == "ext3" || fs_type == "ext4";
+}
+
+class StagingTree {
+  public:
+    StagingTree() = default;
+    StagingTree(const StagingTree&) = delete;
+    StagingTree& operator=(const StagingTree&) = delete;
+    ~StagingTree() {
+        if (!path_.empty()) {
+            std::error_code ec;
+            fs::remove_all(path_, ec);
+        }
+    }
+
+    Result Create(const std::string& base_dir) {
+        std::string tmpl =
+            (base_dir.empty() ? std::string("/tmp") : base_dir) + "/ota-image-XXXXXX";
+        if (!::mkdtemp(tmpl.data()))
+            return Result::Fail(errno, "mkdtemp failed in " + base_dir);
+        path_ = tmpl;
+        return Result::Ok();
+    }
+
+    const std::string& Path() const { return path_; }
+
+  private:
+    std::string path_;
+};
+
+Result DrainStream(IReader& r) {
+    std::vector<std::uint8_t> buf(64 * 1024);
+    while (true) {
+        std::span<const std::uint8_t> discarded;
+        const ssize_t n = r.ReadView(discarded, std::span<std::uint8_t>(buf.data(), buf.size()));
+        if (n == 0)
+            return Result::Ok();
+        if (n < 0)
+            return Result::Fail(-1, "archive stream drain failed");
+    }
+}
+
+} // namespace
+
+Result
+FsImageBuilder::Build(IReader& tar_stream, std::string_view tag, const std::string& target) const {
+    if (!IsExtFamily(opt_.fs_type))
+        return Result::Fail(-1, "image build supports ext2/ext3/ext4 only, got: " + opt_.fs_type);
+    if (opt_.image_size_bytes < 1024)
+        return Result::Fail(-1, "image size unknown or too small");
+
+    StagingTree tree;
+    auto tr = tree.Create(opt_.staging_dir);
+    if (!tr.is_ok())
+        return tr;
+
+    LogInfo("[%.*s] unpack -> %s", (int)tag.size(), tag.data(), tree.Path().c_str());
+    TarStreamExtractor extractor(opt_.extract);
+    auto xr = extractor.ExtractToDir(tar_stream, tree.Path(), tag);
+    if (!xr.is_ok())
+        return xr;
+
+    auto dr = DrainStream(tar_stream);
+    if (!dr.is_ok())
+        return dr;
+
+    LogInfo("[%.*s] mke2fs -t %s (%llu bytes) -> %s",
+            (int)tag.size(),
+            tag.data(),
+            opt_.fs_type.c_str(),
+            (unsigned long long)opt_.image_size_bytes,
+            target.c_str());
+    auto mr = RunProcess({"mke2fs",
+                          "-q",
+                          "-F",
+                          "-t",
+                          opt_.fs_type,
+                          "-d",
+                          tree.Path(),
+                          target,
+                          std::to_string(opt_.image_size_bytes / 1024) + "k"});
+    if (!mr.is_ok())
+        return Result::Fail(mr.err, "image build failed: " + mr.msg);
+
+    // mke2fs flushes on close; this makes sure a failure to do so is not lost.
+    Fd fd(::open(target.c_str(), O_RDONLY | O_CLOEXEC));
+    if (!fd.Valid() || ::fsync(fd.Get()) != 0)
+        return Result::Fail(errno, "fsync failed on " + target);
+    return Result::Ok();
+}
+
+} // namespace flash
@@ -0,0 +1,188 @@
+// install_journal.cpp - Crash-safe install progress record.
+
+#include "ota/install_journal.hpp"
+
+#include "io/fd.hpp"
+#include "util/logger.hpp"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <filesystem>
+#include <fstream>
+#include <nlohmann/json.hpp>
+#include <unistd.h>
+
+namespace flash {
+
+namespace {
+
+constexpr int kJournalVersion = 1;
+
+Result ErrnoFail(const std::string& what, const std::string& path) {
+    const int err = errno;
+    return Result::Fail(err, what + " failed: " + path + " (" + std::strerror(err) + ")");
+}
+
+Result WriteFileDurably(const std::string& path, const std::string& content) {
+    const std::string tmp = path + ".tmp";
+    {
+        Fd fd(::open(tmp.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0600));
+        if (!fd.Valid())
+            return ErrnoFail("open", tmp);
+
+        const char* p = content.data();
+        size_t rem = content.size();
+        while (rem > 0) {
+            const ssize_t n = ::write(fd.Get(), p, rem);
+            if (n < 0 && errno == EINTR)
+                continue;
+            if (n <= 0)
+                return ErrnoFail("write", tmp);
+            p += n;
+            rem -= static_cast<size_t>(n);
+        }
+        if (::fsync(fd.Get()) != 0)
+            return ErrnoFail("fsync", tmp);
+    }
+
+    if (::rename(tmp.c_str(), path.c_str()) != 0)
+        return ErrnoFail("rename", path);
+
+    std::string dir = std::filesystem::path(path).parent_path().string();
+    if (dir.empty())
+        dir = ".";
+    Fd dfd(::open(dir.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC));
+    if (!dfd.Valid())
+        return ErrnoFail("open", dir);
+    if (::fsync(dfd.Get()) != 0)
+        return ErrnoFail("fsync", dir);
+    return Result::Ok();
+}
+
+} // namespace
+
+Result InstallJournal::Open(const std::string& path,
+                            const std::string& manifest_sha256,
+                            InstallJournal& out) {
+    std::lock_guard<std::mutex> lock(out.mu_);
+    out.path_ = path;
+    out.completed_.clear();
+    out.current_.clear();
+    out.current_bytes_ = 0;
+    out.current_entries_ = 0;
+    out.manifest_sha256_ = manifest_sha256;
+
+    std::ifstream is(path);
+    if (!is.good())
+        return Result::Ok();
+
+    nlohmann::json j;
+    try {
+        is >> j;
+    } catch (const std::exception& e) {
+        LogWarn("Ignoring unreadable install journal %s: %s", path.c_str(), e.what());
+        return Result::Ok();
+    }
+
+    if (!j.is_object() || j.value("version", 0) != kJournalVersion ||
+        j.value("manifest-sha256", "") != manifest_sha256) {
+        LogInfo("Install journal %s is for another bundle; starting over", path.c_str());
+        return Result::Ok();
+    }
+
+    try {
+        out.completed_ = j.value("completed", std::vector<std::string>{});
+        if (const auto it = j.find("current"); it != j.end() && it->is_object()) {
+            out.current_ = it->value("name", "");
+            out.current_bytes_ = it->value("bytes-written", 0ULL);
+            out.current_entries_ = it->value("entries-done", 0ULL);
+        }
+    } catch (const std::exception& e) {
+        out.completed_.clear();
+        out.current_.clear();
+        out.current_bytes_ = 0;
+        out.current_entries_ = 0;
+        LogWarn("Ignoring malformed install journal %s: %s", path.c_str(), e.what());
+        return Result::Ok();
+    }
+
+    LogInfo("Resuming from install journal %s: %zu completed, current=%s at %llu bytes, "
+            "%llu entries",
+            path.c_str(),
+            out.completed_.size(),
+            out.current_.empty() ? "-" : out.current_.c_str(),
+            (unsigned long long)out.current_bytes_,
+            (unsigned long long)out.current_entries_);
+    return Result::Ok();
+}
+
+bool InstallJournal::IsCompleted(const std::string& component) const {
+    std::lock_guard<std::mutex> lock(mu_);
+    return IsCompletedLocked(component);
+}
+
+bool InstallJournal::IsCompletedLocked(const std::string& component) const {
+    return std::find(completed_.begin(), completed_.end(), component) != completed_.end();
+}
+
+std::uint64_t InstallJournal::ResumeOffset(const std::string& component) const {
+    std::lock_guard<std::mutex> lock(mu_);
+    return component == current_ ? current_bytes_ : 0;
+}
+
+std::uint64_t InstallJournal::ResumeEntries(const std::string& component) const {
+    std::lock_guard<std::mutex> lock(mu_);
+    return component == current_ ? current_entries_ : 0;
+}
+
+Result InstallJournal::Begin(const std::string& component,
+                             std::uint64_t bytes_written,
+                             std::uint64_t entries_done) {
+    std::lock_guard<std::mutex> lock(mu_);
+    current_ = component;
+    current_bytes_ = bytes_written;
+    current_entries_ = entries_done;
+    return Save();
+}
+
+Result InstallJournal::Checkpoint(std::uint64_t bytes_written, std::uint64_t entries_done) {
+    std::lock_guard<std::mutex> lock(mu_);
+    current_bytes_ = bytes_written;
+    current_entries_ = entries_done;
+    return Save();
+}
+
+Result InstallJournal::Complete(const std::string& component) {
+    std::lock_guard<std::mutex> lock(mu_);
+    if (!IsCompletedLocked(component))
+        completed_.push_back(component);
+    if (current_ == component) {
+        current_.clear();
+        current_bytes_ = 0;
+        current_entries_ = 0;
+    }
+    return Save();
+}
+
+Result InstallJournal::Discard() {
+    if (::unlink(path_.c_str()) != 0 && errno != ENOENT)
+        return ErrnoFail("unlink", path_);
+    return Result::Ok();
+}
+
+Result InstallJournal::Save() const {
+    nlohmann::json j;
+    j["version"] = kJournalVersion;
+    j["manifest-sha256"] = manifest_sha256_;
+    j["completed"] = completed_;
+    if (!current_.empty()) {
+        j["current"] = {{"name", current_}, {"bytes-written", current_bytes_}};
+        if (current_entries_ > 0)
+            j["current"]["entries-done"] = current_entries_;
+    }
+    return WriteFileDurably(path_, j.dump());
+}
+
+} // namespace flash
@@ -0,0 +1,51 @@
+// memory_budget.cpp - Splits a memory budget across pipeline buffers and RAM staging.
+
+#include "ota/memory_budget.hpp"
+
+#include <algorithm>
+#include <cerrno>
+#include <string>
+
+namespace flash {
+
+namespace {
+
+constexpr std::size_t kMinIoBytes = 64 * 1024;
+constexpr std::size_t kMaxIoBytes = 1024 * 1024;
+constexpr std::size_t kSmallIoBytes = 64 * 1024;
+
+} // namespace
+
+Result PlanMemoryBudget(std::uint64_t budget_bytes, MemoryPlan& out) {
+    if (budget_bytes < kMinMemoryBudgetBytes) {
+        return Result::Fail(EINVAL,
+                            "memory budget too small: " + std::to_string(budget_bytes >> 20) +
+                                " MiB (need at least " +
+                                std::to_string(kMinMemoryBudgetBytes >> 20) + " MiB)");
+    }
+    const std::uint64_t avail = budget_bytes - kMemoryBudgetReserveBytes;
+
+    // Pipe and staging buffers take 1/16 each; everything else stays at 64 KiB.
+    std::size_t io = static_cast<std::size_t>(
+        std::clamp<std::uint64_t>(avail / 16, kMinIoBytes, kMaxIoBytes));
+    io -= io % kMinIoBytes;
+
+    out = MemoryPlan{};
+    out.pool.sizes.pipe = io;
+    out.pool.sizes.staging = io;
+    out.pool.sizes.archive_read = std::min(io, kSmallIoBytes);
+    out.pool.sizes.gzip_input = std::min(io, kSmallIoBytes);
+    out.pool.sizes.drain = std::min(io, kSmallIoBytes);
+    out.pool.max_idle_per_size = 1;
+
+    // RAM staging gets 1/4 (two entries of 1/8), the small-file batch and the chunk
+    // verification/decryption read-ahead 1/8 each. The rest covers mapped staged data
+    // (MmapReader releases it every 2 MiB) and the extractor's batches.
+    out.memory_staging_bytes = avail / 8;
+    out.small_file_batch_bytes = avail / 8;
+    out.read_ahead_bytes = avail / 8;
+    out.bounded_decoders = true;
+    return Result::Ok();
+}
+
+} // namespace flash
@@ -1,7 +1,10 @@
 #include "ota/mount_session.hpp"
 
+#include "system/process.hpp"
+
 #include <cerrno>
 #include <cstring>
+#include <fcntl.h>
 #include <filesystem>
 #include <memory>
 #include <sys/mount.h>
@@ -14,6 +17,24 @@ namespace flash {
 
 namespace {
 
+Result BuildMkfsCommand(std::string_view device,
+                        std::string_view fs_type,
+                        std::vector<std::string>& out) {
+    const std::string fs(fs_type);
+    const std::string dev(device);
+    if (fs == "ext2" || fs == "ext3" || fs == "ext4") {
+        // -F: also accept regular image files (loop targets) without prompting.
+        out = {"mkfs." + fs, "-F", "-q", dev};
+    } else if (fs == "xfs" || fs == "f2fs") {
+        out = {"mkfs." + fs, "-f", "-q", dev};
+    } else if (fs == "vfat") {
+        out = {"mkfs.vfat", dev};
+    } else {
+        return Result::Fail(-1, "format not supported for fs type: " + fs);
+    }
+    return Result::Ok();
+}
+
 class PosixSystemOps final : public MountSession::ISystemOps {
   public:
     Result CreateMountPoint(std::string_view mount_base_dir,
@@ -39,12 +60,14 @@ class PosixSystemOps final : public MountSession::ISystemOps {
     Result Mount(std::string_view device,
                  std::string_view target_dir,
                  std::string_view fs_type,
-                 unsigned long mount_flags) const override {
+                 unsigned long mount_flags,
+                 std::string_view mount_data) const override {
+        const std::string data(mount_data);
         if (::mount(std::string(device).c_str(),
                     std::string(target_dir).c_str(),
                     std::string(fs_type).c_str(),
                     mount_flags,
-                    nullptr) != 0) {
+                    data.empty() ? nullptr : data.c_str()) != 0) {
             const int err = errno;
             return Result::Fail(err, "mount failed: " + std::string(std::strerror(err)));
         }
@@ -58,10 +81,39 @@ class PosixSystemOps final : public MountSession::ISystemOps {
         return Result::Ok();
     }
 
+    Result SyncFilesystem(std::string_view target_dir) const override {
+        const int fd = ::open(std::string(target_dir).c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+        if (fd < 0) {
+            return Result::Fail(errno,
+                                "open mount dir failed: " + std::string(std::strerror(errno)));
+        }
+        const int rc = ::syncfs(fd);
+        const int err = errno;
+        ::close(fd);
+        if (rc != 0) {
+            return Result::Fail(err, "syncfs failed: " + std::string(std::strerror(err)));
+        }
+        return Result::Ok();
+    }
+
     void RemoveDirectory(std::string_view dir) const override {
         std::error_code ec;
         fs::remove(fs::path(dir), ec);
     }
+
+    Result Format(std::string_view device, std::string_view fs_type) const override {
+        std::vector<std::string> argv;
+        auto cmd_result = BuildMkfsCommand(device, fs_type, argv);
+        if (!cmd_result.is_ok())
+            return cmd_result;
+
+        auto run_result = RunProcess(argv);
+        if (!run_result.is_ok()) {
+            return Result::Fail(run_result.err,
+                                "format " + std::string(device) + " failed: " + run_result.msg);
+        }
+        return Result::Ok();
+    }
 };
 
 } // namespace
@@ -77,8 +129,8 @@ MountSession::MountSession(std::shared_ptr<const ISystemOps> system_ops)
     : system_ops_(system_ops ? std::move(system_ops) : DefaultSystemOps()) {}
 
 MountSession::MountSession(MountSession&& other) noexcept
-    : system_ops_(std::move(other.system_ops_)), dir_(std::move(other.dir_)),
-      mounted_(other.mounted_) {
+    : system_ops_(std::move(other.system_ops_)), device_(std::move(other.device_)),
+      fs_type_(std::move(other.fs_type_)), dir_(std::move(other.dir_)), mounted_(other.mounted_) {
     other.mounted_ = false;
     other.dir_.clear();
     other.system_ops_ = DefaultSystemOps();
@@ -89,6 +141,8 @@ MountSession& MountSession::operator=(MountSession&& other) noexcept {
         return *this;
     Cleanup();
     system_ops_ = std::move(other.system_ops_);
+    device_ = std::move(other.device_);
+    fs_type_ = std::move(other.fs_type_);
     dir_ = std::move(other.dir_);
     mounted_ = other.mounted_;
     other.mounted_ = false;
@@ -104,6 +158,7 @@ Result MountSession::MountDevice(std::string_view device,
                                  std::string_view mount_prefix,
                                  std::string_view fs_type,
                                  unsigned long mount_flags,
+                                 std::string_view mount_data,
                                  MountSession& out) {
     out.Cleanup();
 
@@ -113,16 +168,48 @@ Result MountSession::MountDevice(std::string_view device,
         return create_result;
     }
 
-    auto mount_result = out.system_ops_->Mount(device, out.dir_, fs_type, mount_flags);
+    auto mount_result =
+        out.system_ops_->Mount(device, out.dir_, fs_type, mount_flags, mount_data);
     if (!mount_result.is_ok()) {
         out.Cleanup();
         return mount_result;
     }
 
+    out.device_ = device;
+    out.fs_type_ = fs_type;
     out.mounted_ = true;
     return Result::Ok();
 }
 
+Result MountSession::FormatAndMountDevice(std::string_view device,
+                                         std::string_view mount_base_dir,
+                                         std::string_view mount_prefix,
+                                         std::string_view fs_type,
+                                         unsigned long mount_flags,
+                                         std::string_view mount_data,
+                                         MountSession& out) {
+    out.Cleanup();
+
+    auto format_result = out.system_ops_->Format(device, fs_type);
+    if (!format_result.is_ok())
+        return format_result;
+
+    return MountDevice(
+        device, mount_base_dir, mount_prefix, fs_type, mount_flags, mount_data, out);
+}
+
+Result MountSession::Remount(unsigned long mount_flags, std::string_view mount_data) {
+    if (!mounted_ || dir_.empty())
+        return Result::Fail(-1, "remount: nothing mounted");
+    return system_ops_->Mount(device_, dir_, fs_type_, mount_flags | MS_REMOUNT, mount_data);
+}
+
+Result MountSession::Sync() {
+    if (!mounted_ || dir_.empty())
+        return Result::Fail(-1, "sync: nothing mounted");
+    return system_ops_->SyncFilesystem(dir_);
+}
+
 Result MountSession::Unmount() {
     if (!mounted_ || dir_.empty())
         return Result::Ok();
@@ -134,6 +221,8 @@ Result MountSession::Unmount() {
     mounted_ = false;
     system_ops_->RemoveDirectory(dir_);
     dir_.clear();
+    device_.clear();
+    fs_type_.clear();
     return Result::Ok();
 }
 
@@ -146,6 +235,8 @@ void MountSession::Cleanup() {
         system_ops_->RemoveDirectory(dir_);
         dir_.clear();
     }
+    device_.clear();
+    fs_type_.clear();
 }
 
 } // namespace flash
@@ -1,16 +1,16 @@
 #include "ota/ota_bundle_reader.hpp"
 
+#include "io/buffer_pool.hpp"
+
 #include <algorithm>
+#include <cerrno>
 #include <cstring>
 #include <memory>
-#include <vector>
 
 namespace flash {
 
 namespace {
 
-constexpr size_t kArchiveReadBufferSize = 64 * 1024;
-
 std::string ArchiveErrorText(struct archive* ar) {
     if (!ar)
         return "unknown";
@@ -45,21 +45,39 @@ Result OtaTarBundleReader::Open(IReader& src) {
     // We'll use archive_read_open2 for read callback.
     struct Ctx {
         IReader* r = nullptr;
-        std::vector<std::uint8_t> buf;
-        explicit Ctx(IReader& rr) : r(&rr), buf(kArchiveReadBufferSize) {}
+        BufferPool::Buffer buf;
+        explicit Ctx(IReader& rr)
+            : r(&rr),
+              buf(BufferPool::Instance().Acquire(BufferPool::Instance().GetSizes().archive_read)) {
+        }
     };
 
     auto ctx = std::make_unique<Ctx>(src);
+    if (!ctx->buf.data()) {
+        archive_read_free(ar_);
+        ar_ = nullptr;
+        return Result::Fail(ENOMEM, "bundle read buffer allocation failed");
+    }
 
     auto read_cb = [](archive*, void* cd, const void** buff) -> la_ssize_t {
         auto* c = static_cast<Ctx*>(cd);
-        const ssize_t n = c->r->Read(std::span<std::uint8_t>(c->buf.data(), c->buf.size()));
+        std::span<const std::uint8_t> view;
+        const ssize_t n = c->r->ReadView(view, c->buf.Span());
         if (n < 0)
             return -1;
-        *buff = c->buf.data();
+        *buff = view.data();
         return static_cast<la_ssize_t>(n); // 0 => EOF
     };
 
+    // Lets libarchive seek over entries that are not installed when the bundle is a file.
+    auto skip_cb = [](archive*, void* cd, la_int64_t request) -> la_int64_t {
+        auto* c = static_cast<Ctx*>(cd);
+        if (request <= 0)
+            return 0;
+        const std::int64_t n = c->r->Skip(static_cast<std::uint64_t>(request));
+        return n < 0 ? ARCHIVE_FATAL : static_cast<la_int64_t>(n);
+    };
+
     auto close_cb = [](archive*, void* cd) -> int {
         auto* c = static_cast<Ctx*>(cd);
         delete c;
@@ -70,7 +88,7 @@ Result OtaTarBundleReader::Open(IReader& src) {
                            ctx.get(),
                            /*open*/ nullptr,
                            read_cb,
-                           /*skip*/ nullptr,
+                           skip_cb,
                            close_cb) != ARCHIVE_OK) {
         Result fail = ArchiveFailure(ar_, "archive_read_open2 failed");
         archive_read_free(ar_);
@@ -135,7 +153,10 @@ Result OtaTarBundleReader::ReadCurrentToString(std::string& out) {
         return Result::Fail(-1, "No current entry");
     out.clear();
 
-    std::vector<std::uint8_t> buf(kArchiveReadBufferSize);
+    auto& pool = BufferPool::Instance();
+    BufferPool::Buffer buf = pool.Acquire(pool.GetSizes().archive_read);
+    if (!buf.data())
+        return Result::Fail(ENOMEM, "bundle read buffer allocation failed");
     while (true) {
         const la_ssize_t n = archive_read_data(ar_, buf.data(), buf.size());
         if (n == 0)
@@ -158,16 +179,59 @@ Result OtaTarBundleReader::OpenCurrentEntryReader(std::unique_ptr<IReader>& out_
 }
 
 ssize_t OtaTarBundleReader::EntryReader::Read(std::span<std::uint8_t> out) {
+    std::span<const std::uint8_t> view;
+    const ssize_t n = ReadView(view, out);
+    if (n > 0 && view.data() != out.data())
+        std::memcpy(out.data(), view.data(), view.size());
+    return n;
+}
+
+ssize_t OtaTarBundleReader::EntryReader::ReadView(std::span<const std::uint8_t>& view,
+                                                  std::span<std::uint8_t> scratch) {
+    view = {};
     if (!parent_ || !parent_->in_entry_)
         return -1;
-    const la_ssize_t n = archive_read_data(parent_->ar_, out.data(), out.size());
-    if (n < 0)
-        return -1;
-    if (n == 0) {
-        // entry finished
-        parent_->in_entry_ = false;
+    if (scratch.empty())
         return 0;
+
+    while (block_left_ == 0 && pos_ >= block_offset_) {
+        const void* buf = nullptr;
+        std::size_t size = 0;
+        la_int64_t offset = 0;
+        const int r = archive_read_data_block(parent_->ar_, &buf, &size, &offset);
+        if (r == ARCHIVE_EOF) {
+            // A sparse entry may end in a hole.
+            const la_int64_t total = archive_entry_size(parent_->cur_entry_);
+            if (pos_ >= total) {
+                parent_->in_entry_ = false;
+                return 0;
+            }
+            block_offset_ = total;
+        } else if (r < ARCHIVE_WARN) {
+            return -1;
+        } else {
+            block_ = static_cast<const std::uint8_t*>(buf);
+            block_left_ = size;
+            block_offset_ = offset;
+        }
+    }
+
+    // Holes between sparse blocks read as zeros.
+    if (pos_ < block_offset_) {
+        const auto hole = static_cast<std::uint64_t>(block_offset_ - pos_);
+        const auto n = static_cast<std::size_t>(std::min<std::uint64_t>(hole, scratch.size()));
+        std::memset(scratch.data(), 0, n);
+        view = scratch.first(n);
+        pos_ += static_cast<std::int64_t>(n);
+        return static_cast<ssize_t>(n);
     }
+
+    const std::size_t n = std::min(block_left_, scratch.size());
+    view = std::span<const std::uint8_t>(block_, n);
+    block_ += n;
+    block_left_ -= n;
+    block_offset_ += static_cast<std::int64_t>(n);
+    pos_ += static_cast<std::int64_t>(n);
     return static_cast<ssize_t>(n);
 }
 
@@ -1,17 +1,98 @@
 #include "ota/ota_install_services.hpp"
 
+#include "crypto/sha256.hpp"
+#include "io/buffer_pool.hpp"
+#include "ota/async_finalizer.hpp"
+#include "ota/component_installers.hpp"
+#include "ota/small_file_batch.hpp"
 #include "ota/staging_verifier.hpp"
+#include "system/process.hpp"
 #include "util/logger.hpp"
 #include "util/path_utils.hpp"
 
+#include <filesystem>
+#include <future>
 #include <memory>
+#include <span>
 #include <string>
+#include <string_view>
 #include <unordered_set>
+#include <utility>
 
 namespace flash {
 
 namespace {
-const OtaEntryStager kEntryStager{};
+
+// Minimum progress between journal rewrites while a component is streaming.
+constexpr std::uint64_t kJournalCheckpointBytes = 8 * 1024 * 1024ULL;
+
+// Uncompressed, unencrypted file components are staged in their destination directory, when
+// it exists, so the verified payload can be renamed into place. Returns "" when that does not
+// apply.
+std::string PublishDir(const Component& comp) {
+    if (comp.type != ComponentType::File || comp.path.empty() || !comp.encryption.empty())
+        return {};
+    if (comp.filename.size() >= 3 && comp.filename.ends_with(".gz"))
+        return {};
+    std::string dir = std::filesystem::path(comp.path).parent_path().string();
+    if (dir.empty())
+        dir = ".";
+    std::error_code ec;
+    return std::filesystem::is_directory(dir, ec) ? dir : std::string();
+}
+
+// Consecutive file components up to this size are collected into a SmallFileBatch, which is
+// published once it holds SetSmallFileBatchBytes() or another kind of component comes up.
+constexpr std::uint64_t kSmallFileBytes = 256 * 1024ULL;
+
+Result ReadVerified(IReader& reader,
+                    const std::string& expected_sha256,
+                    std::vector<std::uint8_t>& out) {
+    Sha256Hasher hasher;
+    auto& pool = BufferPool::Instance();
+    BufferPool::Buffer buf = pool.Acquire(pool.GetSizes().staging);
+    if (!buf.data())
+        return Result::Fail(ENOMEM, "staging buffer allocation failed");
+    while (true) {
+        std::span<const std::uint8_t> chunk;
+        const ssize_t n = reader.ReadView(chunk, buf.Span());
+        if (n < 0)
+            return Result::Fail(-1, "read failed while staging");
+        if (n == 0)
+            break;
+        hasher.Update(chunk);
+        out.insert(out.end(), chunk.begin(), chunk.end());
+    }
+    const std::string actual = hasher.FinalHex();
+    if (!Sha256HexEquals(actual, expected_sha256)) {
+        return Result::Fail(-1,
+                            "sha256 mismatch: expected=" + expected_sha256 + " actual=" + actual);
+    }
+    return Result::Ok();
+}
+
+// The manifest permissions, or what a freshly created file would get.
+Result FileMode(const Component& comp, mode_t& out) {
+    if (!comp.permissions.empty())
+        return ParsePermissions(comp.permissions, out);
+    out = 0644 & ~ProcessUmask();
+    return Result::Ok();
+}
+
+void ReportDone(const Component& comp, const UpdateModule::Options& opt) {
+    const std::uint64_t total = opt.component_total_bytes;
+    if (opt.progress_sink) {
+        ProgressEvent event{};
+        event.component = comp.name;
+        event.comp_done = total;
+        event.comp_total = total;
+        event.overall_done = opt.overall_done_base_bytes + total;
+        event.overall_total = opt.overall_total_bytes;
+        opt.progress_sink->OnProgress(event);
+    } else if (opt.progress) {
+        LogInfo("[%s] done (batched, %llu bytes)", comp.name.c_str(), (unsigned long long)total);
+    }
+}
 } // namespace
 ComponentIndex::ComponentIndex(const Manifest& manifest) {
     by_filename_.reserve(manifest.components.size());
@@ -23,7 +104,7 @@ ComponentIndex::ComponentIndex(const Manifest& manifest) {
 }
 
 const Component* ComponentIndex::Find(std::string_view normalized_entry_name) const {
-    auto it = by_filename_.find(std::string(normalized_entry_name));
+    auto it = by_filename_.find(normalized_entry_name);
     if (it == by_filename_.end())
         return nullptr;
     return it->second;
@@ -33,12 +114,21 @@ bool ComponentIndex::Contains(std::string_view normalized_entry_name) const {
     return Find(normalized_entry_name) != nullptr;
 }
 
-const std::unordered_map<std::string, const Component*>& ComponentIndex::EntriesByFilename() const {
+const std::unordered_map<std::string_view, const Component*>&
+ComponentIndex::EntriesByFilename() const {
     return by_filename_;
 }
 
 Result ManifestLoader::LoadFromFirstBundleEntry(OtaTarBundleReader& bundle,
                                                 Manifest& out_manifest) {
+    std::string manifest_sha256;
+    return LoadFromFirstBundleEntry(bundle, out_manifest, manifest_sha256);
+}
+
+Result ManifestLoader::LoadFromFirstBundleEntry(OtaTarBundleReader& bundle,
+                                                Manifest& out_manifest,
+                                                std::string& out_manifest_sha256,
+                                                const ManifestParser::Options& parse_opt) {
     bool eof = false;
     BundleEntryInfo entry{};
 
@@ -59,11 +149,13 @@ Result ManifestLoader::LoadFromFirstBundleEntry(OtaTarBundleReader& bundle,
     if (!read_result.is_ok())
         return read_result;
 
-    auto parsed = ManifestHandler::Parse(manifest_json);
+    auto parsed = ManifestParser().Parse(manifest_json, parse_opt);
     if (!parsed)
         return Result::Fail(-1, "Manifest parse error: " + parsed.error());
 
-    out_manifest = *parsed;
+    out_manifest = std::move(*parsed);
+    out_manifest_sha256 = Sha256Hex(std::span<const std::uint8_t>(
+        reinterpret_cast<const std::uint8_t*>(manifest_json.data()), manifest_json.size()));
     LogInfo("Loaded manifest version=%s hw=%s components=%zu",
             out_manifest.version.c_str(),
             out_manifest.hw_compatibility.c_str(),
@@ -128,9 +220,78 @@ Result InstallCoordinator::InstallMatchingEntries(OtaTarBundleReader& bundle,
                                                   const ComponentIndex& component_index,
                                                   std::uint64_t overall_total) {
     std::uint64_t overall_done_base = 0;
-    std::unordered_set<std::string> installed_filenames;
+    std::unordered_set<std::string_view> installed_filenames;
     installed_filenames.reserve(component_index.EntriesByFilename().size());
 
+    // Large entries go next to the cache so they can be linked into it.
+    StagingBackend::Options staging_opt = staging_opt_;
+    if (cache_)
+        staging_opt.dir = cache_->Dir();
+    const StagingBackend staging(staging_opt);
+
+    // Final syncs, renames and unmounts run in the background; the Barrier() below gates
+    // success. Declared before `pending` so installs still in flight can submit to it.
+    AsyncFinalizer finalizer(AsyncFinalizer::Options{group_commit_});
+
+    // Small file components waiting to be published together.
+    auto batch = std::make_shared<SmallFileBatch>();
+    std::vector<const Component*> batched;
+
+    // A staged component installs on a worker while the main thread (the only one touching
+    // the bundle) stages the next one. Installs themselves stay serialized and in order.
+    struct PendingInstall {
+        const Component* component = nullptr;
+        std::uint64_t comp_total = 0;
+        std::uint64_t staged_bytes = 0;
+        std::unique_ptr<StagedEntry> staged;
+        // Declared last so it is joined before the staged file it reads goes away.
+        std::future<Result> done;
+    };
+    std::unique_ptr<PendingInstall> pending;
+
+    // The journal only records a component once the finaliser has made it durable.
+    auto complete = [&](const Component& comp, std::uint64_t comp_total) -> Result {
+        if (journal_) {
+            finalizer.Submit(comp.name + " journal",
+                             [this, name = comp.name] { return journal_->Complete(name); });
+        }
+        installed_filenames.insert(comp.filename);
+        overall_done_base += comp_total;
+        return finalizer.Error();
+    };
+    auto finish_pending = [&]() -> Result {
+        if (!pending)
+            return Result::Ok();
+        auto current = std::move(pending);
+        auto update_result = current->done.get();
+        if (!update_result.is_ok()) {
+            return Result::Fail(-1,
+                                "component '" + current->component->name +
+                                    "' failed: " + update_result.message());
+        }
+        return complete(*current->component, current->comp_total);
+    };
+
+    auto flush_batch = [&]() -> Result {
+        if (batch->Empty())
+            return Result::Ok();
+        LogInfo("Publishing %zu small files (%llu bytes)",
+                batch->Files(),
+                (unsigned long long)batch->Bytes());
+        std::shared_ptr<SmallFileBatch> b = std::move(batch);
+        batch = std::make_shared<SmallFileBatch>();
+        finalizer.SubmitCommit(
+            {"small files", [b] { return b->Stage(); }, [b] { return b->Publish(); }});
+        // Their bytes were counted towards overall progress when they were read.
+        for (const Component* comp : batched) {
+            auto cr = complete(*comp, 0);
+            if (!cr.is_ok())
+                return cr;
+        }
+        batched.clear();
+        return Result::Ok();
+    };
+
     bool eof = false;
     BundleEntryInfo entry{};
 
@@ -151,51 +312,225 @@ Result InstallCoordinator::InstallMatchingEntries(OtaTarBundleReader& bundle,
             continue;
         }
 
+        // Only the completed set is read here; the worker touches the current checkpoint.
+        const std::uint64_t comp_total = component->size > 0 ? component->size : entry.size;
+        if (journal_ && journal_->IsCompleted(component->name)) {
+            LogInfo("Already installed (journal): %s", component->name.c_str());
+            installed_filenames.insert(component->filename);
+            overall_done_base += comp_total;
+            auto skip_result = bundle.SkipCurrent();
+            if (!skip_result.is_ok())
+                return skip_result;
+            continue;
+        }
+
         LogInfo("Install: name=%s type=%s file=%s (entry=%llu bytes)",
                 component->name.c_str(),
-                component->type.c_str(),
+                ComponentTypeName(component->type),
                 component->filename.c_str(),
                 (unsigned long long)entry.size);
 
-        std::unique_ptr<IReader> entry_reader;
-        auto open_entry_result = bundle.OpenCurrentEntryReader(entry_reader);
-        if (!open_entry_result.is_ok())
-            return open_entry_result;
+        // The staging cache is fed from staged files, so with a cache everything is staged.
+        if (batch_small_files_ && !cache_ && !component->sha256.empty() &&
+            entry.size <= kSmallFileBytes && !PublishDir(*component).empty()) {
+            // Keeps progress reporting on one thread at a time.
+            auto fr = finish_pending();
+            if (!fr.is_ok())
+                return fr;
+
+            std::unique_ptr<IReader> entry_reader;
+            auto open_entry_result = bundle.OpenCurrentEntryReader(entry_reader);
+            if (!open_entry_result.is_ok())
+                return open_entry_result;
+            std::vector<std::uint8_t> data;
+            data.reserve(entry.size);
+            auto vr = ReadVerified(*entry_reader, component->sha256, data);
+            if (!vr.is_ok()) {
+                return Result::Fail(-1,
+                                    "component '" + component->name +
+                                        "' sha256 verify failed: " + vr.message());
+            }
+            mode_t mode = 0;
+            auto mr = FileMode(*component, mode);
+            if (!mr.is_ok())
+                return Result::Fail(mr.err, "component '" + component->name + "': " + mr.msg);
+
+            batch->Add(component->path, std::move(data), mode);
+            batched.push_back(component);
+            ReportDone(*component,
+                       BuildOptions(comp_total, overall_total, overall_done_base, progress_sink_));
+            overall_done_base += comp_total;
+
+            auto skip_result = bundle.SkipCurrent();
+            if (!skip_result.is_ok())
+                return skip_result;
+            if (batch->Bytes() >= small_file_batch_bytes_) {
+                auto br = flush_batch();
+                if (!br.is_ok())
+                    return br;
+            }
+            continue;
+        }
+
+        // Publishes stay in bundle order: a batch never outlives the next regular component.
+        auto br = flush_batch();
+        if (!br.is_ok())
+            return br;
+
+        auto next = std::make_unique<PendingInstall>();
+        next->component = component;
+        next->comp_total = comp_total;
 
+        std::unique_ptr<IReader> entry_reader;
         const std::string expected_sha256 = component->sha256;
-        StagedEntry staged;
-        if (!expected_sha256.empty()) {
-            auto vr = kEntryStager.StageAndVerify(entry_reader, expected_sha256, staged);
+        bool can_publish = false;
+        // Chunk-hashed payloads need no staging: every chunk is checked against the manifest
+        // before it is handed on. Encryption alone does not qualify, since any payload sealed
+        // with the device key (an older one, say) would pass; those are staged so `sha256` is
+        // checked. The staging cache still gets everything staged.
+        const bool chunk_checked = !component->chunk_sha256.empty();
+        const bool stream = expected_sha256.empty() || (!cache_ && chunk_checked);
+        if (cache_ && !expected_sha256.empty() &&
+            cache_->Lookup(expected_sha256, entry_reader)) {
+            // The bundle entry is never opened, so SkipCurrent below can seek over it.
+            LogInfo("Using cached payload for %s", component->name.c_str());
+        } else if (stream) {
+            // Streams straight from the bundle, so nothing can overlap with it.
+            auto fr = finish_pending();
+            if (!fr.is_ok())
+                return fr;
+            auto open_entry_result = bundle.OpenCurrentEntryReader(entry_reader);
+            if (!open_entry_result.is_ok())
+                return open_entry_result;
+        } else {
+            if (pending && pending->staged_bytes + entry.size > pipeline_budget_) {
+                auto fr = finish_pending();
+                if (!fr.is_ok())
+                    return fr;
+            }
+
+            auto open_entry_result = bundle.OpenCurrentEntryReader(entry_reader);
+            if (!open_entry_result.is_ok())
+                return open_entry_result;
+
+            // An interrupted copy through <path>.tmp is resumed rather than replaced.
+            const bool resuming = journal_ && journal_->ResumeOffset(component->name) > 0;
+            StagingPlacement placement;
+            auto pr = staging.Choose(
+                entry.size, resuming ? std::string() : PublishDir(*component), placement);
+            if (!pr.is_ok())
+                return Result::Fail(pr.err, "component '" + component->name + "': " + pr.msg);
+            LogDebug("stage %s in %s %s",
+                     component->name.c_str(),
+                     ToString(placement.tier),
+                     placement.dir.c_str());
+
+            next->staged = std::make_unique<StagedEntry>();
+            const OtaEntryStager stager(placement);
+            auto vr = stager.StageAndVerify(entry_reader, expected_sha256, *next->staged);
             if (!vr.is_ok()) {
                 return Result::Fail(-1,
                                     "component '" + component->name +
                                         "' sha256 verify failed: " + vr.message());
             }
-            entry_reader = std::move(staged.reader);
+            entry_reader = std::move(next->staged->reader);
+            next->staged_bytes = entry.size;
+            can_publish = placement.tier == StagingPlacement::Tier::kDestination;
+
+            if (cache_) {
+                auto cr = cache_->Insert(expected_sha256, next->staged->temp.Path());
+                if (!cr.is_ok())
+                    LogWarn("Staging cache insert failed: %s", cr.message().c_str());
+            }
         }
 
-        const std::uint64_t comp_total = component->size > 0 ? component->size : entry.size;
-        auto update_result = update_module_.ExecuteComponent(
-            *component,
-            std::move(entry_reader),
-            BuildOptions(comp_total, overall_total, overall_done_base, progress_sink_));
-        if (!update_result.is_ok()) {
-            return Result::Fail(
-                -1, "component '" + component->name + "' failed: " + update_result.message());
+        // Staged and cached payloads no longer need the bundle: move on before installing.
+        const bool detached = !stream;
+        if (detached) {
+            auto skip_result = bundle.SkipCurrent();
+            if (!skip_result.is_ok())
+                return skip_result;
         }
 
-        installed_filenames.insert(component->filename);
-        overall_done_base += comp_total;
+        auto fr = finish_pending();
+        if (!fr.is_ok())
+            return fr;
+
+        UpdateModule::Options options =
+            BuildOptions(comp_total, overall_total, overall_done_base, progress_sink_);
+        options.finalizer = &finalizer;
+        options.bounded_decoders = bounded_decoders_;
+        options.read_ahead_bytes = read_ahead_bytes_;
+        options.decryption_key = decryption_key_;
+        options.staging_dir = staging_opt_.dir;
+        if (journal_) {
+            options.resume_offset = journal_->ResumeOffset(component->name);
+            options.resume_entries = journal_->ResumeEntries(component->name);
+            auto jr =
+                journal_->Begin(component->name, options.resume_offset, options.resume_entries);
+            if (!jr.is_ok())
+                return jr;
+
+            std::uint64_t last_checkpoint = options.resume_offset;
+            options.on_durable = [this, last_checkpoint](std::uint64_t bytes,
+                                                         std::uint64_t entries) mutable {
+                if (bytes < last_checkpoint + kJournalCheckpointBytes)
+                    return Result::Ok();
+                last_checkpoint = bytes;
+                return journal_->Checkpoint(bytes, entries);
+            };
+        }
 
-        auto skip_result = bundle.SkipCurrent();
-        if (!skip_result.is_ok())
-            return skip_result;
+        if (can_publish)
+            options.staged_file = std::make_shared<TempFile>(std::move(next->staged->temp));
+
+        if (!detached) {
+            auto update_result =
+                update_module_.ExecuteComponent(*component, std::move(entry_reader), options);
+            if (!update_result.is_ok()) {
+                return Result::Fail(
+                    -1, "component '" + component->name + "' failed: " + update_result.message());
+            }
+            auto cr = complete(*component, comp_total);
+            if (!cr.is_ok())
+                return cr;
+            auto skip_result = bundle.SkipCurrent();
+            if (!skip_result.is_ok())
+                return skip_result;
+            continue;
+        }
+
+        next->done = std::async(std::launch::async,
+                                [this,
+                                 component,
+                                 reader = std::move(entry_reader),
+                                 options = std::move(options)]() mutable {
+                                    return update_module_.ExecuteComponent(
+                                        *component, std::move(reader), options);
+                                });
+        pending = std::move(next);
+        if (pipeline_budget_ == 0) {
+            fr = finish_pending();
+            if (!fr.is_ok())
+                return fr;
+        }
     }
 
+    auto fr = finish_pending();
+    if (!fr.is_ok())
+        return fr;
+    fr = flush_batch();
+    if (!fr.is_ok())
+        return fr;
+    fr = finalizer.Barrier();
+    if (!fr.is_ok())
+        return fr;
+
     for (const auto& [expected_name, _] : component_index.EntriesByFilename()) {
         if (!installed_filenames.contains(expected_name)) {
             return Result::Fail(-1,
-                                "manifest component entry missing from ota.tar: " + expected_name);
+                                "manifest component entry missing from ota.tar: " +
+                                    std::string(expected_name));
         }
     }
 
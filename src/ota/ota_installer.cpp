@@ -1,11 +1,16 @@
 #include "ota/ota_installer.hpp"
 
+#include "io/buffer_pool.hpp"
 #include "io/file_reader.hpp"
+#include "ota/install_journal.hpp"
+#include "ota/memory_budget.hpp"
 #include "ota/ota_install_services.hpp"
+#include "system/process.hpp"
 #include "util/device_config.hpp"
 #include "util/logger.hpp"
 #include "util/manifest_selector.hpp"
 
+#include <algorithm>
 #include <cstdlib>
 
 namespace {
@@ -27,6 +32,31 @@ OtaInstaller::OtaInstaller() = default;
 OtaInstaller::OtaInstaller(UpdateModule update_module) : update_module_(std::move(update_module)) {}
 
 Result OtaInstaller::Run(const std::string& input_path) {
+    // Cached before the finalizer and stager threads start creating files.
+    ProcessUmask();
+    // Applied first: opening the bundle already takes buffers from the pool.
+    MemoryPlan plan;
+    StagingBackend::Options staging_opt = staging_opt_;
+    if (memory_budget_ > 0) {
+        auto pr = PlanMemoryBudget(memory_budget_, plan);
+        if (!pr.is_ok())
+            return pr;
+        BufferPool::Instance().Configure(plan.pool);
+        staging_opt.memory_threshold_bytes =
+            std::min(staging_opt.memory_threshold_bytes, plan.memory_staging_bytes);
+        LogInfo("Memory budget %llu MiB: I/O buffers %zu KiB, RAM staging below %llu KiB",
+                (unsigned long long)(memory_budget_ >> 20),
+                plan.pool.sizes.pipe >> 10,
+                (unsigned long long)(staging_opt.memory_threshold_bytes >> 10));
+    }
+
+    AesGcmKey key{};
+    if (!key_path_.empty()) {
+        auto kr = LoadAesGcmKeyFile(key_path_, key);
+        if (!kr.is_ok())
+            return kr;
+    }
+
     FileOrStdinReader input;
     auto open_result = FileOrStdinReader::Open(input_path, input);
     if (!open_result.ok)
@@ -37,21 +67,23 @@ Result OtaInstaller::Run(const std::string& input_path) {
     if (!bundle_result.is_ok())
         return bundle_result;
 
-    Manifest manifest{};
-    auto manifest_result = ManifestLoader::LoadFromFirstBundleEntry(bundle, manifest);
-    if (!manifest_result.is_ok())
-        return manifest_result;
-
     DeviceConfig device_cfg;
     auto cfg_res = DeviceConfig::LoadFromFile(ResolveConfigPath(), device_cfg);
     if (!cfg_res.is_ok())
         return cfg_res;
 
-    Manifest selected{};
-    auto sel_res = ManifestSelector::SelectForDevice(manifest, device_cfg, selected);
+    // Only the device slot's components are materialised.
+    Manifest parsed{};
+    std::string manifest_sha256;
+    auto manifest_result = ManifestLoader::LoadFromFirstBundleEntry(
+        bundle, parsed, manifest_sha256, ManifestParser::Options{device_cfg.current_slot});
+    if (!manifest_result.is_ok())
+        return manifest_result;
+
+    Manifest manifest{};
+    auto sel_res = ManifestSelector::SelectForDevice(std::move(parsed), device_cfg, manifest);
     if (!sel_res.is_ok())
         return sel_res;
-    manifest = std::move(selected);
 
     LogInfo("Device config: slot=%s hw=%s",
             device_cfg.current_slot.c_str(),
@@ -68,12 +100,45 @@ Result OtaInstaller::Run(const std::string& input_path) {
         LogInfo("OTA overall total unknown (stdin or pre-scan failed)");
     }
 
+    InstallJournal journal;
     InstallCoordinator coordinator(update_module_, progress_sink_);
+    coordinator.SetStagingOptions(staging_opt);
+    coordinator.SetGroupCommit(group_commit_);
+    if (memory_budget_ > 0) {
+        coordinator.SetSmallFileBatchBytes(plan.small_file_batch_bytes);
+        coordinator.SetBoundedDecoders(plan.bounded_decoders);
+        coordinator.SetReadAheadBytes(plan.read_ahead_bytes);
+    }
+    if (!key_path_.empty())
+        coordinator.SetDecryptionKey(&key);
+    if (!journal_path_.empty()) {
+        auto jr = InstallJournal::Open(journal_path_, manifest_sha256, journal);
+        if (!jr.is_ok())
+            return jr;
+        coordinator.SetJournal(&journal);
+    }
+
+    StagingCache cache;
+    if (!cache_opt_.dir.empty()) {
+        auto cr = StagingCache::Open(cache_opt_, cache);
+        if (cr.is_ok()) {
+            coordinator.SetStagingCache(&cache);
+        } else {
+            LogWarn("Staging cache disabled: %s", cr.message().c_str());
+        }
+    }
+
     auto install_result =
         coordinator.InstallMatchingEntries(bundle, component_index, overall_total);
     if (!install_result.is_ok())
         return install_result;
 
+    if (!journal_path_.empty()) {
+        auto jr = journal.Discard();
+        if (!jr.is_ok())
+            return jr;
+    }
+
     LogInfo("OTA completed successfully");
     return Result::Ok();
 }
@@ -0,0 +1,84 @@
+#include "ota/readonly_image.hpp"
+
+#include <string>
+
+namespace flash {
+
+namespace {
+
+constexpr std::uint32_t kSquashfsMagic = 0x73717368; // "hsqs"
+constexpr std::uint32_t kErofsMagic = 0xE0F5E1E2;
+constexpr std::size_t kErofsSuperblockOffset = 1024;
+
+template <typename T> T LoadLe(std::span<const std::uint8_t> p, std::size_t off) {
+    T v = 0;
+    for (std::size_t i = 0; i < sizeof(T); ++i) {
+        v |= static_cast<T>(p[off + i]) << (8 * i);
+    }
+    return v;
+}
+
+Result ParseSquashfs(std::span<const std::uint8_t> head, ReadOnlyImageInfo& out) {
+    if (LoadLe<std::uint32_t>(head, 0) != kSquashfsMagic)
+        return Result::Fail(-1, "squashfs: bad superblock magic");
+
+    const auto block_size = LoadLe<std::uint32_t>(head, 12);
+    const auto block_log = LoadLe<std::uint16_t>(head, 22);
+    const auto major = LoadLe<std::uint16_t>(head, 28);
+    if (major != 4)
+        return Result::Fail(-1, "squashfs: unsupported version " + std::to_string(major));
+    if (block_log < 12 || block_log > 20 || block_size != (1U << block_log))
+        return Result::Fail(-1, "squashfs: invalid block size");
+
+    out.fs_bytes = LoadLe<std::uint64_t>(head, 40);
+    if (out.fs_bytes == 0)
+        return Result::Fail(-1, "squashfs: bytes_used is zero");
+    return Result::Ok();
+}
+
+Result ParseErofs(std::span<const std::uint8_t> head, ReadOnlyImageInfo& out) {
+    const auto sb = head.subspan(kErofsSuperblockOffset);
+    if (LoadLe<std::uint32_t>(sb, 0) != kErofsMagic)
+        return Result::Fail(-1, "erofs: bad superblock magic");
+
+    const unsigned blkszbits = sb[12];
+    if (blkszbits < 9 || blkszbits > 16)
+        return Result::Fail(-1, "erofs: invalid block size bits " + std::to_string(blkszbits));
+
+    const auto blocks = LoadLe<std::uint32_t>(sb, 36);
+    if (blocks == 0)
+        return Result::Fail(-1, "erofs: block count is zero");
+    out.fs_bytes = static_cast<std::uint64_t>(blocks) << blkszbits;
+    return Result::Ok();
+}
+
+} // namespace
+
+std::optional<ReadOnlyImageType> ReadOnlyImageTypeFromName(std::string_view type) {
+    if (type == "erofs")
+        return ReadOnlyImageType::Erofs;
+    if (type == "squashfs")
+        return ReadOnlyImageType::Squashfs;
+    return std::nullopt;
+}
+
+Result ParseReadOnlyImageHeader(ReadOnlyImageType type,
+                                std::span<const std::uint8_t> head,
+                                ReadOnlyImageInfo& out) {
+    out = ReadOnlyImageInfo{};
+    if (head.size() < kReadOnlyImageHeaderBytes) {
+        return Result::Fail(-1,
+                            "image too small for a superblock (" + std::to_string(head.size()) +
+                                " bytes)");
+    }
+
+    switch (type) {
+    case ReadOnlyImageType::Squashfs:
+        return ParseSquashfs(head, out);
+    case ReadOnlyImageType::Erofs:
+        return ParseErofs(head, out);
+    }
+    return Result::Fail(-1, "unknown read-only image type");
+}
+
+} // namespace flash
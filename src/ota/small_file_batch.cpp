@@ -0,0 +1,136 @@
+// small_file_batch.cpp - Directory-grouped install of small file components.
+
+#include "ota/small_file_batch.hpp"
+
+#include "util/logger.hpp"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <fcntl.h>
+#include <filesystem>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <utility>
+
+namespace flash {
+
+namespace {
+
+Result ErrnoFail(const std::string& what, const std::string& path) {
+    const int err = errno;
+    return Result::Fail(err, what + " failed: " + path + " (" + std::strerror(err) + ")");
+}
+
+std::string TempName(const std::string& name) { return name + ".tmp"; }
+
+Result WriteFileAt(int dirfd,
+                   const std::string& name,
+                   const std::vector<std::uint8_t>& data,
+                   mode_t mode) {
+    const std::string tmp = TempName(name);
+    Fd fd(::openat(
+        dirfd, tmp.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_NOFOLLOW | O_CLOEXEC, 0600));
+    if (!fd.Valid())
+        return ErrnoFail("open", tmp);
+
+    const std::uint8_t* p = data.data();
+    std::size_t rem = data.size();
+    while (rem > 0) {
+        const ssize_t n = ::write(fd.Get(), p, rem);
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n <= 0)
+            return ErrnoFail("write", tmp);
+        p += n;
+        rem -= static_cast<std::size_t>(n);
+    }
+    if (::fchmod(fd.Get(), mode) != 0)
+        return ErrnoFail("fchmod", tmp);
+    return Result::Ok();
+}
+
+} // namespace
+
+SmallFileBatch::~SmallFileBatch() {
+    for (const Dir& dir : dirs_) {
+        for (const File& f : dir.files) {
+            if (f.staged)
+                (void)::unlinkat(dir.fd.Get(), TempName(f.name).c_str(), 0);
+        }
+    }
+}
+
+void SmallFileBatch::Add(const std::string& path, std::vector<std::uint8_t> data, mode_t mode) {
+    const std::filesystem::path p(path);
+    std::string dir = p.parent_path().string();
+    if (dir.empty())
+        dir = ".";
+
+    auto [it, inserted] = dir_index_.try_emplace(dir, dirs_.size());
+    if (inserted)
+        dirs_.push_back(Dir{dir, Fd(), {}});
+    auto& files = dirs_[it->second].files;
+
+    File file{p.filename().string(), std::move(data), mode, false};
+    bytes_ += file.data.size();
+    auto same = std::find_if(
+        files.begin(), files.end(), [&](const File& f) { return f.name == file.name; });
+    if (same != files.end()) {
+        bytes_ -= same->data.size();
+        *same = std::move(file);
+        return;
+    }
+    files.push_back(std::move(file));
+    ++files_;
+}
+
+Result SmallFileBatch::Stage() {
+    // One syncfs per filesystem covers the data of every file written to it.
+    std::vector<std::pair<dev_t, int>> filesystems;
+    for (Dir& dir : dirs_) {
+        dir.fd.Reset(::open(dir.path.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC));
+        if (!dir.fd.Valid())
+            return ErrnoFail("open", dir.path);
+
+        for (File& f : dir.files) {
+            f.staged = true;
+            auto wr = WriteFileAt(dir.fd.Get(), f.name, f.data, f.mode);
+            if (!wr.is_ok())
+                return wr;
+        }
+
+        struct stat st {};
+        if (::fstat(dir.fd.Get(), &st) != 0)
+            return ErrnoFail("fstat", dir.path);
+        if (std::none_of(filesystems.begin(), filesystems.end(), [&](const auto& fs) {
+                return fs.first == st.st_dev;
+            })) {
+            filesystems.emplace_back(st.st_dev, dir.fd.Get());
+        }
+    }
+
+    for (const auto& [dev, fd] : filesystems) {
+        if (::syncfs(fd) != 0)
+            return ErrnoFail("syncfs", "device " + std::to_string(dev));
+    }
+    return Result::Ok();
+}
+
+Result SmallFileBatch::Publish() {
+    for (Dir& dir : dirs_) {
+        for (File& f : dir.files) {
+            const std::string tmp = TempName(f.name);
+            if (::renameat2(dir.fd.Get(), tmp.c_str(), dir.fd.Get(), f.name.c_str(), 0) != 0)
+                return ErrnoFail("rename", dir.path + "/" + f.name);
+            f.staged = false;
+        }
+        if (::fsync(dir.fd.Get()) != 0)
+            return ErrnoFail("fsync", dir.path);
+    }
+    LogDebug("published %zu small files in %zu directories", files_, dirs_.size());
+    return Result::Ok();
+}
+
+} // namespace flash
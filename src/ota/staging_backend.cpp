@@ -0,0 +1,55 @@
+// staging_backend.cpp - Per-entry choice between memory, directory and in-place staging.
+
+#include "ota/staging_backend.hpp"
+
+#include <cerrno>
+#include <string>
+#include <sys/statvfs.h>
+
+namespace flash {
+
+const char* ToString(StagingPlacement::Tier tier) {
+    switch (tier) {
+    case StagingPlacement::Tier::kMemory:
+        return "memory";
+    case StagingPlacement::Tier::kDirectory:
+        return "directory";
+    case StagingPlacement::Tier::kDestination:
+        return "destination";
+    }
+    return "?";
+}
+
+std::uint64_t StagingBackend::FreeBytes(const std::string& dir) {
+    struct statvfs st {};
+    if (::statvfs(dir.c_str(), &st) != 0)
+        return 0;
+    return static_cast<std::uint64_t>(st.f_bavail) * st.f_frsize;
+}
+
+bool StagingBackend::HasRoom(const std::string& dir, std::uint64_t size) const {
+    return FreeBytes(dir) >= size + opt_.min_free_bytes;
+}
+
+Result StagingBackend::Choose(std::uint64_t size,
+                              const std::string& publish_dir,
+                              StagingPlacement& out) const {
+    // Staging in place saves a whole copy, so it wins whenever the target filesystem has room.
+    if (!publish_dir.empty() && HasRoom(publish_dir, size)) {
+        out = {StagingPlacement::Tier::kDestination, publish_dir};
+        return Result::Ok();
+    }
+    if (size < opt_.memory_threshold_bytes) {
+        out = {StagingPlacement::Tier::kMemory, {}};
+        return Result::Ok();
+    }
+    if (HasRoom(opt_.dir, size)) {
+        out = {StagingPlacement::Tier::kDirectory, opt_.dir};
+        return Result::Ok();
+    }
+    return Result::Fail(ENOSPC,
+                        "no staging space for " + std::to_string(size) + " bytes in " + opt_.dir +
+                            " (" + std::to_string(FreeBytes(opt_.dir)) + " bytes free)");
+}
+
+} // namespace flash
@@ -0,0 +1,239 @@
+// staging_cache.cpp - SHA-256 keyed LRU cache of verified staged entries.
+
+#include "ota/staging_cache.hpp"
+
+#include "crypto/sha256.hpp"
+#include "io/fd.hpp"
+#include "io/file_reader.hpp"
+#include "util/logger.hpp"
+
+#include <algorithm>
+#include <cctype>
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <filesystem>
+#include <sys/sendfile.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <vector>
+
+namespace flash {
+
+namespace {
+
+constexpr std::size_t kKeyLength = 64;
+constexpr char kTempPrefix[] = "ota-entry-";
+
+std::string NormalizeKey(const std::string& sha256) {
+    std::string key = sha256;
+    std::transform(key.begin(), key.end(), key.begin(), [](unsigned char c) {
+        return static_cast<char>(std::tolower(c));
+    });
+    return key;
+}
+
+bool IsKey(const std::string& name) {
+    return name.size() == kKeyLength && std::all_of(name.begin(), name.end(), [](char c) {
+               return std::isdigit(static_cast<unsigned char>(c)) || (c >= 'a' && c <= 'f');
+           });
+}
+
+Result ErrnoFail(const std::string& what, const std::string& path) {
+    const int err = errno;
+    return Result::Fail(err, what + " failed: " + path + " (" + std::strerror(err) + ")");
+}
+
+Result FsyncPath(const std::string& path, int flags) {
+    Fd fd(::open(path.c_str(), flags | O_CLOEXEC));
+    if (!fd.Valid() || ::fsync(fd.Get()) != 0)
+        return ErrnoFail("fsync", path);
+    return Result::Ok();
+}
+
+// Copies src to dst through a temp name so a crash never leaves a truncated cache entry.
+Result CopyDurably(const std::string& src, const std::string& dst, std::uint64_t size) {
+    Fd in(::open(src.c_str(), O_RDONLY | O_CLOEXEC));
+    if (!in.Valid())
+        return ErrnoFail("open", src);
+
+    const std::string tmp = dst + ".part";
+    Fd out(::open(tmp.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0600));
+    if (!out.Valid())
+        return ErrnoFail("open", tmp);
+
+    std::uint64_t done = 0;
+    while (done < size) {
+        const ssize_t n = ::sendfile(out.Get(), in.Get(), nullptr, size - done);
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n <= 0) {
+            const Result r = n < 0 ? ErrnoFail("sendfile", tmp)
+                                   : Result::Fail(EIO, "short copy into cache: " + tmp);
+            ::unlink(tmp.c_str());
+            return r;
+        }
+        done += static_cast<std::uint64_t>(n);
+    }
+    if (::fsync(out.Get()) != 0 || ::rename(tmp.c_str(), dst.c_str()) != 0) {
+        const Result r = ErrnoFail("publish", dst);
+        ::unlink(tmp.c_str());
+        return r;
+    }
+    return Result::Ok();
+}
+
+} // namespace
+
+Result StagingCache::Open(const Options& opt, StagingCache& out) {
+    namespace fs = std::filesystem;
+    out = StagingCache{};
+    out.opt_ = opt;
+    if (opt.dir.empty())
+        return Result::Fail(-1, "staging cache directory is empty");
+
+    std::error_code ec;
+    fs::create_directories(opt.dir, ec);
+    if (ec)
+        return Result::Fail(-1, "create_directories failed: " + opt.dir + ": " + ec.message());
+
+    struct Found {
+        std::string key;
+        std::uint64_t bytes = 0;
+        timespec mtime{};
+    };
+    std::vector<Found> found;
+    for (const auto& de : fs::directory_iterator(opt.dir, ec)) {
+        const std::string name = de.path().filename().string();
+        struct stat st {};
+        if (::lstat(de.path().c_str(), &st) != 0 || !S_ISREG(st.st_mode))
+            continue;
+        if (!IsKey(name)) {
+            // Leftovers from an interrupted stage or copy.
+            if (name.starts_with(kTempPrefix) || name.ends_with(".part"))
+                ::unlink(de.path().c_str());
+            continue;
+        }
+        found.push_back(Found{name, static_cast<std::uint64_t>(st.st_size), st.st_mtim});
+    }
+    if (ec)
+        return Result::Fail(-1, "scan failed: " + opt.dir + ": " + ec.message());
+
+    std::sort(found.begin(), found.end(), [](const Found& a, const Found& b) {
+        if (a.mtime.tv_sec != b.mtime.tv_sec)
+            return a.mtime.tv_sec < b.mtime.tv_sec;
+        return a.mtime.tv_nsec < b.mtime.tv_nsec;
+    });
+    for (auto& f : found) {
+        out.lru_.push_back(Item{std::move(f.key), f.bytes});
+        out.index_.emplace(out.lru_.back().key, std::prev(out.lru_.end()));
+        out.bytes_ += f.bytes;
+    }
+    out.EvictFor(0);
+
+    LogInfo("Staging cache %s: %zu entries, %llu bytes",
+            opt.dir.c_str(),
+            out.index_.size(),
+            (unsigned long long)out.bytes_);
+    return Result::Ok();
+}
+
+bool StagingCache::Lookup(const std::string& sha256, std::unique_ptr<IReader>& out) {
+    const auto it = index_.find(NormalizeKey(sha256));
+    if (it == index_.end())
+        return false;
+
+    // The entry is re-hashed: whatever survived a crash on the cache filesystem is not trusted.
+    const std::string path = PathOf(it->second->key);
+    std::string actual;
+    auto hr = Sha256HexFile(path, actual);
+    auto reader = std::make_unique<FileOrStdinReader>();
+    auto r = FileOrStdinReader::Open(path, *reader);
+    if (!hr.is_ok() || NormalizeKey(actual) != it->second->key || !r.ok ||
+        reader->TotalSize() != it->second->bytes) {
+        LogWarn("Dropping unusable staging cache entry %s", it->second->key.c_str());
+        Remove(it->second);
+        return false;
+    }
+
+    Touch(it->second);
+    out = std::move(reader);
+    return true;
+}
+
+Result StagingCache::Insert(const std::string& sha256, const std::string& verified_path) {
+    const std::string key = NormalizeKey(sha256);
+    if (!IsKey(key))
+        return Result::Fail(-1, "invalid sha256 for staging cache: " + sha256);
+    if (const auto it = index_.find(key); it != index_.end()) {
+        Touch(it->second);
+        return Result::Ok();
+    }
+
+    struct stat st {};
+    if (::stat(verified_path.c_str(), &st) != 0)
+        return ErrnoFail("stat", verified_path);
+    const auto size = static_cast<std::uint64_t>(st.st_size);
+    if (size > opt_.max_bytes)
+        return Result::Ok();
+
+    EvictFor(size);
+
+    const std::string dst = PathOf(key);
+    // AT_SYMLINK_FOLLOW so unnamed staged files (/proc/self/fd/N) can be linked too.
+    auto link = [&] {
+        return ::linkat(AT_FDCWD, verified_path.c_str(), AT_FDCWD, dst.c_str(), AT_SYMLINK_FOLLOW);
+    };
+    int lr = link();
+    if (lr != 0 && errno == EEXIST) {
+        // Not indexed, so it is a leftover we cannot vouch for.
+        ::unlink(dst.c_str());
+        lr = link();
+    }
+    if (lr != 0) {
+        if (errno != EXDEV && errno != EPERM)
+            return ErrnoFail("link", dst);
+        auto cr = CopyDurably(verified_path, dst, size);
+        if (!cr.is_ok())
+            return cr;
+    }
+    // A linked staged file may not have been synced yet; the entry only counts once both it and
+    // its name are durable.
+    auto sr = FsyncPath(dst, O_RDONLY);
+    if (sr.is_ok())
+        sr = FsyncPath(opt_.dir, O_RDONLY | O_DIRECTORY);
+    if (!sr.is_ok()) {
+        ::unlink(dst.c_str());
+        return sr;
+    }
+
+    lru_.push_back(Item{key, size});
+    index_.emplace(key, std::prev(lru_.end()));
+    bytes_ += size;
+    Touch(std::prev(lru_.end()));
+    return Result::Ok();
+}
+
+void StagingCache::Touch(std::list<Item>::iterator it) {
+    lru_.splice(lru_.end(), lru_, it);
+    // The mtime carries the LRU order over to the next run.
+    (void)::utimensat(AT_FDCWD, PathOf(it->key).c_str(), nullptr, 0);
+}
+
+void StagingCache::EvictFor(std::uint64_t incoming) {
+    while (!lru_.empty() && bytes_ + incoming > opt_.max_bytes) {
+        LogDebug("Staging cache evict %s (%llu bytes)",
+                 lru_.front().key.c_str(),
+                 (unsigned long long)lru_.front().bytes);
+        Remove(lru_.begin());
+    }
+}
+
+void StagingCache::Remove(std::list<Item>::iterator it) {
+    ::unlink(PathOf(it->key).c_str());
+    bytes_ -= it->bytes;
+    index_.erase(it->key);
+    lru_.erase(it);
+}
+
+} // namespace flash
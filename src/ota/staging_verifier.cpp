@@ -1,27 +1,22 @@
 #include "ota/staging_verifier.hpp"
 
 #include "crypto/sha256.hpp"
-#include "io/file_reader.hpp"
+#include "io/buffer_pool.hpp"
+#include "io/mmap_reader.hpp"
 
-#include <algorithm>
-#include <cctype>
 #include <cerrno>
+#include <cstring>
 #include <fcntl.h>
+#include <filesystem>
 #include <string>
+#include <sys/mman.h>
+#include <sys/stat.h>
 #include <unistd.h>
-#include <vector>
 
 namespace flash {
 
 namespace {
 
-std::string NormalizeHex(std::string s) {
-    std::transform(s.begin(), s.end(), s.begin(), [](unsigned char c) {
-        return static_cast<char>(std::tolower(c));
-    });
-    return s;
-}
-
 Result WriteAllToFd(int fd, std::span<const std::uint8_t> data) {
     size_t off = 0;
     while (off < data.size()) {
@@ -35,16 +30,43 @@ Result WriteAllToFd(int fd, std::span<const std::uint8_t> data) {
 
 } // namespace
 
-Result TempFile::Create(TempFile& out) {
-    char tmpl[] = "/tmp/ota-entry-XXXXXX";
-    const int fd = ::mkstemp(tmpl);
+Result TempFile::Create(TempFile& out) { return CreateIn("/tmp", out); }
+
+Result TempFile::CreateIn(const std::string& dir, TempFile& out) {
+    std::string tmpl = (dir.empty() ? std::string("/tmp") : dir) + "/ota-entry-XXXXXX";
+    const int fd = ::mkstemp(tmpl.data());
     if (fd < 0)
-        return Result::Fail(errno, "mkstemp failed");
+        return Result::Fail(errno, "mkstemp failed in " + dir);
     out.fd_.Reset(fd);
     out.path_ = tmpl;
     return Result::Ok();
 }
 
+Result TempFile::CreateUnnamedIn(const std::string& dir, TempFile& out) {
+    const int fd = ::open(dir.c_str(), O_TMPFILE | O_RDWR | O_CLOEXEC, 0600);
+    if (fd < 0) {
+        if (errno == EOPNOTSUPP || errno == EISDIR || errno == EINVAL)
+            return CreateIn(dir, out);
+        return Result::Fail(errno, "O_TMPFILE open failed in " + dir);
+    }
+    out.fd_.Reset(fd);
+    out.path_ = "/proc/self/fd/" + std::to_string(fd);
+    out.unnamed_dir_ = dir;
+    return Result::Ok();
+}
+
+Result TempFile::CreateInMemory(TempFile& out) {
+    const int fd = ::memfd_create("ota-entry", MFD_CLOEXEC);
+    if (fd < 0) {
+        return Result::Fail(errno,
+                            "memfd_create failed (" + std::string(std::strerror(errno)) + ")");
+    }
+    out.fd_.Reset(fd);
+    out.path_ = "/proc/self/fd/" + std::to_string(fd);
+    out.in_memory_ = true;
+    return Result::Ok();
+}
+
 TempFile::TempFile() = default;
 TempFile::TempFile(TempFile&& other) noexcept { *this = std::move(other); }
 TempFile& TempFile::operator=(TempFile&& other) noexcept {
@@ -52,6 +74,11 @@ TempFile& TempFile::operator=(TempFile&& other) noexcept {
         Cleanup();
         fd_ = std::move(other.fd_);
         path_ = std::move(other.path_);
+        unnamed_dir_ = std::move(other.unnamed_dir_);
+        in_memory_ = other.in_memory_;
+        other.path_.clear();
+        other.unnamed_dir_.clear();
+        other.in_memory_ = false;
     }
     return *this;
 }
@@ -64,10 +91,55 @@ void TempFile::Close() { fd_.Close(); }
 
 void TempFile::Cleanup() {
     Close();
-    if (!path_.empty()) {
+    if (!path_.empty() && unnamed_dir_.empty() && !in_memory_)
         ::unlink(path_.c_str());
-        path_.clear();
+    path_.clear();
+    unnamed_dir_.clear();
+    in_memory_ = false;
+}
+
+Result TempFile::Sync() const {
+    if (::fsync(fd_.Get()) != 0)
+        return Result::Fail(errno, "fsync failed: " + path_ + " (" + std::strerror(errno) + ")");
+    return Result::Ok();
+}
+
+Result TempFile::Publish(const std::string& dst, mode_t mode, bool sync_dir) {
+    if (!fd_.Valid())
+        return Result::Fail(-1, "publish: staged file is not open");
+    if (in_memory_)
+        return Result::Fail(EXDEV, "publish: staged file is in memory");
+    if (::fchmod(fd_.Get(), mode) != 0)
+        return Result::Fail(errno, "fchmod failed: " + std::string(std::strerror(errno)));
+
+    std::string src = path_;
+    if (!unnamed_dir_.empty()) {
+        // linkat() cannot replace dst, so give the file a private name first.
+        src = unnamed_dir_ + "/.ota-publish-" + std::to_string(::getpid()) + "-" +
+              std::to_string(fd_.Get());
+        ::unlink(src.c_str());
+        if (::linkat(AT_FDCWD, path_.c_str(), AT_FDCWD, src.c_str(), AT_SYMLINK_FOLLOW) != 0)
+            return Result::Fail(errno, "linkat failed: " + std::string(std::strerror(errno)));
+    }
+    if (::rename(src.c_str(), dst.c_str()) != 0) {
+        const int err = errno;
+        if (!unnamed_dir_.empty())
+            ::unlink(src.c_str());
+        return Result::Fail(err, "Atomic rename failed: " + std::string(std::strerror(err)));
     }
+    path_.clear();
+    unnamed_dir_.clear();
+    Close();
+    if (!sync_dir)
+        return Result::Ok();
+
+    std::string dir = std::filesystem::path(dst).parent_path().string();
+    if (dir.empty())
+        dir = ".";
+    Fd dfd(::open(dir.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC));
+    if (!dfd.Valid() || ::fsync(dfd.Get()) != 0)
+        return Result::Fail(errno, "fsync failed: " + dir + " (" + std::strerror(errno) + ")");
+    return Result::Ok();
 }
 
 Result OtaEntryStager::StageAndVerify(std::unique_ptr<IReader>& entry_reader,
@@ -77,42 +149,56 @@ Result OtaEntryStager::StageAndVerify(std::unique_ptr<IReader>& entry_reader,
         return Result::Fail(-1, "expected sha256 is empty");
 
     TempFile tmp;
-    auto cr = TempFile::Create(tmp);
+    Result cr;
+    switch (placement_.tier) {
+    case StagingPlacement::Tier::kMemory:
+        cr = TempFile::CreateInMemory(tmp);
+        break;
+    case StagingPlacement::Tier::kDestination:
+        cr = TempFile::CreateUnnamedIn(placement_.dir, tmp);
+        break;
+    case StagingPlacement::Tier::kDirectory:
+        cr = TempFile::CreateIn(placement_.dir, tmp);
+        break;
+    }
     if (!cr.is_ok())
         return cr;
 
     Sha256Hasher hasher;
-    std::vector<std::uint8_t> buf(64 * 1024);
+    auto& pool = BufferPool::Instance();
+    BufferPool::Buffer buf = pool.Acquire(pool.GetSizes().staging);
+    if (!buf.data())
+        return Result::Fail(ENOMEM, "staging buffer allocation failed");
 
     while (true) {
-        const ssize_t n = entry_reader->Read(std::span<std::uint8_t>(buf.data(), buf.size()));
+        std::span<const std::uint8_t> chunk;
+        const ssize_t n = entry_reader->ReadView(chunk, buf.Span());
         if (n < 0)
             return Result::Fail(-1, "read failed while staging");
         if (n == 0)
             break;
 
-        const auto chunk = std::span<const std::uint8_t>(buf.data(), static_cast<size_t>(n));
         hasher.Update(chunk);
         auto wr = WriteAllToFd(tmp.GetFd(), chunk);
         if (!wr.is_ok())
             return wr;
     }
 
+    // Stays open: an unnamed file only lives as long as its descriptor.
     (void)::fsync(tmp.GetFd());
-    tmp.Close();
 
     const std::string actual = hasher.FinalHex();
     if (actual.empty())
         return Result::Fail(-1, "sha256 compute failed");
-    if (NormalizeHex(actual) != NormalizeHex(expected_sha256)) {
+    if (!Sha256HexEquals(actual, expected_sha256)) {
         return Result::Fail(-1,
                             "sha256 mismatch: expected=" + expected_sha256 + " actual=" + actual);
     }
 
-    auto file_reader = std::make_unique<FileOrStdinReader>();
-    auto orr = FileOrStdinReader::Open(tmp.Path(), *file_reader);
-    if (!orr.ok)
-        return Result::Fail(-1, orr.msg);
+    auto file_reader = std::make_unique<MmapReader>();
+    auto orr = MmapReader::Open(tmp.Path(), *file_reader);
+    if (!orr.is_ok())
+        return orr;
 
     out.temp = std::move(tmp);
     out.reader = std::move(file_reader);
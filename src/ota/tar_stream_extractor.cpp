@@ -1,13 +1,24 @@
 #include "ota/tar_stream_extractor.hpp"
 
+#include "io/fd.hpp"
+#include "io/streaming_file_writer.hpp"
+#include "io/zero_scan.hpp"
 #include "ota/archive_path_policy.hpp"
 #include "ota/tar_stream_reader_adapter.hpp"
+#include "ota/uring_file_batcher.hpp"
 #include "util/logger.hpp"
 
 #include <archive.h>
 #include <archive_entry.h>
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
 #include <filesystem>
 #include <memory>
+#include <span>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <vector>
 
 namespace flash {
 
@@ -27,6 +38,112 @@ struct ArchiveWriteDeleter {
     }
 };
 
+bool IsLargeRegularFile(archive_entry* entry, std::uint64_t threshold) {
+    if (threshold == 0 || archive_entry_filetype(entry) != AE_IFREG)
+        return false;
+    if (archive_entry_hardlink(entry) != nullptr || !archive_entry_size_is_set(entry))
+        return false;
+    return static_cast<std::uint64_t>(archive_entry_size(entry)) >= threshold;
+}
+
+bool IsSmallRegularFile(archive_entry* entry, std::uint64_t threshold) {
+    if (archive_entry_filetype(entry) != AE_IFREG || archive_entry_hardlink(entry) != nullptr)
+        return false;
+    if (!archive_entry_size_is_set(entry) || archive_entry_sparse_count(entry) > 0)
+        return false;
+    return static_cast<std::uint64_t>(archive_entry_size(entry)) <= threshold;
+}
+
+Result ReadEntryData(archive* ar, std::uint64_t size, std::vector<std::uint8_t>& out) {
+    out.assign(size, 0);
+    const void* buff = nullptr;
+    size_t len = 0;
+    la_int64_t offset = 0;
+    while (true) {
+        const int rr = archive_read_data_block(ar, &buff, &len, &offset);
+        if (rr == ARCHIVE_EOF)
+            return Result::Ok();
+        if (rr != ARCHIVE_OK)
+            return Result::Fail(-1, "archive_read_data_block: " + ArchiveErr(ar));
+        if (offset < 0 || static_cast<std::uint64_t>(offset) + len > size)
+            return Result::Fail(-1, "archive entry data exceeds its declared size");
+        std::memcpy(out.data() + offset, buff, len);
+    }
+}
+
+// Writes an entry whose data is already in memory through libarchive's disk writer.
+Result WriteBufferedEntry(archive* aw,
+                          archive_entry* entry,
+                          std::span<const std::uint8_t> data,
+                          std::size_t sparse_block,
+                          ExtractStats& stats) {
+    std::uint64_t t0 = ExtractStats::NowNs();
+    if (archive_write_header(aw, entry) != ARCHIVE_OK)
+        return Result::Fail(-1, "archive_write_header: " + ArchiveErr(aw));
+    std::uint64_t t1 = ExtractStats::NowNs();
+    stats.write_header_ns += t1 - t0;
+
+    std::vector<DataPiece> pieces;
+    SplitNonZero(data, 0, sparse_block, pieces);
+    std::uint64_t written = 0;
+    for (const DataPiece& piece : pieces) {
+        written += piece.data.size();
+        if (archive_write_data_block(aw,
+                                     piece.data.data(),
+                                     piece.data.size(),
+                                     static_cast<la_int64_t>(piece.offset)) != ARCHIVE_OK) {
+            return Result::Fail(-1, "archive_write_data_block: " + ArchiveErr(aw));
+        }
+    }
+    stats.sparse_bytes += data.size() - written;
+    t0 = ExtractStats::NowNs();
+    stats.write_data_ns += t0 - t1;
+
+    if (archive_write_finish_entry(aw) != ARCHIVE_OK)
+        return Result::Fail(-1, "archive_write_finish_entry: " + ArchiveErr(aw));
+    stats.finish_ns += ExtractStats::NowNs() - t0;
+    return Result::Ok();
+}
+
+// Whether an entry written by an earlier run is still in place. Directory mtimes change as
+// their contents are created, so only regular files are compared by size and mtime.
+bool EntryOnDisk(archive_entry* entry, const std::string& path) {
+    struct stat st {};
+    if (::lstat(path.c_str(), &st) != 0)
+        return false;
+    const auto type = static_cast<mode_t>(archive_entry_filetype(entry));
+    if ((st.st_mode & S_IFMT) != type)
+        return false;
+    if (type != AE_IFREG || archive_entry_hardlink(entry) != nullptr)
+        return true;
+    if (archive_entry_size_is_set(entry) && st.st_size != archive_entry_size(entry))
+        return false;
+    return !archive_entry_mtime_is_set(entry) || st.st_mtim.tv_sec == archive_entry_mtime(entry);
+}
+
+void CountEntryType(archive_entry* entry, ExtractStats& stats) {
+    switch (archive_entry_filetype(entry)) {
+    case AE_IFREG:
+        if (archive_entry_hardlink(entry) != nullptr)
+            ++stats.hardlinks;
+        else
+            ++stats.files;
+        break;
+    case AE_IFDIR:
+        ++stats.dirs;
+        break;
+    case AE_IFLNK:
+        ++stats.symlinks;
+        break;
+    default:
+        if (archive_entry_hardlink(entry) != nullptr)
+            ++stats.hardlinks;
+        else
+            ++stats.other;
+        break;
+    }
+}
+
 } // namespace
 
 Result TarStreamExtractor::ExtractToDir(IReader& tar_stream,
@@ -40,8 +157,14 @@ Result TarStreamExtractor::ExtractToDir(IReader& tar_stream,
     if (!ar)
         return Result::Fail(-1, "archive_read_new failed");
 
-    archive_read_support_filter_all(ar.get());
-    archive_read_support_format_all(ar.get());
+    if (opt_.bounded_decoders) {
+        archive_read_support_filter_none(ar.get());
+        archive_read_support_filter_gzip(ar.get());
+        archive_read_support_format_tar(ar.get());
+    } else {
+        archive_read_support_filter_all(ar.get());
+        archive_read_support_format_all(ar.get());
+    }
 
     if (OpenArchiveFromReader(ar.get(), tar_stream) != ARCHIVE_OK) {
         return Result::Fail(-1, "archive_read_open2: " + ArchiveErr(ar.get()));
@@ -51,8 +174,11 @@ Result TarStreamExtractor::ExtractToDir(IReader& tar_stream,
     if (!aw)
         return Result::Fail(-1, "archive_write_disk_new failed");
 
+    // A resumed run finds files from the interrupted one, even on a freshly formatted target.
+    const bool unlink_existing = opt_.unlink_existing || opt_.resume_entries > 0;
     int flags = 0;
-    flags |= ARCHIVE_EXTRACT_UNLINK;
+    if (unlink_existing)
+        flags |= ARCHIVE_EXTRACT_UNLINK;
     flags |= ARCHIVE_EXTRACT_PERM;
     flags |= ARCHIVE_EXTRACT_TIME;
     flags |= ARCHIVE_EXTRACT_SECURE_NODOTDOT;
@@ -97,14 +223,122 @@ Result TarStreamExtractor::ExtractToDir(IReader& tar_stream,
         }
     };
 
+    ExtractStats local_stats;
+    ExtractStats& stats = opt_.stats_out ? *opt_.stats_out : local_stats;
+    stats = ExtractStats{};
+    const std::uint64_t start_ns = ExtractStats::NowNs();
+    const std::size_t sparse_block = opt_.sparse_files ? opt_.sparse_block_bytes : 0;
+
+    UringFileBatcher batcher;
+    bool batching = false;
+    if (opt_.batch_small_files && opt_.small_file_threshold_bytes > 0) {
+        UringFileBatcher::Options bopt;
+        bopt.unlink_existing = unlink_existing;
+        auto br = UringFileBatcher::Open(dst_dir, bopt, batcher);
+        batching = br.is_ok();
+        if (!batching) {
+            LogInfo("[%.*s] io_uring unavailable (%s); small files are written one by one",
+                    (int)tag.size(),
+                    tag.data(),
+                    br.msg.c_str());
+        }
+    }
+
+    std::vector<DataPiece> pieces;
+    std::vector<UringFileBatcher::Failed> failed;
+
+    // Runs the queued small files. Anything that did not make it through io_uring is written
+    // the regular way, which may also touch directories, so the cached dirfds are dropped.
+    auto flush_batch = [&]() -> Result {
+        if (!batching || batcher.Empty())
+            return Result::Ok();
+        const std::uint64_t t0 = ExtractStats::NowNs();
+        failed.clear();
+        auto r = batcher.Flush(failed);
+        stats.batch_ns += ExtractStats::NowNs() - t0;
+        stats.batch_submits = batcher.Submits();
+        if (!r.is_ok())
+            return r;
+        if (failed.empty())
+            return Result::Ok();
+
+        batcher.ResetDirCache();
+        for (auto& f : failed) {
+            ++stats.batch_fallbacks;
+            LogDebug("[%.*s] batched write failed, retrying: %s",
+                     (int)tag.size(),
+                     tag.data(),
+                     archive_entry_pathname(f.entry.get()));
+            auto wr = WriteBufferedEntry(aw.get(), f.entry.get(), f.data, sparse_block, stats);
+            if (!wr.is_ok())
+                return wr;
+        }
+        return Result::Ok();
+    };
+
+    // Everything that is not a batched small file must see the batch on disk first, so that
+    // directory, hardlink and overwrite order match the archive.
+    auto before_regular_entry = [&]() -> Result {
+        auto r = flush_batch();
+        if (batching)
+            batcher.ResetDirCache();
+        return r;
+    };
+
+    Fd sync_fd;
+    if (opt_.on_checkpoint) {
+        sync_fd.Reset(::open(dst_dir.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC));
+        if (!sync_fd.Valid()) {
+            return Result::Fail(
+                errno, "open failed: " + dst_dir + " (" + std::strerror(errno) + ")");
+        }
+    }
+
+    // Entries are numbered by header, so a checkpoint names the first entry not yet durable.
+    std::uint64_t entry_index = 0;
+    std::uint64_t checkpoint_bytes = 0;
+
+    auto checkpoint = [&]() -> Result {
+        auto fr = flush_batch();
+        if (!fr.is_ok())
+            return fr;
+        const std::uint64_t t0 = ExtractStats::NowNs();
+        if (::syncfs(sync_fd.Get()) != 0) {
+            return Result::Fail(
+                errno, "syncfs failed: " + dst_dir + " (" + std::strerror(errno) + ")");
+        }
+        stats.finish_ns += ExtractStats::NowNs() - t0;
+        ++stats.checkpoints;
+        checkpoint_bytes = extracted;
+        return opt_.on_checkpoint(extracted, entry_index);
+    };
+
+    if (opt_.resume_entries > 0) {
+        LogInfo("[%.*s] resuming after entry %llu",
+                (int)tag.size(),
+                tag.data(),
+                (unsigned long long)opt_.resume_entries);
+    }
+
     archive_entry* entry = nullptr;
 
     while (true) {
+        if (opt_.on_checkpoint && entry_index > opt_.resume_entries &&
+            extracted >= checkpoint_bytes + opt_.checkpoint_interval_bytes) {
+            auto cr = checkpoint();
+            if (!cr.is_ok())
+                return cr;
+        }
+
+        std::uint64_t t0 = ExtractStats::NowNs();
         const int r = archive_read_next_header(ar.get(), &entry);
+        std::uint64_t t1 = ExtractStats::NowNs();
+        stats.read_header_ns += t1 - t0;
         if (r == ARCHIVE_EOF)
             break;
         if (r != ARCHIVE_OK)
             return Result::Fail(-1, "archive_read_next_header: " + ArchiveErr(ar.get()));
+        const std::uint64_t index = entry_index++;
 
         std::string rel;
         auto path_res = path_policy.NormalizeEntryPath(archive_entry_pathname(entry), rel);
@@ -127,34 +361,179 @@ Result TarStreamExtractor::ExtractToDir(IReader& tar_stream,
             archive_entry_set_hardlink(entry, hardlink_target.c_str());
         }
 
+        if (index < opt_.resume_entries && EntryOnDisk(entry, target_path)) {
+            LogDebug("[%.*s] already extracted: %s", (int)tag.size(), tag.data(), rel.c_str());
+            if (archive_read_data_skip(ar.get()) != ARCHIVE_OK)
+                return Result::Fail(-1, "archive_read_data_skip: " + ArchiveErr(ar.get()));
+            ++stats.resumed;
+            if (archive_entry_size_is_set(entry))
+                extracted += static_cast<std::uint64_t>(archive_entry_size(entry));
+            checkpoint_bytes = extracted;
+            emit_progress();
+            continue;
+        }
+
         LogDebug("[%.*s] entry: %s", (int)tag.size(), tag.data(), target_path.c_str());
 
+        CountEntryType(entry, stats);
+        const std::uint64_t entry_start_ns = t1;
+
+        if (batching && IsSmallRegularFile(entry, opt_.small_file_threshold_bytes)) {
+            std::vector<std::uint8_t> data;
+            t0 = ExtractStats::NowNs();
+            const auto size = static_cast<std::uint64_t>(archive_entry_size(entry));
+            auto rd = ReadEntryData(ar.get(), size, data);
+            t1 = ExtractStats::NowNs();
+            stats.read_data_ns += t1 - t0;
+            if (!rd.is_ok())
+                return rd;
+            stats.bytes += data.size();
+            extracted += data.size();
+            emit_progress();
+
+            // Files with holes need the regular path, which can leave them unwritten.
+            SplitNonZero(data, 0, sparse_block, pieces);
+            const bool dense =
+                data.empty() || (pieces.size() == 1 && pieces[0].data.size() == data.size());
+            if (dense) {
+                if (batcher.Contains(rel)) {
+                    auto fr = flush_batch();
+                    if (!fr.is_ok())
+                        return fr;
+                }
+                if (batcher.Add(entry, rel, std::move(data))) {
+                    ++stats.batched_files;
+                    stats.RecordEntry(rel, size, t1 - entry_start_ns, opt_.slow_entry_count);
+                    if (batcher.Full()) {
+                        auto fr = flush_batch();
+                        if (!fr.is_ok())
+                            return fr;
+                    }
+                    continue;
+                }
+            }
+
+            auto fr = before_regular_entry();
+            if (!fr.is_ok())
+                return fr;
+            auto wr = WriteBufferedEntry(aw.get(), entry, data, sparse_block, stats);
+            if (!wr.is_ok())
+                return wr;
+            stats.RecordEntry(
+                rel, size, ExtractStats::NowNs() - entry_start_ns, opt_.slow_entry_count);
+            continue;
+        }
+
+        auto fr = before_regular_entry();
+        if (!fr.is_ok())
+            return fr;
+
+        const bool large_file = IsLargeRegularFile(entry, opt_.large_file_threshold_bytes);
+        const bool sparse = opt_.sparse_files && archive_entry_filetype(entry) == AE_IFREG;
+
+        t0 = ExtractStats::NowNs();
         const int wh = archive_write_header(aw.get(), entry);
+        t1 = ExtractStats::NowNs();
+        stats.write_header_ns += t1 - t0;
         if (wh != ARCHIVE_OK)
             return Result::Fail(-1, "archive_write_header: " + ArchiveErr(aw.get()));
 
+        // libarchive has created the file (with its path checks) at this point; large files
+        // are filled through a second descriptor and finish_entry then applies the metadata.
+        StreamingFileWriter large_writer;
+        bool streamed = false;
+        if (large_file) {
+            StreamingFileWriter::Options wopt;
+            // Preallocating would allocate the blocks the sparse scan is trying to skip.
+            if (!opt_.sparse_files)
+                wopt.preallocate_bytes = static_cast<std::uint64_t>(archive_entry_size(entry));
+            auto open_res = StreamingFileWriter::Open(target_path, wopt, large_writer);
+            if (open_res.is_ok()) {
+                streamed = true;
+                ++stats.large_files;
+            } else {
+                LogWarn("[%.*s] %s; using regular extraction",
+                        (int)tag.size(),
+                        tag.data(),
+                        open_res.msg.c_str());
+            }
+        }
+
         const void* buff = nullptr;
         size_t size = 0;
         la_int64_t offset = 0;
+        std::uint64_t entry_bytes = 0;
 
         while (true) {
+            t0 = ExtractStats::NowNs();
             const int rr = archive_read_data_block(ar.get(), &buff, &size, &offset);
+            t1 = ExtractStats::NowNs();
+            stats.read_data_ns += t1 - t0;
             if (rr == ARCHIVE_EOF)
                 break;
             if (rr != ARCHIVE_OK)
                 return Result::Fail(-1, "archive_read_data_block: " + ArchiveErr(ar.get()));
 
-            const int ww = archive_write_data_block(aw.get(), buff, size, offset);
-            if (ww != ARCHIVE_OK)
-                return Result::Fail(-1, "archive_write_data_block: " + ArchiveErr(aw.get()));
-
+            const std::span<const std::uint8_t> block(static_cast<const std::uint8_t*>(buff),
+                                                      size);
+            // The file size comes from the header (finish_entry truncates to it), so skipped
+            // zero pieces, trailing ones included, read back as zeros.
+            SplitNonZero(block,
+                         static_cast<std::uint64_t>(offset),
+                         sparse ? opt_.sparse_block_bytes : 0,
+                         pieces);
+            std::uint64_t written = 0;
+            for (const DataPiece& piece : pieces) {
+                written += piece.data.size();
+                if (streamed) {
+                    auto wr = large_writer.WriteAt(piece.data, piece.offset);
+                    if (!wr.is_ok())
+                        return wr;
+                    continue;
+                }
+                const int ww = archive_write_data_block(aw.get(),
+                                                        piece.data.data(),
+                                                        piece.data.size(),
+                                                        static_cast<la_int64_t>(piece.offset));
+                if (ww != ARCHIVE_OK)
+                    return Result::Fail(-1, "archive_write_data_block: " + ArchiveErr(aw.get()));
+            }
+            stats.write_data_ns += ExtractStats::NowNs() - t1;
+            stats.sparse_bytes += size - written;
+
+            entry_bytes += static_cast<std::uint64_t>(size);
             extracted += static_cast<std::uint64_t>(size);
             emit_progress();
         }
 
+        t0 = ExtractStats::NowNs();
+        if (streamed) {
+            auto cr = large_writer.Close();
+            if (!cr.is_ok())
+                return cr;
+        }
+
         const int wf = archive_write_finish_entry(aw.get());
+        t1 = ExtractStats::NowNs();
+        stats.finish_ns += t1 - t0;
         if (wf != ARCHIVE_OK)
             return Result::Fail(-1, "archive_write_finish_entry: " + ArchiveErr(aw.get()));
+
+        stats.bytes += entry_bytes;
+        stats.RecordEntry(rel, entry_bytes, t1 - entry_start_ns, opt_.slow_entry_count);
+    }
+
+    auto flush_res = opt_.on_checkpoint ? checkpoint() : flush_batch();
+    if (!flush_res.is_ok())
+        return flush_res;
+
+    stats.total_ns = ExtractStats::NowNs() - start_ns;
+    LogInfo("[%.*s] extract stats: %s", (int)tag.size(), tag.data(), stats.Summary().c_str());
+    if (!stats.slowest.empty()) {
+        LogInfo("[%.*s] slowest entries: %s",
+                (int)tag.size(),
+                tag.data(),
+                stats.SlowestSummary().c_str());
     }
 
     if (opt_.progress_sink) {
@@ -1,10 +1,10 @@
 #include "ota/tar_stream_reader_adapter.hpp"
 
+#include "io/buffer_pool.hpp"
 #include "system/signals.hpp"
 
 #include <cerrno>
 #include <memory>
-#include <vector>
 
 namespace flash {
 
@@ -12,10 +12,11 @@ namespace {
 
 struct ReaderCtx {
     IReader* reader = nullptr;
-    std::vector<std::uint8_t> buffer;
+    BufferPool::Buffer buffer;
 
-    explicit ReaderCtx(IReader& in, size_t buffer_size = 64 * 1024)
-        : reader(&in), buffer(buffer_size) {}
+    explicit ReaderCtx(IReader& in)
+        : reader(&in), buffer(BufferPool::Instance().Acquire(
+                           BufferPool::Instance().GetSizes().archive_read)) {}
 };
 
 la_ssize_t ReadCb(struct archive*, void* client_data, const void** out_buf) {
@@ -25,15 +26,24 @@ la_ssize_t ReadCb(struct archive*, void* client_data, const void** out_buf) {
     }
 
     auto* ctx = static_cast<ReaderCtx*>(client_data);
-    const ssize_t n =
-        ctx->reader->Read(std::span<std::uint8_t>(ctx->buffer.data(), ctx->buffer.size()));
+    // libarchive only needs the block until the next callback, which is what ReadView lends.
+    std::span<const std::uint8_t> view;
+    const ssize_t n = ctx->reader->ReadView(view, ctx->buffer.Span());
     if (n < 0)
         return -1;
 
-    *out_buf = ctx->buffer.data();
+    *out_buf = view.data();
     return static_cast<la_ssize_t>(n);
 }
 
+la_int64_t SkipCb(struct archive*, void* client_data, la_int64_t request) {
+    auto* ctx = static_cast<ReaderCtx*>(client_data);
+    if (request <= 0)
+        return 0;
+    const std::int64_t n = ctx->reader->Skip(static_cast<std::uint64_t>(request));
+    return n < 0 ? ARCHIVE_FATAL : static_cast<la_int64_t>(n);
+}
+
 int CloseCb(struct archive*, void* client_data) {
     delete static_cast<ReaderCtx*>(client_data);
     return ARCHIVE_OK;
@@ -43,7 +53,11 @@ int CloseCb(struct archive*, void* client_data) {
 
 int OpenArchiveFromReader(struct archive* ar, IReader& reader) {
     auto ctx = std::make_unique<ReaderCtx>(reader);
-    const int rc = archive_read_open2(ar, ctx.get(), nullptr, ReadCb, nullptr, CloseCb);
+    if (!ctx->buffer.data()) {
+        archive_set_error(ar, ENOMEM, "read buffer allocation failed");
+        return ARCHIVE_FATAL;
+    }
+    const int rc = archive_read_open2(ar, ctx.get(), nullptr, ReadCb, SkipCb, CloseCb);
     if (rc != ARCHIVE_OK) {
         return rc;
     }
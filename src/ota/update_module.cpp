@@ -1,11 +1,13 @@
 #include "ota/update_module.hpp"
 
-#include "io/counting_reader.hpp"
-#include "io/gzip_reader.hpp"
+#include "io/chunk_verifying_reader.hpp"
+#include "io/decrypting_reader.hpp"
+#include "io/reader_pipeline.hpp"
 #include "ota/component_installers.hpp"
 #include "util/logger.hpp"
 
 #include <algorithm>
+#include <optional>
 #include <utility>
 
 namespace flash {
@@ -16,6 +18,18 @@ bool EndsWithGz(const std::string& s) {
     return s.size() >= 3 && s.compare(s.size() - 3, 3, ".gz") == 0;
 }
 
+using Counted = CountStage<SourceStage>;
+
+template <ReaderStage Stack>
+Result InstallThrough(const UpdateModule::IInstallerStrategy& strategy,
+                      const Component& comp,
+                      Stack stack,
+                      const UpdateModule::Options& opt) {
+    PipelineReader<Stack> reader(std::move(stack));
+    return strategy.Install(
+        comp, reader, opt, comp.name.c_str(), reader.Stages().ConsumedCounter());
+}
+
 } // namespace
 
 UpdateModule::UpdateModule() : strategies_(CreateDefaultInstallerStrategies()) {}
@@ -33,30 +47,81 @@ Result UpdateModule::ExecuteComponent(const Component& comp,
 
     LogInfo("UpdateModule: name=%s type=%s file=%s",
             comp.name.c_str(),
-            comp.type.c_str(),
+            ComponentTypeName(comp.type),
             comp.filename.c_str());
 
-    std::uint64_t in_read = 0;
-    std::unique_ptr<IReader> effective_reader =
-        std::make_unique<CountingReader>(std::move(source), &in_read);
-
-    if (EndsWithGz(comp.filename)) {
-        try {
-            LogDebug("Wrapping GzipReader for %s", comp.filename.c_str());
-            effective_reader = std::make_unique<GzipReader>(std::move(effective_reader));
-        } catch (const std::exception& e) {
-            return Result::Fail(-1, std::string("Gzip init failed: ") + e.what());
-        }
-    }
-
     const auto it = std::find_if(strategies_.begin(), strategies_.end(), [&](const auto& strategy) {
         return strategy->Supports(comp);
     });
-    if (it != strategies_.end()) {
-        return (*it)->Install(comp, *effective_reader, opt, tag, &in_read);
+    if (it == strategies_.end())
+        return Result::Fail(-1,
+                            std::string("Unsupported component type: ") +
+                                ComponentTypeName(comp.type));
+    const IInstallerStrategy& strategy = **it;
+
+    Options eff = opt;
+    if ((opt.resume_offset > 0 || opt.resume_entries > 0) && !strategy.Resumable()) {
+        LogInfo("[%s] type %s cannot resume; starting over", tag, ComponentTypeName(comp.type));
+        eff.resume_offset = 0;
+        eff.resume_entries = 0;
+    }
+
+    // Both read-ahead stages share the cap.
+    std::uint64_t read_ahead_bytes = eff.read_ahead_bytes;
+    if (!comp.chunk_sha256.empty() && !comp.encryption.empty())
+        read_ahead_bytes /= 2;
+
+    // Chunk hashes cover the bundle entry as stored, so they are checked first.
+    if (!comp.chunk_sha256.empty()) {
+        ChunkVerifyingReader::Options vopt;
+        vopt.max_buffer_bytes = read_ahead_bytes;
+        auto verifying = std::make_unique<ChunkVerifyingReader>();
+        auto vr = ChunkVerifyingReader::Open(
+            std::move(source), comp.chunk_size, comp.chunk_sha256, vopt, *verifying);
+        if (!vr.is_ok())
+            return Result::Fail(vr.err, "component '" + comp.name + "': " + vr.msg);
+        source = std::move(verifying);
+    }
+
+    // Decryption runs on its own thread, so it stays behind the virtual source.
+    if (!comp.encryption.empty()) {
+        if (comp.encryption != "aes-256-gcm")
+            return Result::Fail(-1, "Unsupported encryption: " + comp.encryption);
+        if (!eff.decryption_key)
+            return Result::Fail(-1, "No decryption key for encrypted component: " + comp.name);
+        DecryptingReader::Options dopt;
+        dopt.max_buffer_bytes = read_ahead_bytes;
+        auto decrypting = std::make_unique<DecryptingReader>();
+        auto dr =
+            DecryptingReader::Open(std::move(source), *eff.decryption_key, dopt, *decrypting);
+        if (!dr.is_ok())
+            return Result::Fail(dr.err, "component '" + comp.name + "': " + dr.msg);
+        source = std::move(decrypting);
+    }
+
+    // The common stage combinations, fused at compile time.
+    Counted counted(SourceStage(std::move(source)));
+    const bool progress = strategy.ReportsReadProgress();
+    if (!EndsWithGz(comp.filename)) {
+        if (progress) {
+            return InstallThrough(
+                strategy, comp, ProgressStage(std::move(counted), ReadProgress(eff, tag)), eff);
+        }
+        return InstallThrough(strategy, comp, std::move(counted), eff);
     }
 
-    return Result::Fail(-1, "Unsupported component type: " + comp.type);
+    std::optional<InflateStage<Counted>> inflated;
+    try {
+        LogDebug("Decoding gzip for %s", comp.filename.c_str());
+        inflated.emplace(std::move(counted));
+    } catch (const std::exception& e) {
+        return Result::Fail(-1, std::string("Gzip init failed: ") + e.what());
+    }
+    if (progress) {
+        return InstallThrough(
+            strategy, comp, ProgressStage(std::move(*inflated), ReadProgress(eff, tag)), eff);
+    }
+    return InstallThrough(strategy, comp, std::move(*inflated), eff);
 }
 
 Result
@@ -0,0 +1,207 @@
+// uring_file_batcher.cpp - Batched small-file creation through linked io_uring chains.
+
+#include "ota/uring_file_batcher.hpp"
+
+#include "system/process.hpp"
+
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace flash {
+
+namespace {
+
+enum Op : std::uint64_t {
+    kUnlink = 0,
+    kOpen = 1,
+    kWrite = 2,
+    kClose = 3,
+};
+
+std::uint64_t UserData(std::size_t item, Op op) {
+    return (static_cast<std::uint64_t>(item) << 2) | op;
+}
+
+} // namespace
+
+Result UringFileBatcher::Open(const std::string& base_dir,
+                              const Options& opt,
+                              UringFileBatcher& out) {
+    out.opt_ = opt;
+    out.items_.clear();
+    out.items_.reserve(opt.max_files);
+    out.queued_.clear();
+    out.queued_bytes_ = 0;
+    out.dirs_.clear();
+
+    // Up to four SQEs per file (unlink, open, write, close).
+    auto r = IoUring::Open(opt.max_files * 4, out.ring_);
+    if (!r.is_ok())
+        return r;
+    r = out.ring_.RegisterSparseFiles(opt.max_files);
+    if (!r.is_ok())
+        return r;
+
+    const int fd = ::open(base_dir.c_str(), O_PATH | O_DIRECTORY | O_CLOEXEC);
+    if (fd < 0) {
+        return Result::Fail(errno,
+                            "open failed: " + base_dir + " (" + std::strerror(errno) + ")");
+    }
+    out.base_fd_.Reset(fd);
+
+    out.umask_ = ProcessUmask();
+    return Result::Ok();
+}
+
+bool UringFileBatcher::Full() const {
+    return items_.size() >= opt_.max_files || queued_bytes_ >= opt_.max_bytes;
+}
+
+int UringFileBatcher::ParentDirFd(const std::string& rel_dir) {
+    if (rel_dir.empty())
+        return base_fd_.Get();
+    if (auto it = dirs_.find(rel_dir); it != dirs_.end())
+        return it->second.Get();
+
+    const auto slash = rel_dir.rfind('/');
+    const int parent = ParentDirFd(slash == std::string::npos ? "" : rel_dir.substr(0, slash));
+    if (parent < 0)
+        return -1;
+
+    // O_NOFOLLOW on every component: a symlinked parent goes the regular (checked) way.
+    const std::string leaf = slash == std::string::npos ? rel_dir : rel_dir.substr(slash + 1);
+    const int fd = ::openat(parent, leaf.c_str(), O_PATH | O_DIRECTORY | O_NOFOLLOW | O_CLOEXEC);
+    if (fd < 0)
+        return -1;
+    return dirs_.emplace(rel_dir, Fd(fd)).first->second.Get();
+}
+
+bool UringFileBatcher::Add(archive_entry* entry,
+                           const std::string& rel,
+                           std::vector<std::uint8_t>&& data) {
+    const auto slash = rel.rfind('/');
+    const int dirfd = ParentDirFd(slash == std::string::npos ? "" : rel.substr(0, slash));
+    if (dirfd < 0)
+        return false;
+
+    Item item;
+    item.entry.reset(archive_entry_clone(entry));
+    if (!item.entry)
+        return false;
+    item.dirfd = dirfd;
+    item.name = slash == std::string::npos ? rel : rel.substr(slash + 1);
+    item.mode = archive_entry_perm(entry);
+    if (archive_entry_mtime_is_set(entry)) {
+        item.set_times = true;
+        item.times[1] = {archive_entry_mtime(entry), archive_entry_mtime_nsec(entry)};
+        if (archive_entry_atime_is_set(entry))
+            item.times[0] = {archive_entry_atime(entry), archive_entry_atime_nsec(entry)};
+        else
+            item.times[0] = {0, UTIME_NOW};
+    }
+
+    queued_bytes_ += data.size();
+    item.data = std::move(data);
+    queued_.insert(rel);
+    items_.push_back(std::move(item));
+    return true;
+}
+
+Result UringFileBatcher::Flush(std::vector<Failed>& failed) {
+    if (items_.empty())
+        return Result::Ok();
+
+    const int create_flags =
+        O_WRONLY | O_CREAT | O_NOFOLLOW | (opt_.unlink_existing ? O_EXCL : O_TRUNC);
+    unsigned total = 0;
+    for (std::size_t i = 0; i < items_.size(); ++i) {
+        Item& it = items_[i];
+        const auto slot = static_cast<std::uint32_t>(i);
+
+        if (opt_.unlink_existing) {
+            // Hard link: a missing file (ENOENT) must not cancel the rest of the chain.
+            io_uring_sqe* sqe = ring_.GetSqe();
+            sqe->opcode = IORING_OP_UNLINKAT;
+            sqe->fd = it.dirfd;
+            sqe->addr = reinterpret_cast<std::uint64_t>(it.name.c_str());
+            sqe->flags = IOSQE_IO_HARDLINK;
+            sqe->user_data = UserData(i, kUnlink);
+            ++total;
+        }
+
+        io_uring_sqe* sqe = ring_.GetSqe();
+        sqe->opcode = IORING_OP_OPENAT;
+        sqe->fd = it.dirfd;
+        sqe->addr = reinterpret_cast<std::uint64_t>(it.name.c_str());
+        sqe->len = it.mode & ~umask_;
+        sqe->open_flags = static_cast<std::uint32_t>(create_flags);
+        sqe->file_index = slot + 1;
+        sqe->flags = IOSQE_IO_LINK;
+        sqe->user_data = UserData(i, kOpen);
+        ++total;
+
+        if (!it.data.empty()) {
+            // Hard link so the close below still runs if the write fails.
+            sqe = ring_.GetSqe();
+            sqe->opcode = IORING_OP_WRITE;
+            sqe->fd = static_cast<std::int32_t>(slot);
+            sqe->addr = reinterpret_cast<std::uint64_t>(it.data.data());
+            sqe->len = static_cast<std::uint32_t>(it.data.size());
+            sqe->off = 0;
+            sqe->flags = IOSQE_FIXED_FILE | IOSQE_IO_HARDLINK;
+            sqe->user_data = UserData(i, kWrite);
+            ++total;
+        }
+
+        sqe = ring_.GetSqe();
+        sqe->opcode = IORING_OP_CLOSE;
+        sqe->file_index = slot + 1;
+        sqe->user_data = UserData(i, kClose);
+        ++total;
+    }
+
+    unsigned reaped = 0;
+    while (reaped < total) {
+        auto r = ring_.SubmitAndWait(total - reaped);
+        ++submits_;
+        if (!r.is_ok())
+            return r;
+
+        io_uring_cqe cqe{};
+        while (ring_.PopCqe(cqe)) {
+            ++reaped;
+            Item& it = items_[cqe.user_data >> 2];
+            const auto op = static_cast<Op>(cqe.user_data & 3);
+            if (op == kUnlink || it.result != 0)
+                continue;
+            if (cqe.res < 0)
+                it.result = cqe.res;
+            else if (op == kWrite && static_cast<std::size_t>(cqe.res) != it.data.size())
+                it.result = -EIO;
+        }
+    }
+
+    const bool force_chmod = !opt_.unlink_existing;
+    for (Item& it : items_) {
+        if (it.result == 0 && (force_chmod || (it.mode & ~umask_) != it.mode) &&
+            ::fchmodat(it.dirfd, it.name.c_str(), it.mode, 0) != 0) {
+            it.result = -errno;
+        }
+        if (it.result == 0 && it.set_times &&
+            ::utimensat(it.dirfd, it.name.c_str(), it.times, AT_SYMLINK_NOFOLLOW) != 0) {
+            it.result = -errno;
+        }
+        if (it.result != 0)
+            failed.push_back(Failed{std::move(it.entry), std::move(it.data)});
+    }
+
+    items_.clear();
+    queued_.clear();
+    queued_bytes_ = 0;
+    return Result::Ok();
+}
+
+} // namespace flash
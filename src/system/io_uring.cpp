@@ -0,0 +1,166 @@
+// io_uring.cpp - Raw-syscall io_uring setup, submission and completion handling.
+
+#include "system/io_uring.hpp"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <string>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <vector>
+
+namespace flash {
+
+namespace {
+
+Result ErrnoFail(const char* what) {
+    const int err = errno;
+    return Result::Fail(err, std::string(what) + " failed (" + std::strerror(err) + ")");
+}
+
+template <typename T> T* At(void* base, std::uint32_t off) {
+    return reinterpret_cast<T*>(static_cast<char*>(base) + off);
+}
+
+} // namespace
+
+IoUring::~IoUring() { Unmap(); }
+
+void IoUring::Unmap() {
+    if (sqes_)
+        ::munmap(sqes_, sqes_size_);
+    if (cq_ring_ && cq_ring_ != sq_ring_)
+        ::munmap(cq_ring_, cq_ring_size_);
+    if (sq_ring_)
+        ::munmap(sq_ring_, sq_ring_size_);
+    sqes_ = nullptr;
+    cq_ring_ = nullptr;
+    sq_ring_ = nullptr;
+    ring_fd_.Close();
+}
+
+Result IoUring::Open(unsigned entries, IoUring& out) {
+    out.Unmap();
+
+    io_uring_params p{};
+    const int fd = static_cast<int>(::syscall(__NR_io_uring_setup, entries, &p));
+    if (fd < 0)
+        return ErrnoFail("io_uring_setup");
+    out.ring_fd_.Reset(fd);
+
+    out.sq_ring_size_ = p.sq_off.array + p.sq_entries * sizeof(unsigned);
+    out.cq_ring_size_ = p.cq_off.cqes + p.cq_entries * sizeof(io_uring_cqe);
+    const bool single_mmap = (p.features & IORING_FEAT_SINGLE_MMAP) != 0;
+    if (single_mmap)
+        out.sq_ring_size_ = out.cq_ring_size_ = std::max(out.sq_ring_size_, out.cq_ring_size_);
+
+    void* sq = ::mmap(nullptr,
+                      out.sq_ring_size_,
+                      PROT_READ | PROT_WRITE,
+                      MAP_SHARED | MAP_POPULATE,
+                      fd,
+                      IORING_OFF_SQ_RING);
+    if (sq == MAP_FAILED)
+        return ErrnoFail("io_uring sq mmap");
+    out.sq_ring_ = sq;
+
+    if (single_mmap) {
+        out.cq_ring_ = sq;
+    } else {
+        void* cq = ::mmap(nullptr,
+                          out.cq_ring_size_,
+                          PROT_READ | PROT_WRITE,
+                          MAP_SHARED | MAP_POPULATE,
+                          fd,
+                          IORING_OFF_CQ_RING);
+        if (cq == MAP_FAILED)
+            return ErrnoFail("io_uring cq mmap");
+        out.cq_ring_ = cq;
+    }
+
+    out.sqes_size_ = p.sq_entries * sizeof(io_uring_sqe);
+    void* sqes = ::mmap(nullptr,
+                        out.sqes_size_,
+                        PROT_READ | PROT_WRITE,
+                        MAP_SHARED | MAP_POPULATE,
+                        fd,
+                        IORING_OFF_SQES);
+    if (sqes == MAP_FAILED)
+        return ErrnoFail("io_uring sqes mmap");
+    out.sqes_ = static_cast<io_uring_sqe*>(sqes);
+
+    out.sq_head_ = At<unsigned>(out.sq_ring_, p.sq_off.head);
+    out.sq_tail_ = At<unsigned>(out.sq_ring_, p.sq_off.tail);
+    out.sq_array_ = At<unsigned>(out.sq_ring_, p.sq_off.array);
+    out.sq_mask_ = *At<unsigned>(out.sq_ring_, p.sq_off.ring_mask);
+    out.sq_entries_ = p.sq_entries;
+    out.sqe_tail_ = out.submitted_tail_ = *out.sq_tail_;
+
+    out.cq_head_ = At<unsigned>(out.cq_ring_, p.cq_off.head);
+    out.cq_tail_ = At<unsigned>(out.cq_ring_, p.cq_off.tail);
+    out.cqes_ = At<io_uring_cqe>(out.cq_ring_, p.cq_off.cqes);
+    out.cq_mask_ = *At<unsigned>(out.cq_ring_, p.cq_off.ring_mask);
+    return Result::Ok();
+}
+
+Result IoUring::RegisterSparseFiles(unsigned count) {
+    std::vector<int> fds(count, -1);
+    if (::syscall(__NR_io_uring_register,
+                  ring_fd_.Get(),
+                  IORING_REGISTER_FILES,
+                  fds.data(),
+                  count) < 0) {
+        return ErrnoFail("io_uring_register(files)");
+    }
+    return Result::Ok();
+}
+
+io_uring_sqe* IoUring::GetSqe() {
+    const unsigned head = __atomic_load_n(sq_head_, __ATOMIC_ACQUIRE);
+    if (sqe_tail_ - head >= sq_entries_)
+        return nullptr;
+
+    const unsigned idx = sqe_tail_ & sq_mask_;
+    io_uring_sqe* sqe = &sqes_[idx];
+    std::memset(sqe, 0, sizeof(*sqe));
+    sq_array_[idx] = idx;
+    ++sqe_tail_;
+    return sqe;
+}
+
+Result IoUring::SubmitAndWait(unsigned wait_nr) {
+    __atomic_store_n(sq_tail_, sqe_tail_, __ATOMIC_RELEASE);
+
+    unsigned to_submit = sqe_tail_ - submitted_tail_;
+    while (true) {
+        const long n = ::syscall(__NR_io_uring_enter,
+                                 ring_fd_.Get(),
+                                 to_submit,
+                                 wait_nr,
+                                 wait_nr > 0 ? IORING_ENTER_GETEVENTS : 0,
+                                 nullptr,
+                                 0);
+        if (n < 0) {
+            if (errno == EINTR)
+                continue;
+            return ErrnoFail("io_uring_enter");
+        }
+        submitted_tail_ += static_cast<unsigned>(n);
+        to_submit -= static_cast<unsigned>(n);
+        if (to_submit == 0)
+            return Result::Ok();
+    }
+}
+
+bool IoUring::PopCqe(io_uring_cqe& out) {
+    const unsigned head = *cq_head_;
+    if (head == __atomic_load_n(cq_tail_, __ATOMIC_ACQUIRE))
+        return false;
+    out = cqes_[head & cq_mask_];
+    __atomic_store_n(cq_head_, head + 1, __ATOMIC_RELEASE);
+    return true;
+}
+
+} // namespace flash
@@ -0,0 +1,62 @@
+// process.cpp - Run external helper tools (mkfs and friends).
+
+#include "system/process.hpp"
+
+#include <cerrno>
+#include <cstring>
+#include <spawn.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+extern char** environ;
+
+namespace flash {
+
+Result RunProcess(const std::vector<std::string>& argv) {
+    if (argv.empty())
+        return Result::Fail(-1, "RunProcess: empty command");
+
+    std::vector<char*> args;
+    args.reserve(argv.size() + 1);
+    for (const auto& a : argv) {
+        args.push_back(const_cast<char*>(a.c_str()));
+    }
+    args.push_back(nullptr);
+
+    pid_t pid = -1;
+    const int rc = ::posix_spawnp(&pid, args[0], nullptr, nullptr, args.data(), environ);
+    if (rc != 0) {
+        return Result::Fail(rc, "spawn " + argv[0] + " failed (" + std::strerror(rc) + ")");
+    }
+
+    int status = 0;
+    while (::waitpid(pid, &status, 0) < 0) {
+        if (errno != EINTR) {
+            return Result::Fail(errno,
+                                "waitpid failed (" + std::string(std::strerror(errno)) + ")");
+        }
+    }
+
+    if (WIFEXITED(status)) {
+        if (WEXITSTATUS(status) == 0)
+            return Result::Ok();
+        return Result::Fail(-1,
+                            argv[0] + " exited with status " + std::to_string(WEXITSTATUS(status)));
+    }
+    if (WIFSIGNALED(status)) {
+        return Result::Fail(-1, argv[0] + " killed by signal " + std::to_string(WTERMSIG(status)));
+    }
+    return Result::Fail(-1, argv[0] + " terminated abnormally");
+}
+
+mode_t ProcessUmask() {
+    static const mode_t mask = [] {
+        const mode_t m = ::umask(0);
+        ::umask(m);
+        return m;
+    }();
+    return mask;
+}
+
+} // namespace flash
@@ -6,6 +6,38 @@
 
 namespace flash {
 
+ComponentType ComponentTypeFromName(std::string_view name) {
+    if (name == "file")
+        return ComponentType::File;
+    if (name == "raw")
+        return ComponentType::Raw;
+    if (name == "archive")
+        return ComponentType::Archive;
+    if (name == "erofs")
+        return ComponentType::Erofs;
+    if (name == "squashfs")
+        return ComponentType::Squashfs;
+    return ComponentType::Unknown;
+}
+
+const char* ComponentTypeName(ComponentType type) {
+    switch (type) {
+    case ComponentType::File:
+        return "file";
+    case ComponentType::Raw:
+        return "raw";
+    case ComponentType::Archive:
+        return "archive";
+    case ComponentType::Erofs:
+        return "erofs";
+    case ComponentType::Squashfs:
+        return "squashfs";
+    case ComponentType::Unknown:
+        break;
+    }
+    return "unknown";
+}
+
 std::expected<Manifest, std::string> ManifestHandler::Parse(const std::string& jsonInput) {
     ManifestParser parser;
     return parser.Parse(jsonInput);
@@ -1,8 +1,11 @@
 #include "util/manifest_parser.hpp"
 
-#include <cstring>
+#include <cstdint>
 #include <nlohmann/json.hpp>
 #include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
 
 namespace flash {
 
@@ -10,85 +13,347 @@ using json = nlohmann::json;
 
 namespace {
 
-bool StartsWith(const std::string& s, const char* prefix) {
-    const size_t n = std::strlen(prefix);
-    return s.size() >= n && s.compare(0, n, prefix) == 0;
+// A component key and the member it fills. "type" has no member; it maps to the enum.
+struct FieldSpec {
+    std::string_view key;
+    std::string Component::*text = nullptr;
+    std::uint64_t Component::*number = nullptr;
+    bool Component::*flag = nullptr;
+    std::vector<std::string> Component::*list = nullptr;
+};
+
+constexpr FieldSpec kFields[] = {
+    {.key = "name", .text = &Component::name},
+    {.key = "type"},
+    {.key = "filename", .text = &Component::filename},
+    {.key = "size", .number = &Component::size},
+    {.key = "sha256", .text = &Component::sha256},
+    {.key = "version", .text = &Component::version},
+    {.key = "force", .flag = &Component::force},
+    {.key = "install_to", .text = &Component::install_to},
+    {.key = "path", .text = &Component::path},
+    {.key = "permissions", .text = &Component::permissions},
+    {.key = "create-destination", .flag = &Component::create_destination},
+    {.key = "format-destination", .flag = &Component::format_destination},
+    {.key = "mount-options", .text = &Component::mount_options},
+    {.key = "mount-profile", .text = &Component::mount_profile},
+    {.key = "build-image", .flag = &Component::build_image},
+    {.key = "image-size", .number = &Component::image_size},
+    {.key = "verify-readback", .flag = &Component::verify_readback},
+    {.key = "encryption", .text = &Component::encryption},
+    {.key = "chunk-size", .number = &Component::chunk_size},
+    {.key = "chunk-sha256", .list = &Component::chunk_sha256},
+};
+
+const FieldSpec* FindField(std::string_view key) {
+    for (const FieldSpec& f : kFields) {
+        if (f.key == key)
+            return &f;
+    }
+    return nullptr;
 }
 
-std::expected<std::vector<Component>, std::string> ParseComponentsArray(const json& arr) {
-    if (!arr.is_array()) {
-        return std::unexpected("'components' must be an array");
+// nlohmann SAX handler. Tracks where it is with a small frame stack; anything it does not
+// need (unknown keys, other slots) is skipped by depth counting.
+class ManifestSax {
+  public:
+    ManifestSax(Manifest& out, const ManifestParser::Options& opt) : m_(out), opt_(opt) {}
+
+    const std::string& Error() const { return error_; }
+
+    bool null() { return Scalar(Kind::Null); }
+    bool boolean(bool v) {
+        if (Skipping())
+            return true;
+        if (!Accept(Kind::Bool))
+            return false;
+        if (next_ == Next::ForceAll)
+            m_.force_all = v;
+        else
+            comp_->*field_->flag = v;
+        next_ = Next::None;
+        return true;
+    }
+    bool number_integer(json::number_integer_t) { return Scalar(Kind::Signed); }
+    bool number_unsigned(json::number_unsigned_t v) {
+        if (Skipping())
+            return true;
+        if (!Accept(Kind::Unsigned))
+            return false;
+        comp_->*field_->number = v;
+        next_ = Next::None;
+        return true;
+    }
+    bool number_float(json::number_float_t, const json::string_t&) {
+        return Scalar(Kind::Float);
     }
+    bool string(json::string_t& v) {
+        if (Skipping())
+            return true;
+        if (!stack_.empty() && stack_.back() == Frame::Strings) {
+            (comp_->*field_->list).push_back(std::move(v));
+            return true;
+        }
+        if (!Accept(Kind::String))
+            return false;
+        if (next_ == Next::Version)
+            m_.version = std::move(v);
+        else if (next_ == Next::Hw)
+            m_.hw_compatibility = std::move(v);
+        else if (!field_->text && !field_->list)
+            comp_->type = ComponentTypeFromName(v);
+        else
+            comp_->*field_->text = std::move(v);
+        next_ = Next::None;
+        return true;
+    }
+    bool binary(json::binary_t&) { return Scalar(Kind::Null); }
 
-    std::vector<Component> out;
-    out.reserve(arr.size());
+    bool start_object(std::size_t) {
+        if (skip_depth_ > 0) {
+            ++skip_depth_;
+            return true;
+        }
+        if (stack_.empty()) {
+            stack_.push_back(Frame::Root);
+            return true;
+        }
+        if (stack_.back() == Frame::Strings)
+            return ListError();
+        if (stack_.back() == Frame::List) {
+            comp_ = &list_->emplace_back();
+            comp_->version = "0.0.0";
+            stack_.push_back(Frame::Component);
+            return true;
+        }
+        if (next_ == Next::Skip) {
+            next_ = Next::None;
+            skip_depth_ = 1;
+            return true;
+        }
+        if (next_ == Next::Slot) {
+            next_ = Next::None;
+            slot_has_components_ = false;
+            stack_.push_back(Frame::Slot);
+            return true;
+        }
+        return TypeError();
+    }
 
-    for (size_t i = 0; i < arr.size(); ++i) {
-        const auto& item = arr[i];
-        Component c;
-        c.name = item.value("name", "");
-        c.type = item.value("type", "");
-        c.filename = item.value("filename", "");
-        c.size = item.value("size", 0ULL);
-        c.sha256 = item.value("sha256", "");
-        c.version = item.value("version", "0.0.0");
-        c.force = item.value("force", false);
-        c.install_to = item.value("install_to", "");
-        c.path = item.value("path", "");
-        c.permissions = item.value("permissions", "");
-        c.create_destination = item.value("create-destination", false);
-        if (c.sha256.empty()) {
-            return std::unexpected("component[" + std::to_string(i) + "] missing sha256");
+    bool end_object() {
+        if (skip_depth_ > 0) {
+            --skip_depth_;
+            return true;
         }
-        out.push_back(c);
+        const Frame frame = stack_.back();
+        stack_.pop_back();
+        if (frame == Frame::Component && comp_->sha256.empty())
+            return Fail("component[" + std::to_string(list_->size() - 1) + "] missing sha256");
+        if (frame == Frame::Slot && !slot_has_components_)
+            return Fail("slot section missing components: " + slot_name_);
+        return true;
     }
 
-    return out;
-}
+    bool start_array(std::size_t) {
+        if (skip_depth_ > 0) {
+            ++skip_depth_;
+            return true;
+        }
+        if (stack_.empty())
+            return Fail("JSON root must be an object");
+        if (stack_.back() == Frame::List)
+            return Fail("component[" + std::to_string(list_->size()) + "] must be an object");
+        if (stack_.back() == Frame::Strings)
+            return ListError();
+        if (next_ == Next::Field && field_->list) {
+            next_ = Next::None;
+            stack_.push_back(Frame::Strings);
+            return true;
+        }
+        if (next_ == Next::Skip || next_ == Next::ArrayToSkip) {
+            next_ = Next::None;
+            skip_depth_ = 1;
+            return true;
+        }
+        if (next_ == Next::Components) {
+            next_ = Next::None;
+            stack_.push_back(Frame::List);
+            return true;
+        }
+        return TypeError();
+    }
+
+    bool end_array() {
+        if (skip_depth_ > 0) {
+            --skip_depth_;
+            return true;
+        }
+        stack_.pop_back();
+        return true;
+    }
+
+    bool key(json::string_t& k) {
+        if (skip_depth_ > 0)
+            return true;
+        next_ = Next::Skip;
+        switch (stack_.back()) {
+        case Frame::Root:
+            if (k == "version") {
+                next_ = Next::Version;
+            } else if (k == "hw_compatibility") {
+                next_ = Next::Hw;
+            } else if (k == "force_all") {
+                next_ = Next::ForceAll;
+            } else if (k == "components") {
+                if (opt_.slot.empty()) {
+                    next_ = Next::Components;
+                    list_ = &m_.components;
+                }
+            } else if (k.starts_with("slot-")) {
+                next_ = Next::Slot;
+                slot_name_ = std::move(k);
+                keep_slot_ = opt_.slot.empty() || slot_name_ == opt_.slot;
+                list_ = &m_.slot_components[slot_name_];
+            }
+            break;
+        case Frame::Slot:
+            if (k == "components") {
+                slot_has_components_ = true;
+                if (keep_slot_)
+                    next_ = Next::Components;
+                else
+                    next_ = Next::ArrayToSkip;
+            }
+            break;
+        case Frame::Component:
+            if ((field_ = FindField(k)) != nullptr)
+                next_ = Next::Field;
+            break;
+        case Frame::List:
+        case Frame::Strings:
+            break;
+        }
+        return true;
+    }
+
+    bool parse_error(std::size_t, const std::string&, const nlohmann::detail::exception& e) {
+        return Fail(std::string("Syntax Error: ") + e.what());
+    }
+
+  private:
+    enum class Frame { Root, Slot, List, Component, Strings };
+    // What the value after the current key feeds.
+    enum class Next { None, Skip, ArrayToSkip, Version, Hw, ForceAll, Components, Slot, Field };
+    enum class Kind { Null, Bool, Signed, Unsigned, Float, String };
+
+    bool Fail(std::string msg) {
+        if (error_.empty())
+            error_ = std::move(msg);
+        return false;
+    }
+
+    // Checks a scalar against what the current key expects.
+    bool Accept(Kind kind) {
+        if (stack_.empty())
+            return Fail("JSON root must be an object");
+        if (stack_.back() == Frame::List)
+            return Fail("component[" + std::to_string(list_->size()) + "] must be an object");
+        if (stack_.back() == Frame::Strings)
+            return ListError();
+        switch (next_) {
+        case Next::Version:
+        case Next::Hw:
+            return kind == Kind::String || TypeError();
+        case Next::ForceAll:
+            return kind == Kind::Bool || TypeError();
+        case Next::Field:
+            if (field_->list)
+                return TypeError();
+            if (field_->number)
+                return kind == Kind::Unsigned || TypeError();
+            if (field_->flag)
+                return kind == Kind::Bool || TypeError();
+            return kind == Kind::String || TypeError();
+        default:
+            return TypeError();
+        }
+    }
+
+    // True when the value is inside or is itself something being skipped.
+    bool Skipping() {
+        if (skip_depth_ > 0)
+            return true;
+        if (next_ != Next::Skip)
+            return false;
+        next_ = Next::None;
+        return true;
+    }
+
+    bool Scalar(Kind kind) { return Skipping() || Accept(kind); }
+
+    // A non-string inside a list field.
+    bool ListError() {
+        return Fail("component[" + std::to_string(list_->size() - 1) + "] '" +
+                    std::string(field_->key) + "' type must be array of strings");
+    }
+
+    bool TypeError() {
+        switch (next_) {
+        case Next::Components:
+        case Next::ArrayToSkip:
+            return Fail("'components' must be an array");
+        case Next::Slot:
+            return Fail("slot section must be object: " + slot_name_);
+        case Next::Field: {
+            const char* want = field_->number ? "unsigned number"
+                               : field_->flag ? "boolean"
+                               : field_->list ? "array of strings"
+                                              : "string";
+            return Fail("component[" + std::to_string(list_->size() - 1) + "] '" +
+                        std::string(field_->key) + "' type must be " + want);
+        }
+        case Next::ForceAll:
+            return Fail("'force_all' type must be boolean");
+        case Next::Hw:
+            return Fail("'hw_compatibility' type must be string");
+        default:
+            return Fail("'version' type must be string");
+        }
+    }
+
+    Manifest& m_;
+    const ManifestParser::Options& opt_;
+    std::string error_;
+
+    std::vector<Frame> stack_;
+    Next next_ = Next::None;
+    std::size_t skip_depth_ = 0;
+
+    std::string slot_name_;
+    bool keep_slot_ = false;
+    bool slot_has_components_ = false;
+    std::vector<Component>* list_ = nullptr;
+    Component* comp_ = nullptr;
+    const FieldSpec* field_ = nullptr;
+};
 
 } // namespace
 
-std::expected<Manifest, std::string> ManifestParser::Parse(const std::string& json_input) const {
+std::expected<Manifest, std::string> ManifestParser::Parse(const std::string& json_input,
+                                                           const Options& opt) const {
     try {
         if (json_input.find_first_not_of(" \t\n\r") == std::string::npos) {
             return std::unexpected("Empty input");
         }
 
-        auto j = json::parse(json_input);
-        if (!j.is_object()) {
-            return std::unexpected("JSON root must be an object");
-        }
-
         Manifest m;
-        m.version = j.value("version", "0.0.0");
-        m.hw_compatibility = j.value("hw_compatibility", "");
-        m.force_all = j.value("force_all", false);
-
-        if (j.contains("components")) {
-            auto parsed = ParseComponentsArray(j["components"]);
-            if (!parsed)
-                return std::unexpected(parsed.error());
-            m.components = std::move(*parsed);
-        }
-
-        for (const auto& [key, val] : j.items()) {
-            if (!StartsWith(key, "slot-"))
-                continue;
-            if (!val.is_object()) {
-                return std::unexpected("slot section must be object: " + key);
-            }
-            if (!val.contains("components")) {
-                return std::unexpected("slot section missing components: " + key);
-            }
-            auto parsed = ParseComponentsArray(val["components"]);
-            if (!parsed)
-                return std::unexpected(parsed.error());
-            m.slot_components.emplace(key, std::move(*parsed));
+        m.version = "0.0.0";
+        ManifestSax sax(m, opt);
+        if (!json::sax_parse(json_input, &sax)) {
+            return std::unexpected(sax.Error().empty() ? std::string("Syntax Error")
+                                                       : sax.Error());
         }
-
         return m;
-    } catch (const json::parse_error& e) {
-        return std::unexpected(std::string("Syntax Error: ") + e.what());
     } catch (const std::exception& e) {
         return std::unexpected(std::string("Internal Error: ") + e.what());
     }
@@ -1,10 +1,13 @@
 #include "util/manifest_selector.hpp"
 
+#include <utility>
+#include <vector>
+
 namespace flash {
 
-Result ManifestSelector::SelectForDevice(const Manifest& input,
-                                         const DeviceConfig& device,
-                                         Manifest& out) {
+namespace {
+
+Result CheckSelectable(const Manifest& input, const DeviceConfig& device) {
     if (device.current_slot.empty()) {
         return Result::Fail(-1, "device current_slot is empty");
     }
@@ -24,12 +27,39 @@ Result ManifestSelector::SelectForDevice(const Manifest& input,
                                 "' device='" + device.hw_compatibility + "'");
     }
 
-    auto it = input.slot_components.find(device.current_slot);
-    if (it == input.slot_components.end()) {
+    if (!input.slot_components.contains(device.current_slot)) {
         return Result::Fail(-1, "manifest missing slot section: " + device.current_slot);
     }
-    out = input;
-    out.components = it->second;
+    return Result::Ok();
+}
+
+} // namespace
+
+Result ManifestSelector::SelectForDevice(const Manifest& input,
+                                         const DeviceConfig& device,
+                                         Manifest& out) {
+    auto r = CheckSelectable(input, device);
+    if (!r.is_ok())
+        return r;
+    out.version = input.version;
+    out.hw_compatibility = input.hw_compatibility;
+    out.force_all = input.force_all;
+    out.components = input.slot_components.at(device.current_slot);
+    out.slot_components.clear();
+    return Result::Ok();
+}
+
+Result ManifestSelector::SelectForDevice(Manifest&& input,
+                                         const DeviceConfig& device,
+                                         Manifest& out) {
+    auto r = CheckSelectable(input, device);
+    if (!r.is_ok())
+        return r;
+    std::vector<Component> components = std::move(input.slot_components.at(device.current_slot));
+    if (&out != &input)
+        out = std::move(input);
+    out.components = std::move(components);
+    out.slot_components.clear();
     return Result::Ok();
 }
 
@@ -0,0 +1,152 @@
+#include "ota/async_finalizer.hpp"
+#include "ota/update_module.hpp"
+#include "testing.hpp"
+
+#include <cerrno>
+#include <filesystem>
+#include <future>
+#include <gtest/gtest.h>
+#include <memory>
+#include <string>
+#include <sys/stat.h>
+#include <vector>
+
+namespace flash {
+namespace {
+
+TEST(AsyncFinalizerTest, RunsTasksInOrderAndDropsThoseAfterAFailure) {
+    std::vector<int> ran;
+    {
+        AsyncFinalizer finalizer;
+        finalizer.Submit("one", [&] {
+            ran.push_back(1);
+            return Result::Ok();
+        });
+        finalizer.Submit("two", [&] {
+            ran.push_back(2);
+            return Result::Fail(5, "disk gone");
+        });
+        finalizer.Submit("three", [&] {
+            ran.push_back(3);
+            return Result::Ok();
+        });
+
+        const auto r = finalizer.Barrier();
+        ASSERT_FALSE(r.is_ok());
+        EXPECT_EQ(r.err, 5);
+        EXPECT_EQ(r.msg, "finalize 'two' failed: disk gone");
+        EXPECT_FALSE(finalizer.Error().is_ok());
+
+        // Queued work still runs (or is dropped) before destruction.
+        finalizer.Submit("four", [&] {
+            ran.push_back(4);
+            return Result::Ok();
+        });
+    }
+    EXPECT_EQ(ran, (std::vector<int>{1, 2}));
+}
+
+TEST(AsyncFinalizerTest, AtomicFileIsRenamedIntoPlaceByTheFinalizer) {
+    testutil::TemporaryDirectory tmp;
+    const std::string path = tmp.Path() + "/app.conf";
+
+    Component comp;
+    comp.name = "conf";
+    comp.type = ComponentType::File;
+    comp.path = path;
+    comp.permissions = "0600";
+
+    AsyncFinalizer finalizer;
+    std::promise<void> release;
+    finalizer.Submit("gate", [gate = release.get_future()]() mutable {
+        gate.wait();
+        return Result::Ok();
+    });
+
+    UpdateModule::Options opt;
+    opt.progress = false;
+    opt.finalizer = &finalizer;
+    auto res = UpdateModule::Execute(comp, std::make_unique<testutil::MemoryReader>("k=v"), opt);
+    ASSERT_TRUE(res.is_ok()) << res.msg;
+    EXPECT_FALSE(std::filesystem::exists(path));
+    EXPECT_TRUE(std::filesystem::exists(path + ".tmp"));
+
+    release.set_value();
+    res = finalizer.Barrier();
+    ASSERT_TRUE(res.is_ok()) << res.msg;
+    EXPECT_FALSE(std::filesystem::exists(path + ".tmp"));
+    struct stat st {};
+    ASSERT_EQ(::stat(path.c_str(), &st), 0);
+    EXPECT_EQ(st.st_mode & 0777, 0600u);
+    EXPECT_EQ(st.st_size, 3);
+}
+
+TEST(AsyncFinalizerTest, GroupCommitPublishesOnlyAfterEverySyncSucceeded) {
+    testutil::TemporaryDirectory tmp;
+    std::vector<std::string> log;
+    auto commit = [&](const std::string& name, bool sync_ok) {
+        return AsyncFinalizer::Commit{name,
+                                      [sync_ok] {
+                                          return sync_ok ? Result::Ok()
+                                                         : Result::Fail(EIO, "flush failed");
+                                      },
+                                      [&log, name] {
+                                          log.push_back("publish " + name);
+                                          return Result::Ok();
+                                      },
+                                      tmp.Path()};
+    };
+
+    AsyncFinalizer failing(AsyncFinalizer::Options{true});
+    failing.SubmitCommit(commit("a", true));
+    failing.SubmitCommit(commit("b", false));
+    failing.Submit("journal", [&] {
+        log.push_back("journal");
+        return Result::Ok();
+    });
+    const auto r = failing.Barrier();
+    ASSERT_FALSE(r.is_ok());
+    EXPECT_EQ(r.msg, "finalize 'b' failed: flush failed");
+    EXPECT_TRUE(log.empty());
+
+    AsyncFinalizer finalizer(AsyncFinalizer::Options{true});
+    finalizer.SubmitCommit(commit("a", true));
+    finalizer.Submit("journal", [&] {
+        log.push_back("journal");
+        return Result::Ok();
+    });
+    finalizer.SubmitCommit(commit("b", true));
+    ASSERT_TRUE(finalizer.Barrier().is_ok());
+    EXPECT_EQ(log, (std::vector<std::string>{"publish a", "publish b", "journal"}));
+}
+
+TEST(AsyncFinalizerTest, GroupCommitPublishesFileComponentsTogether) {
+    testutil::TemporaryDirectory tmp;
+    AsyncFinalizer finalizer(AsyncFinalizer::Options{true});
+    UpdateModule::Options opt;
+    opt.progress = false;
+    opt.finalizer = &finalizer;
+
+    const std::vector<std::string> names = {"a.conf", "b.conf", "c.conf"};
+    for (const auto& name : names) {
+        Component comp;
+        comp.name = name;
+        comp.type = ComponentType::File;
+        comp.path = tmp.Path() + "/" + name;
+        auto res =
+            UpdateModule::Execute(comp, std::make_unique<testutil::MemoryReader>(name), opt);
+        ASSERT_TRUE(res.is_ok()) << res.msg;
+        EXPECT_FALSE(std::filesystem::exists(comp.path));
+    }
+
+    auto res = finalizer.Barrier();
+    ASSERT_TRUE(res.is_ok()) << res.msg;
+    for (const auto& name : names) {
+        const std::string path = tmp.Path() + "/" + name;
+        EXPECT_EQ(std::filesystem::file_size(path), name.size());
+        EXPECT_FALSE(std::filesystem::exists(path + ".tmp"));
+    }
+}
+
+} // namespace
+} // namespace flash
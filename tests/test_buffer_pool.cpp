@@ -0,0 +1,59 @@
+#include "io/buffer_pool.hpp"
+
+#include <cstdint>
+#include <gtest/gtest.h>
+#include <unistd.h>
+#include <utility>
+
+namespace flash {
+namespace {
+
+TEST(BufferPoolTest, HandsOutAlignedBuffersAndReusesThem) {
+    BufferPool pool;
+    BufferPool::Options opt;
+    opt.max_idle_per_size = 1;
+    pool.Configure(opt);
+    const auto page = static_cast<std::size_t>(::sysconf(_SC_PAGESIZE));
+
+    std::uint8_t* first = nullptr;
+    {
+        auto a = pool.Acquire(1000);
+        ASSERT_NE(a.data(), nullptr);
+        EXPECT_EQ(a.size(), page);
+        EXPECT_EQ(reinterpret_cast<std::uintptr_t>(a.data()) % page, 0u);
+        first = a.data();
+
+        auto moved = std::move(a);
+        EXPECT_EQ(a.data(), nullptr);
+        EXPECT_EQ(moved.data(), first);
+        auto b = pool.Acquire(page);
+        EXPECT_NE(b.data(), first);
+    }
+    // Only one idle buffer per size is kept.
+    EXPECT_EQ(pool.Idle(), 1u);
+    auto again = pool.Acquire(page);
+    EXPECT_TRUE(again.data() != nullptr);
+    EXPECT_EQ(pool.Idle(), 0u);
+}
+
+TEST(BufferPoolTest, SizesArePerStageAndPerTarget) {
+    BufferPool pool;
+    BufferPool::Options opt;
+    opt.sizes.pipe = 512 * 1024;
+    opt.pipe_by_target["/dev/mmcblk0p3"] = 4 * 1024 * 1024;
+    opt.huge_pages = true;
+    pool.Configure(opt);
+
+    EXPECT_EQ(pool.GetSizes().pipe, 512u * 1024);
+    EXPECT_EQ(pool.PipeBytes("/data/app.bin"), 512u * 1024);
+    EXPECT_EQ(pool.PipeBytes("/dev/mmcblk0p3"), 4u * 1024 * 1024);
+
+    // Large buffers are huge-page aligned so THP can back them.
+    auto big = pool.Acquire(pool.PipeBytes("/dev/mmcblk0p3") + 1);
+    ASSERT_NE(big.data(), nullptr);
+    EXPECT_EQ(big.size(), 6u * 1024 * 1024);
+    EXPECT_EQ(reinterpret_cast<std::uintptr_t>(big.data()) % (2 * 1024 * 1024), 0u);
+}
+
+} // namespace
+} // namespace flash
@@ -0,0 +1,165 @@
+#include "io/chunk_verifying_reader.hpp"
+
+#include "crypto/sha256.hpp"
+#include "ota/ota_bundle_reader.hpp"
+#include "ota/ota_install_services.hpp"
+#include "ota/update_module.hpp"
+#include "testing.hpp"
+
+#include <algorithm>
+#include <cctype>
+#include <fstream>
+#include <gtest/gtest.h>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace flash {
+namespace {
+
+std::vector<std::uint8_t> RandomBytes(std::size_t n) {
+    std::mt19937 rng(7);
+    std::vector<std::uint8_t> out(n);
+    for (auto& b : out)
+        b = static_cast<std::uint8_t>(rng());
+    return out;
+}
+
+// Reads everything; returns false when a read fails. `out` holds what was handed out.
+bool VerifyAll(std::vector<std::uint8_t> data,
+               std::uint64_t chunk,
+               std::vector<std::string> hashes,
+               unsigned threads,
+               std::vector<std::uint8_t>& out,
+               std::uint64_t max_buffer_bytes = 0) {
+    out.clear();
+    ChunkVerifyingReader reader;
+    auto source = std::make_unique<testutil::MemoryReader>(std::move(data));
+    if (!ChunkVerifyingReader::Open(std::move(source),
+                                    chunk,
+                                    std::move(hashes),
+                                    {threads, max_buffer_bytes},
+                                    reader)
+             .is_ok()) {
+        return false;
+    }
+    std::vector<std::uint8_t> scratch(1000);
+    while (true) {
+        std::span<const std::uint8_t> view;
+        const ssize_t n = reader.ReadView(view, scratch);
+        if (n < 0)
+            return false;
+        if (n == 0)
+            return true;
+        out.insert(out.end(), view.begin(), view.end());
+    }
+}
+
+TEST(ChunkVerifyingReaderTest, PassesMatchingChunksThrough) {
+    const std::uint64_t chunk = 4096;
+    for (std::size_t size : {1UL, 4095UL, 4096UL, 4097UL, 5 * 4096UL, 100000UL}) {
+        for (unsigned threads : {1U, 3U}) {
+            SCOPED_TRACE("size=" + std::to_string(size) + " threads=" + std::to_string(threads));
+            const auto data = RandomBytes(size);
+            std::vector<std::uint8_t> out;
+            ASSERT_TRUE(VerifyAll(data, chunk, Sha256HexChunks(data, chunk), threads, out));
+            EXPECT_TRUE(out == data);
+
+            // Manifests may carry upper-case digests.
+            auto upper = Sha256HexChunks(data, chunk);
+            for (auto& h : upper) {
+                std::transform(h.begin(), h.end(), h.begin(), [](unsigned char c) {
+                    return static_cast<char>(std::toupper(c));
+                });
+            }
+            ASSERT_TRUE(VerifyAll(data, chunk, upper, threads, out));
+        }
+    }
+}
+
+TEST(ChunkVerifyingReaderTest, StopsAtBadTruncatedOrOverlongEntries) {
+    const std::uint64_t chunk = 4096;
+    const auto data = RandomBytes(10 * chunk + 123);
+    const auto hashes = Sha256HexChunks(data, chunk);
+    std::vector<std::uint8_t> out;
+
+    // Nothing from the bad chunk (or after it) is handed out.
+    auto flipped = data;
+    flipped[3 * chunk + 10] ^= 1;
+    EXPECT_FALSE(VerifyAll(flipped, chunk, hashes, 2, out));
+    EXPECT_LE(out.size(), 3U * chunk);
+    EXPECT_TRUE(std::equal(out.begin(), out.end(), data.begin()));
+
+    auto truncated = data;
+    truncated.resize(4 * chunk);
+    EXPECT_FALSE(VerifyAll(truncated, chunk, hashes, 2, out));
+
+    auto longer = data;
+    longer.resize(11 * chunk + 1);
+    EXPECT_FALSE(VerifyAll(longer, chunk, hashes, 2, out));
+
+    EXPECT_FALSE(VerifyAll(data, 0, hashes, 2, out));
+    EXPECT_FALSE(VerifyAll(data, chunk, {}, 2, out));
+}
+
+TEST(ChunkVerifyingReaderTest, ReadsAheadOnlyWhatTheBufferCapAllows) {
+    const std::uint64_t chunk = 4096;
+    const auto data = RandomBytes(10 * chunk + 5);
+    const auto hashes = Sha256HexChunks(data, chunk);
+    std::vector<std::uint8_t> out;
+
+    ASSERT_TRUE(VerifyAll(data, chunk, hashes, 4, out, 2 * chunk));
+    EXPECT_TRUE(out == data);
+    ASSERT_TRUE(VerifyAll(data, chunk, hashes, 4, out, 3 * chunk + 100));
+    EXPECT_TRUE(out == data);
+    EXPECT_FALSE(VerifyAll(data, chunk, hashes, 4, out, 2 * chunk - 1));
+}
+
+TEST(ChunkVerifyingReaderTest, StreamsChunkHashedComponentWithoutStaging) {
+    testutil::TemporaryDirectory tmp;
+    const std::string target = tmp.Path() + "/part.img";
+    const std::uint64_t chunk = 65536;
+    const auto payload = RandomBytes(3 * chunk + 17);
+
+    auto install = [&](const std::vector<std::uint8_t>& bytes) {
+        std::string list;
+        for (const auto& h : Sha256HexChunks(payload, chunk))
+            list += (list.empty() ? "\"" : ",\"") + h + "\"";
+        const std::string manifest_json =
+            std::string(R"({"version":"1.0.0","hw_compatibility":"x","components":[)") +
+            R"({"name":"img","type":"raw","filename":"img.bin","install_to":")" + target +
+            R"(","sha256":")" + Sha256Hex(std::span<const std::uint8_t>(payload)) +
+            R"(","chunk-size":)" + std::to_string(chunk) + R"(,"chunk-sha256":[)" + list +
+            "]}]}";
+        std::ofstream(target, std::ios::trunc).close();
+        testutil::MemoryReader source(testutil::BuildTar({
+            {"manifest.json", manifest_json, AE_IFREG},
+            {"img.bin", std::string(bytes.begin(), bytes.end()), AE_IFREG},
+        }));
+        OtaTarBundleReader bundle;
+        EXPECT_TRUE(bundle.Open(source).is_ok());
+        Manifest manifest;
+        EXPECT_TRUE(ManifestLoader::LoadFromFirstBundleEntry(bundle, manifest).is_ok());
+        const ComponentIndex index(manifest);
+        UpdateModule module;
+        InstallCoordinator coordinator(module, nullptr);
+        return coordinator.InstallMatchingEntries(bundle, index, 0);
+    };
+
+    auto r = install(payload);
+    ASSERT_TRUE(r.is_ok()) << r.msg;
+    std::ifstream is(target, std::ios::binary);
+    const std::vector<std::uint8_t> written((std::istreambuf_iterator<char>(is)),
+                                            std::istreambuf_iterator<char>());
+    EXPECT_TRUE(written == payload);
+
+    // The last chunk is bad: the first three are written, the install still fails.
+    auto corrupt = payload;
+    corrupt.back() ^= 1;
+    r = install(corrupt);
+    ASSERT_FALSE(r.is_ok());
+}
+
+} // namespace
+} // namespace flash
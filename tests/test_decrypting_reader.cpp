@@ -0,0 +1,184 @@
+#include "io/decrypting_reader.hpp"
+
+#include "crypto/aes_gcm.hpp"
+#include "crypto/sha256.hpp"
+#include "ota/ota_bundle_reader.hpp"
+#include "ota/ota_install_services.hpp"
+#include "ota/update_module.hpp"
+#include "testing.hpp"
+
+#include <fstream>
+#include <gtest/gtest.h>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace flash {
+namespace {
+
+AesGcmKey TestKey() {
+    AesGcmKey key{};
+    for (std::size_t i = 0; i < key.size(); ++i)
+        key[i] = static_cast<std::uint8_t>(i * 7 + 1);
+    return key;
+}
+
+std::vector<std::uint8_t> RandomBytes(std::size_t n) {
+    std::vector<std::uint8_t> out(n);
+    std::mt19937 rng(42);
+    for (auto& b : out)
+        b = static_cast<std::uint8_t>(rng());
+    return out;
+}
+
+std::vector<std::uint8_t> Encrypt(const std::vector<std::uint8_t>& plain, std::uint32_t chunk) {
+    ChunkedGcmHeader header;
+    header.chunk_bytes = chunk;
+    header.nonce = {1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12};
+    std::vector<std::uint8_t> out;
+    EXPECT_TRUE(EncryptChunkedAesGcm(TestKey(), header, plain, out).is_ok());
+    return out;
+}
+
+// Reads everything; returns false when a read fails. `out` holds what was handed out.
+bool DecryptAll(std::vector<std::uint8_t> encrypted,
+                std::vector<std::uint8_t>& out,
+                std::uint64_t max_buffer_bytes = 0) {
+    out.clear();
+    DecryptingReader reader;
+    auto source = std::make_unique<testutil::MemoryReader>(std::move(encrypted));
+    if (!DecryptingReader::Open(std::move(source), TestKey(), {max_buffer_bytes}, reader)
+             .is_ok()) {
+        return false;
+    }
+    std::vector<std::uint8_t> scratch(1000);
+    while (true) {
+        std::span<const std::uint8_t> view;
+        const ssize_t n = reader.ReadView(view, scratch);
+        if (n < 0)
+            return false;
+        if (n == 0)
+            return true;
+        out.insert(out.end(), view.begin(), view.end());
+    }
+}
+
+TEST(DecryptingReaderTest, RoundTripsAcrossChunkBoundaries) {
+    const std::uint32_t chunk = 4096;
+    for (std::size_t size : {0UL, 1UL, 4095UL, 4096UL, 4097UL, 5 * 4096UL, 100000UL}) {
+        SCOPED_TRACE("size=" + std::to_string(size));
+        const auto plain = RandomBytes(size);
+        const auto encrypted = Encrypt(plain, chunk);
+
+        DecryptingReader sized;
+        ASSERT_TRUE(DecryptingReader::Open(
+                        std::make_unique<testutil::MemoryReader>(encrypted), TestKey(), {}, sized)
+                        .is_ok());
+        EXPECT_EQ(sized.TotalSize(), std::optional<std::uint64_t>(size));
+
+        std::vector<std::uint8_t> out;
+        ASSERT_TRUE(DecryptAll(encrypted, out));
+        EXPECT_TRUE(out == plain);
+    }
+}
+
+TEST(DecryptingReaderTest, DecryptsAheadOnlyWhatTheBufferCapAllows) {
+    const std::uint32_t chunk = 4096;
+    const std::size_t sealed = chunk + kAesGcmTagBytes;
+    const auto plain = RandomBytes(10 * chunk + 5);
+    const auto encrypted = Encrypt(plain, chunk);
+    std::vector<std::uint8_t> out;
+
+    // Two worker buffers and one slot.
+    ASSERT_TRUE(DecryptAll(encrypted, out, 3 * sealed));
+    EXPECT_TRUE(out == plain);
+    ASSERT_TRUE(DecryptAll(encrypted, out, 4 * sealed + 100));
+    EXPECT_TRUE(out == plain);
+    EXPECT_FALSE(DecryptAll(encrypted, out, 3 * sealed - 1));
+}
+
+TEST(DecryptingReaderTest, StopsAtTamperedReorderedOrTruncatedChunks) {
+    const std::uint32_t chunk = 4096;
+    const std::size_t sealed = chunk + kAesGcmTagBytes;
+    const auto plain = RandomBytes(10 * chunk + 123);
+    const auto encrypted = Encrypt(plain, chunk);
+    std::vector<std::uint8_t> out;
+
+    // Nothing from the bad chunk (or after it) is handed out.
+    auto flipped = encrypted;
+    flipped[kChunkedGcmHeaderBytes + 3 * sealed + 10] ^= 1;
+    EXPECT_FALSE(DecryptAll(flipped, out));
+    EXPECT_LE(out.size(), 3U * chunk);
+    EXPECT_TRUE(std::equal(out.begin(), out.end(), plain.begin()));
+
+    auto swapped = encrypted;
+    std::swap_ranges(swapped.begin() + kChunkedGcmHeaderBytes,
+                     swapped.begin() + kChunkedGcmHeaderBytes + sealed,
+                     swapped.begin() + kChunkedGcmHeaderBytes + sealed);
+    EXPECT_FALSE(DecryptAll(swapped, out));
+
+    // Cut at a chunk boundary: the new last chunk was not sealed as final.
+    auto truncated = encrypted;
+    truncated.resize(kChunkedGcmHeaderBytes + 4 * sealed);
+    EXPECT_FALSE(DecryptAll(truncated, out));
+
+    auto other_nonce = encrypted;
+    other_nonce[12] ^= 1;
+    EXPECT_FALSE(DecryptAll(other_nonce, out));
+}
+
+TEST(DecryptingReaderTest, InstallsEncryptedComponentMatchingItsSha256) {
+    testutil::TemporaryDirectory tmp;
+    const std::string target = tmp.Path() + "/part.img";
+    const auto plain = RandomBytes(3 * 65536 + 17);
+    const auto encrypted = Encrypt(plain, 65536);
+    const std::string encrypted_str(encrypted.begin(), encrypted.end());
+
+    auto install = [&](const AesGcmKey* key, const std::string& sha256) {
+        const std::string manifest_json =
+            std::string(R"({"version":"1.0.0","hw_compatibility":"x","components":[)") +
+            R"({"name":"img","type":"raw","filename":"img.enc","encryption":"aes-256-gcm",)" +
+            R"("install_to":")" + target + R"(","sha256":")" + sha256 + R"("}]})";
+        std::ofstream(target, std::ios::trunc).close();
+        testutil::MemoryReader source(testutil::BuildTar({
+            {"manifest.json", manifest_json, AE_IFREG},
+            {"img.enc", encrypted_str, AE_IFREG},
+        }));
+        OtaTarBundleReader bundle;
+        EXPECT_TRUE(bundle.Open(source).is_ok());
+        Manifest manifest;
+        EXPECT_TRUE(ManifestLoader::LoadFromFirstBundleEntry(bundle, manifest).is_ok());
+        const ComponentIndex index(manifest);
+        UpdateModule module;
+        InstallCoordinator coordinator(module, nullptr);
+        coordinator.SetDecryptionKey(key);
+        return coordinator.InstallMatchingEntries(bundle, index, 0);
+    };
+
+    auto read_target = [&] {
+        std::ifstream is(target, std::ios::binary);
+        return std::vector<std::uint8_t>((std::istreambuf_iterator<char>(is)),
+                                         std::istreambuf_iterator<char>());
+    };
+
+    const AesGcmKey key = TestKey();
+    const std::string sha256 = Sha256Hex(std::span<const std::uint8_t>(encrypted));
+    auto r = install(&key, sha256);
+    ASSERT_TRUE(r.is_ok()) << r.msg;
+    EXPECT_TRUE(read_target() == plain);
+
+    // A payload sealed with the right key but not the one the manifest names (an older
+    // release, say) is rejected before anything is written.
+    const auto other = Encrypt(RandomBytes(1000), 65536);
+    r = install(&key, Sha256Hex(std::span<const std::uint8_t>(other)));
+    ASSERT_FALSE(r.is_ok());
+    EXPECT_TRUE(read_target().empty());
+
+    r = install(nullptr, sha256);
+    ASSERT_FALSE(r.is_ok());
+    EXPECT_NE(r.msg.find("No decryption key"), std::string::npos);
+}
+
+} // namespace
+} // namespace flash
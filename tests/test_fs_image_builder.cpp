@@ -0,0 +1,120 @@
+#include "ota/fs_image_builder.hpp"
+#include "ota/update_module.hpp"
+#include "testing.hpp"
+
+#include <array>
+#include <cerrno>
+#include <cstdint>
+#include <cstdio>
+#include <fcntl.h>
+#include <gtest/gtest.h>
+#include <memory>
+#include <optional>
+#include <string>
+#include <unistd.h>
+
+namespace flash {
+namespace {
+
+bool HasExtMagic(const std::string& image) {
+    const int fd = ::open(image.c_str(), O_RDONLY);
+    if (fd < 0)
+        return false;
+    std::uint8_t magic[2]{};
+    const ssize_t n = ::pread(fd, magic, sizeof(magic), 1024 + 0x38);
+    ::close(fd);
+    return n == 2 && magic[0] == 0x53 && magic[1] == 0xEF;
+}
+
+// Returns std::nullopt when debugfs is unavailable.
+std::optional<std::string> DebugfsCat(const std::string& image, const std::string& path) {
+    if (::access("/sbin/debugfs", X_OK) != 0 && ::access("/usr/sbin/debugfs", X_OK) != 0)
+        return std::nullopt;
+    const std::string cmd = "debugfs -R 'cat " + path + "' '" + image + "' 2>/dev/null";
+    FILE* p = ::popen(cmd.c_str(), "r");
+    if (!p)
+        return std::nullopt;
+    std::string out;
+    std::array<char, 256> buf{};
+    size_t n = 0;
+    while ((n = std::fread(buf.data(), 1, buf.size(), p)) > 0)
+        out.append(buf.data(), n);
+    ::pclose(p);
+    return out;
+}
+
+TEST(FsImageBuilderTest, BuildsExt4ImageFromTarStream) {
+    testutil::TemporaryDirectory tmp;
+    auto tar = testutil::BuildTar({
+        {"etc", "", AE_IFDIR},
+        {"etc/os-release", "NAME=ImageOS\n", AE_IFREG},
+        {"bin/app", "echo image\n", AE_IFREG},
+    });
+    testutil::MemoryReader reader(std::move(tar));
+
+    FsImageBuilder::Options opt;
+    opt.staging_dir = tmp.Path();
+    opt.image_size_bytes = 8 * 1024 * 1024;
+    opt.extract.progress = false;
+
+    const std::string image = tmp.Path() + "/rootfs.img";
+    auto res = FsImageBuilder(opt).Build(reader, "rootfs", image);
+    if (res.err == ENOENT) {
+        GTEST_SKIP() << "mke2fs not available: " << res.msg;
+    }
+    ASSERT_TRUE(res.is_ok()) << res.msg;
+    EXPECT_TRUE(HasExtMagic(image));
+
+    if (auto content = DebugfsCat(image, "/etc/os-release")) {
+        EXPECT_EQ(*content, "NAME=ImageOS\n");
+    }
+}
+
+TEST(FsImageBuilderTest, RejectsNonExtFilesystemAndMissingSize) {
+    testutil::MemoryReader reader(std::string{});
+    const std::string image = "/nonexistent/rootfs.img";
+
+    FsImageBuilder::Options opt;
+    opt.fs_type = "xfs";
+    opt.image_size_bytes = 8 * 1024 * 1024;
+    auto res = FsImageBuilder(opt).Build(reader, "rootfs", image);
+    ASSERT_FALSE(res.is_ok());
+    EXPECT_NE(res.msg.find("ext2/ext3/ext4 only"), std::string::npos);
+
+    opt.fs_type = "ext4";
+    opt.image_size_bytes = 0;
+    res = FsImageBuilder(opt).Build(reader, "rootfs", image);
+    ASSERT_FALSE(res.is_ok());
+    EXPECT_NE(res.msg.find("image size"), std::string::npos);
+}
+
+TEST(FsImageBuilderTest, ArchiveComponentWritesImageToTarget) {
+    testutil::TemporaryDirectory tmp;
+    const std::string target = tmp.Path() + "/rootfs-slot.img";
+
+    Component comp;
+    comp.name = "rootfs";
+    comp.type = ComponentType::Archive;
+    comp.filename = "rootfs.tar";
+    comp.path = target;
+    comp.build_image = true;
+    comp.image_size = 8 * 1024 * 1024;
+
+    auto tar = testutil::BuildTar({
+        {"etc/hostname", "slot-b\n", AE_IFREG},
+    });
+    auto res =
+        UpdateModule::Execute(comp, std::make_unique<testutil::MemoryReader>(std::move(tar)));
+    if (res.err == ENOENT) {
+        GTEST_SKIP() << "mke2fs not available: " << res.msg;
+    }
+    ASSERT_TRUE(res.is_ok()) << res.msg;
+    EXPECT_TRUE(HasExtMagic(target));
+
+    if (auto content = DebugfsCat(target, "/etc/hostname")) {
+        EXPECT_EQ(*content, "slot-b\n");
+    }
+}
+
+} // namespace
+} // namespace flash
@@ -0,0 +1,182 @@
+#include "crypto/sha256.hpp"
+#include "ota/install_journal.hpp"
+#include "ota/ota_installer.hpp"
+#include "testing.hpp"
+
+#include <csignal>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <gtest/gtest.h>
+#include <nlohmann/json.hpp>
+#include <random>
+#include <string>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <vector>
+
+namespace flash {
+namespace {
+
+constexpr std::uint64_t kMiB = 1024 * 1024ULL;
+
+std::string ReadFile(const std::string& path) {
+    std::ifstream is(path, std::ios::binary);
+    return std::string((std::istreambuf_iterator<char>(is)), std::istreambuf_iterator<char>());
+}
+
+bool WriteFile(const std::string& path, std::string_view content) {
+    std::ofstream os(path, std::ios::binary);
+    os.write(content.data(), static_cast<std::streamsize>(content.size()));
+    return os.good();
+}
+
+std::string Sha256OfString(const std::string& s) {
+    return Sha256Hex(std::span<const std::uint8_t>(
+        reinterpret_cast<const std::uint8_t*>(s.data()), s.size()));
+}
+
+// Kills the process once `component` has consumed `kill_at` input bytes; otherwise records
+// the first progress value seen for it.
+class KillingProgress final : public IProgress {
+  public:
+    KillingProgress(std::string component, std::uint64_t kill_at)
+        : component_(std::move(component)), kill_at_(kill_at) {}
+
+    void OnProgress(const ProgressEvent& e) override {
+        if (e.component != component_)
+            return;
+        if (!seen_) {
+            seen_ = true;
+            first_done_ = e.comp_done;
+        }
+        if (kill_at_ > 0 && e.comp_done >= kill_at_)
+            ::raise(SIGKILL);
+    }
+
+    std::uint64_t FirstDone() const { return first_done_; }
+
+  private:
+    std::string component_;
+    std::uint64_t kill_at_ = 0;
+    bool seen_ = false;
+    std::uint64_t first_done_ = 0;
+};
+
+TEST(InstallJournalTest, RoundTripsAndResetsForAnotherManifest) {
+    testutil::TemporaryDirectory tmp;
+    const std::string path = tmp.Path() + "/journal.json";
+
+    InstallJournal journal;
+    ASSERT_TRUE(InstallJournal::Open(path, "aaaa", journal).is_ok());
+    EXPECT_FALSE(journal.IsCompleted("boot"));
+    ASSERT_TRUE(journal.Begin("boot", 0).is_ok());
+    ASSERT_TRUE(journal.Complete("boot").is_ok());
+    ASSERT_TRUE(journal.Begin("rootfs", 0).is_ok());
+    ASSERT_TRUE(journal.Checkpoint(12345, 7).is_ok());
+    EXPECT_FALSE(std::filesystem::exists(path + ".tmp"));
+
+    InstallJournal reloaded;
+    ASSERT_TRUE(InstallJournal::Open(path, "aaaa", reloaded).is_ok());
+    EXPECT_TRUE(reloaded.IsCompleted("boot"));
+    EXPECT_FALSE(reloaded.IsCompleted("rootfs"));
+    EXPECT_EQ(reloaded.ResumeOffset("rootfs"), 12345u);
+    EXPECT_EQ(reloaded.ResumeEntries("rootfs"), 7u);
+    EXPECT_EQ(reloaded.ResumeOffset("boot"), 0u);
+
+    InstallJournal other;
+    ASSERT_TRUE(InstallJournal::Open(path, "bbbb", other).is_ok());
+    EXPECT_FALSE(other.IsCompleted("boot"));
+    EXPECT_EQ(other.ResumeOffset("rootfs"), 0u);
+
+    ASSERT_TRUE(reloaded.Discard().is_ok());
+    EXPECT_FALSE(std::filesystem::exists(path));
+}
+
+// The big component as a raw target or as a file; the file goes into a directory the first run
+// creates, so it is staged elsewhere and copied through <path>.tmp before the kill.
+class ResumeTest : public ::testing::TestWithParam<std::string> {};
+
+TEST_P(ResumeTest, ResumesAfterKillAtRandomOffset) {
+    namespace fs = std::filesystem;
+    testutil::TemporaryDirectory tmp;
+    const fs::path base(tmp.Path());
+    const std::string config_path = (base / "ota.conf").string();
+    const std::string journal_path = (base / "journal.json").string();
+    const std::string small_out = (base / "small.txt").string();
+    const bool file = GetParam() == "file";
+    const std::string big_out = (base / (file ? "out/big.bin" : "big.bin")).string();
+    const std::string big_target =
+        file ? R"("type":"file","create-destination":true,"path":")" + big_out
+             : R"("type":"raw","install_to":")" + big_out;
+
+    std::string big(24 * kMiB, '\0');
+    std::mt19937_64 rng(std::random_device{}());
+    for (auto& c : big)
+        c = static_cast<char>(rng() & 0xff);
+    const std::string small = "small=1\n";
+
+    const std::string manifest_json =
+        R"({"version":"1.0.0","hw_compatibility":"board","slot-a":{"components":[)"
+        R"({"name":"small","type":"file","filename":"small.txt","path":")" +
+        small_out + R"(","sha256":")" + Sha256OfString(small) +
+        R"("},{"name":"big","filename":"big.bin",)" + big_target + R"(","sha256":")" +
+        Sha256OfString(big) + R"("}]}})";
+    const auto ota = testutil::BuildTar({
+        {"manifest.json", manifest_json, AE_IFREG},
+        {"small.txt", small, AE_IFREG},
+        {"big.bin", big, AE_IFREG},
+    });
+    const std::string ota_path = (base / "bundle.tar").string();
+    ASSERT_TRUE(WriteFile(ota_path, std::string_view(reinterpret_cast<const char*>(ota.data()),
+                                                     ota.size())));
+    ASSERT_TRUE(WriteFile(config_path, R"({"current_slot":"slot-a","hw_compatibility":"board"})"));
+    const testutil::ScopedEnv config_env("OTA_CONFIG_PATH", config_path);
+
+    // Past the first journal checkpoint (8 MiB) but before the end of the entry.
+    const std::uint64_t kill_at = 12 * kMiB + rng() % (10 * kMiB);
+    SCOPED_TRACE("kill_at=" + std::to_string(kill_at));
+
+    const pid_t pid = ::fork();
+    ASSERT_GE(pid, 0);
+    if (pid == 0) {
+        KillingProgress progress("big", kill_at);
+        OtaInstaller installer;
+        installer.SetProgressSink(&progress);
+        installer.SetJournalPath(journal_path);
+        (void)installer.Run(ota_path);
+        ::_exit(0);
+    }
+    int status = 0;
+    ASSERT_EQ(::waitpid(pid, &status, 0), pid);
+    ASSERT_TRUE(WIFSIGNALED(status));
+    ASSERT_EQ(WTERMSIG(status), SIGKILL);
+
+    nlohmann::json j = nlohmann::json::parse(ReadFile(journal_path));
+    ASSERT_EQ(j["completed"], nlohmann::json::array({"small"}));
+    ASSERT_EQ(j["current"]["name"], "big");
+    const std::uint64_t durable = j["current"]["bytes-written"].get<std::uint64_t>();
+    EXPECT_GE(durable, 8 * kMiB);
+    EXPECT_LE(durable, kill_at);
+
+    // A completed component is not installed again.
+    ASSERT_EQ(::unlink(small_out.c_str()), 0);
+
+    KillingProgress progress("big", 0);
+    OtaInstaller installer;
+    installer.SetProgressSink(&progress);
+    installer.SetJournalPath(journal_path);
+    const auto r = installer.Run(ota_path);
+    ASSERT_TRUE(r.is_ok()) << r.message();
+
+    EXPECT_GE(progress.FirstDone(), durable);
+    EXPECT_TRUE(ReadFile(big_out) == big);
+    EXPECT_FALSE(fs::exists(small_out));
+    EXPECT_FALSE(fs::exists(big_out + ".tmp"));
+    EXPECT_FALSE(fs::exists(journal_path));
+}
+
+INSTANTIATE_TEST_SUITE_P(InstallJournalTest, ResumeTest, ::testing::Values("raw", "file"));
+
+} // namespace
+} // namespace flash
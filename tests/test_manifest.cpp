@@ -1,4 +1,5 @@
 #include "util/manifest.hpp"
+#include "util/manifest_parser.hpp"
 
 #include <gtest/gtest.h>
 
@@ -91,3 +92,51 @@ TEST(ManifestTest, FullParseTest) {
     ASSERT_TRUE(m.has_value());
     EXPECT_EQ(m->components[0].version, "1.1");
 }
+
+TEST(ManifestTest, SlotParseKeepsOnlyThatSlot) {
+    const std::string raw = R"({
+        "version": "2.0", "hw_compatibility": "board", "extra": {"nested": [1, {"a": null}]},
+        "components": [{"name": "legacy", "sha256": "00"}],
+        "slot-a": {"components": [{"name": "other", "type": "raw", "size": "not checked"}]},
+        "slot-b": {"note": [true], "components": [
+            {"name": "rootfs", "type": "squashfs", "filename": "rootfs.img", "sha256": "ab",
+             "size": 42, "verify-readback": true, "unknown": {"x": [1]}},
+            {"name": "cfg", "type": "bogus", "sha256": "cd"}]}
+    })";
+
+    auto m = ManifestParser().Parse(raw, ManifestParser::Options{"slot-b"});
+    ASSERT_TRUE(m.has_value()) << m.error();
+    EXPECT_EQ(m->version, "2.0");
+    EXPECT_EQ(m->hw_compatibility, "board");
+    EXPECT_TRUE(m->components.empty());
+    ASSERT_EQ(m->slot_components.size(), 2U);
+    EXPECT_TRUE(m->slot_components["slot-a"].empty());
+
+    const auto& b = m->slot_components["slot-b"];
+    ASSERT_EQ(b.size(), 2U);
+    EXPECT_EQ(b[0].name, "rootfs");
+    EXPECT_EQ(b[0].type, ComponentType::Squashfs);
+    EXPECT_EQ(b[0].size, 42U);
+    EXPECT_TRUE(b[0].verify_readback);
+    EXPECT_EQ(b[0].version, "0.0.0");
+    EXPECT_EQ(b[1].type, ComponentType::Unknown);
+
+    // Without a slot every section is validated, so the bad size in slot-a is reported.
+    auto all = ManifestParser().Parse(raw);
+    ASSERT_FALSE(all.has_value());
+    EXPECT_NE(all.error().find("'size' type must be unsigned number"), std::string::npos);
+}
+
+TEST(ManifestTest, ParsesChunkHashList) {
+    const std::string raw = R"({"components": [
+        {"name": "img", "sha256": "ab", "chunk-size": 4096, "chunk-sha256": ["aa", "bb"]}]})";
+    auto m = ManifestParser().Parse(raw);
+    ASSERT_TRUE(m.has_value()) << m.error();
+    EXPECT_EQ(m->components[0].chunk_size, 4096U);
+    EXPECT_EQ(m->components[0].chunk_sha256, (std::vector<std::string>{"aa", "bb"}));
+
+    auto bad = ManifestParser().Parse(
+        R"({"components": [{"name": "x", "sha256": "ab", "chunk-sha256": [1]}]})");
+    ASSERT_FALSE(bad.has_value());
+    EXPECT_NE(bad.error().find("chunk-sha256"), std::string::npos);
+}
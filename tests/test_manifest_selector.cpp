@@ -2,6 +2,7 @@
 
 #include <gtest/gtest.h>
 #include <string>
+#include <utility>
 
 namespace flash {
 
@@ -36,4 +37,26 @@ TEST(ManifestSelectorTest, RejectsHardwareMismatch) {
     EXPECT_NE(res.msg.find("hw_compatibility mismatch"), std::string::npos);
 }
 
+TEST(ManifestSelectorTest, MovesSelectedSlotOutOfParsedManifest) {
+    Manifest manifest;
+    manifest.version = "3.0";
+    manifest.hw_compatibility = "board";
+    manifest.slot_components["slot-a"] = {Component{.name = "a", .filename = "a.bin"}};
+    manifest.slot_components["slot-b"] = {Component{.name = "b", .filename = "b.bin"}};
+
+    DeviceConfig device;
+    device.current_slot = "slot-b";
+    device.hw_compatibility = "board";
+
+    // The vector is moved, not copied.
+    const Component* first = manifest.slot_components["slot-b"].data();
+    Manifest selected;
+    auto res = ManifestSelector::SelectForDevice(std::move(manifest), device, selected);
+    ASSERT_TRUE(res.is_ok()) << res.msg;
+    EXPECT_EQ(selected.version, "3.0");
+    EXPECT_TRUE(selected.slot_components.empty());
+    ASSERT_EQ(selected.components.size(), 1U);
+    EXPECT_EQ(selected.components.data(), first);
+}
+
 } // namespace flash
@@ -0,0 +1,130 @@
+#include "ota/memory_budget.hpp"
+#include "testing.hpp"
+
+#include <csignal>
+#include <cstdlib>
+#include <fcntl.h>
+#include <filesystem>
+#include <fstream>
+#include <gtest/gtest.h>
+#include <limits>
+#include <string>
+#include <sys/ptrace.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+namespace flash {
+namespace {
+
+constexpr std::uint64_t kMiB = 1024 * 1024ULL;
+
+// VmHWM of a live process, in bytes; 0 when it cannot be read.
+std::uint64_t ReadVmHwm(pid_t pid) {
+    std::ifstream is("/proc/" + std::to_string(pid) + "/status");
+    std::string key;
+    while (is >> key) {
+        if (key == "VmHWM:") {
+            std::uint64_t kib = 0;
+            is >> kib;
+            return kib * 1024;
+        }
+        is.ignore(std::numeric_limits<std::streamsize>::max(), '\n');
+    }
+    return 0;
+}
+
+// Runs a child that called PTRACE_TRACEME before exec to completion. The child is stopped
+// just before it exits, while its address space still exists, to read its own peak RSS:
+// wait4's ru_maxrss would also count the pages it inherited from this process at fork.
+bool TraceToExit(pid_t pid, int& status, std::uint64_t& peak) {
+    peak = 0;
+    if (::waitpid(pid, &status, 0) != pid)
+        return false;
+    if (!WIFSTOPPED(status))
+        return true; // never got to exec
+    if (::ptrace(PTRACE_SETOPTIONS, pid, nullptr, PTRACE_O_TRACEEXIT | PTRACE_O_EXITKILL) != 0)
+        return false;
+    long sig = 0;
+    while (true) {
+        if (::ptrace(PTRACE_CONT, pid, nullptr, sig) != 0)
+            return false;
+        if (::waitpid(pid, &status, 0) != pid)
+            return false;
+        if (WIFEXITED(status) || WIFSIGNALED(status))
+            return true;
+        sig = 0;
+        if ((status >> 8) == (SIGTRAP | (PTRACE_EVENT_EXIT << 8)))
+            peak = ReadVmHwm(pid);
+        else
+            sig = WSTOPSIG(status);
+    }
+}
+
+TEST(MemoryBudgetTest, ScalesBuffersAndStagingWithTheBudget) {
+    MemoryPlan plan;
+    EXPECT_FALSE(PlanMemoryBudget(8 * kMiB, plan).is_ok());
+
+    ASSERT_TRUE(PlanMemoryBudget(16 * kMiB, plan).is_ok());
+    EXPECT_EQ(plan.pool.sizes.pipe, 256 * 1024u);
+    EXPECT_EQ(plan.pool.sizes.staging, 256 * 1024u);
+    EXPECT_EQ(plan.pool.sizes.archive_read, 64 * 1024u);
+    EXPECT_EQ(plan.memory_staging_bytes, 512 * 1024u);
+    EXPECT_EQ(plan.small_file_batch_bytes, 512 * 1024u);
+    EXPECT_EQ(plan.read_ahead_bytes, 512 * 1024u);
+    EXPECT_TRUE(plan.bounded_decoders);
+
+    ASSERT_TRUE(PlanMemoryBudget(256 * kMiB, plan).is_ok());
+    EXPECT_EQ(plan.pool.sizes.pipe, 1024 * 1024u);
+    EXPECT_EQ(plan.memory_staging_bytes, (256 * kMiB - kMemoryBudgetReserveBytes) / 8);
+}
+
+// Builds the ota.sh sample bundle and installs it under the smallest budget; the installer's
+// peak RSS must stay below it.
+TEST(MemoryBudgetTest, SampleBundleInstallStaysUnderBudget) {
+    if (std::system("command -v tar gzip sha256sum dd >/dev/null 2>&1") != 0)
+        GTEST_SKIP() << "ota.sh needs tar, gzip, sha256sum and dd";
+
+    testutil::TemporaryDirectory tmp;
+    const std::string script = std::string(FLASH_SOURCE_DIR) + "/ota.sh";
+    const std::string build = "cd '" + tmp.Path() +
+                              "' && ROOTFS_SIZE_MB=64 KERNEL_SIZE_MB=16 BOOTLOADER_SIZE_MB=7 "
+                              "FLASH_TOOL=true bash '" + script + "' >/dev/null 2>&1";
+    ASSERT_EQ(std::system(build.c_str()), 0);
+
+    const std::uint64_t budget = kMinMemoryBudgetBytes;
+    const std::string budget_mb = std::to_string(budget / kMiB);
+    const pid_t pid = ::fork();
+    ASSERT_GE(pid, 0);
+    if (pid == 0) {
+        const int null_fd = ::open("/dev/null", O_WRONLY);
+        ::dup2(null_fd, STDOUT_FILENO);
+        ::dup2(null_fd, STDERR_FILENO);
+        if (::chdir(tmp.Path().c_str()) != 0)
+            ::_exit(127);
+        ::setenv("OTA_CONFIG_PATH", "ota_sample/ota.conf", 1);
+        if (::ptrace(PTRACE_TRACEME, 0, nullptr, nullptr) != 0)
+            ::_exit(126);
+        ::execl(FLASH_TOOL_BIN,
+                FLASH_TOOL_BIN,
+                "-i",
+                "ota_sample/ota.tar",
+                "--memory-budget",
+                budget_mb.c_str(),
+                static_cast<char*>(nullptr));
+        ::_exit(127);
+    }
+
+    int status = 0;
+    std::uint64_t peak = 0;
+    ASSERT_TRUE(TraceToExit(pid, status, peak));
+    ASSERT_TRUE(WIFEXITED(status));
+    if (WEXITSTATUS(status) == 126)
+        GTEST_SKIP() << "ptrace is not permitted";
+    ASSERT_EQ(WEXITSTATUS(status), 0);
+    EXPECT_TRUE(std::filesystem::exists(tmp.Path() + "/build/tmp/inactive-kernel-b"));
+    ASSERT_GT(peak, 0u);
+    EXPECT_LT(peak, budget) << "peak RSS " << (peak >> 10) << " KiB";
+}
+
+} // namespace
+} // namespace flash
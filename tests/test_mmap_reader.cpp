@@ -0,0 +1,56 @@
+#include "io/mmap_reader.hpp"
+#include "testing.hpp"
+
+#include <cstdint>
+#include <fstream>
+#include <gtest/gtest.h>
+#include <string>
+#include <vector>
+
+namespace flash {
+namespace {
+
+std::string WriteFile(const testutil::TemporaryDirectory& tmp, const std::string& content) {
+    const std::string path = tmp.Path() + "/in.bin";
+    std::ofstream os(path, std::ios::binary);
+    os << content;
+    return path;
+}
+
+TEST(MmapReaderTest, ReadsSkipsAndReportsSize) {
+    testutil::TemporaryDirectory tmp;
+    std::string content(100000, '\0');
+    for (size_t i = 0; i < content.size(); ++i)
+        content[i] = static_cast<char>(i * 7);
+    const std::string path = WriteFile(tmp, content);
+
+    MmapReader reader;
+    auto res = MmapReader::Open(path, reader);
+    ASSERT_TRUE(res.is_ok()) << res.msg;
+    EXPECT_EQ(reader.TotalSize(), content.size());
+
+    std::vector<std::uint8_t> buf(1000);
+    ASSERT_EQ(reader.Read(buf), 1000);
+    EXPECT_EQ(std::string(buf.begin(), buf.end()), content.substr(0, 1000));
+    std::span<const std::uint8_t> view;
+    ASSERT_EQ(reader.ReadView(view, buf), 1000);
+    EXPECT_NE(view.data(), buf.data());
+    EXPECT_EQ(std::string(view.begin(), view.end()), content.substr(1000, 1000));
+    EXPECT_EQ(reader.Skip(49000), 49000);
+    EXPECT_EQ(testutil::ReadAll(reader), content.substr(51000));
+    EXPECT_EQ(reader.Skip(10), 0);
+    EXPECT_EQ(reader.Read(buf), 0);
+}
+
+TEST(MmapReaderTest, HandlesEmptyFilesAndRejectsMissingOnes) {
+    testutil::TemporaryDirectory tmp;
+    MmapReader reader;
+    ASSERT_TRUE(MmapReader::Open(WriteFile(tmp, ""), reader).is_ok());
+    std::vector<std::uint8_t> buf(16);
+    EXPECT_EQ(reader.Read(buf), 0);
+
+    EXPECT_FALSE(MmapReader::Open(tmp.Path() + "/missing", reader).is_ok());
+}
+
+} // namespace
+} // namespace flash
@@ -1,9 +1,15 @@
 #include "ota/mount_session.hpp"
+#include "testing.hpp"
 
+#include <cerrno>
+#include <cstdint>
+#include <fcntl.h>
 #include <gtest/gtest.h>
 #include <memory>
 #include <string>
 #include <string_view>
+#include <sys/mount.h>
+#include <unistd.h>
 
 namespace flash {
 namespace {
@@ -13,12 +19,18 @@ class FakeSystemOps final : public MountSession::ISystemOps {
     Result create_result = Result::Ok();
     Result mount_result = Result::Ok();
     Result unmount_result = Result::Ok();
+    Result format_result = Result::Ok();
     std::string created_dir = "/tmp/fake-mount";
 
     mutable int create_calls = 0;
     mutable int mount_calls = 0;
     mutable int unmount_calls = 0;
     mutable int remove_calls = 0;
+    mutable int format_calls = 0;
+    mutable int mount_calls_at_format = -1;
+    mutable int sync_calls = 0;
+    mutable unsigned long last_mount_flags = 0;
+    mutable std::string last_mount_data;
 
     Result
     CreateMountPoint(std::string_view, std::string_view, std::string& out_dir) const override {
@@ -29,9 +41,14 @@ class FakeSystemOps final : public MountSession::ISystemOps {
         return Result::Ok();
     }
 
-    Result
-    Mount(std::string_view, std::string_view, std::string_view, unsigned long) const override {
+    Result Mount(std::string_view,
+                 std::string_view,
+                 std::string_view,
+                 unsigned long mount_flags,
+                 std::string_view mount_data) const override {
         ++mount_calls;
+        last_mount_flags = mount_flags;
+        last_mount_data = mount_data;
         return mount_result;
     }
 
@@ -40,14 +57,25 @@ class FakeSystemOps final : public MountSession::ISystemOps {
         return unmount_result;
     }
 
+    Result SyncFilesystem(std::string_view) const override {
+        ++sync_calls;
+        return Result::Ok();
+    }
+
     void RemoveDirectory(std::string_view) const override { ++remove_calls; }
+
+    Result Format(std::string_view, std::string_view) const override {
+        ++format_calls;
+        mount_calls_at_format = mount_calls;
+        return format_result;
+    }
 };
 
 TEST(MountSessionTest, MountAndUnmountSuccess) {
     auto ops = std::make_shared<FakeSystemOps>();
     MountSession session(ops);
 
-    auto res = MountSession::MountDevice("/dev/mock", "/mnt", "ota-", "ext4", 0UL, session);
+    auto res = MountSession::MountDevice("/dev/mock", "/mnt", "ota-", "ext4", 0UL, "", session);
     ASSERT_TRUE(res.is_ok()) << res.msg;
     EXPECT_EQ(session.Dir(), ops->created_dir);
     EXPECT_EQ(ops->create_calls, 1);
@@ -65,7 +93,7 @@ TEST(MountSessionTest, MountFailureCleansMountPoint) {
     ops->mount_result = Result::Fail(5, "mount failed");
     MountSession session(ops);
 
-    auto res = MountSession::MountDevice("/dev/mock", "/mnt", "ota-", "ext4", 0UL, session);
+    auto res = MountSession::MountDevice("/dev/mock", "/mnt", "ota-", "ext4", 0UL, "", session);
     ASSERT_FALSE(res.is_ok());
     EXPECT_EQ(res.msg, "mount failed");
     EXPECT_TRUE(session.Dir().empty());
@@ -79,7 +107,7 @@ TEST(MountSessionTest, UnmountFailureKeepsState) {
     auto ops = std::make_shared<FakeSystemOps>();
     MountSession session(ops);
     ASSERT_TRUE(
-        MountSession::MountDevice("/dev/mock", "/mnt", "ota-", "ext4", 0UL, session).is_ok());
+        MountSession::MountDevice("/dev/mock", "/mnt", "ota-", "ext4", 0UL, "", session).is_ok());
 
     ops->unmount_result = Result::Fail(16, "busy");
     auto unmount_res = session.Unmount();
@@ -95,7 +123,7 @@ TEST(MountSessionTest, CreateMountPointFailureIsPropagated) {
     ops->create_result = Result::Fail(2, "mkdtemp failed");
     MountSession session(ops);
 
-    auto res = MountSession::MountDevice("/dev/mock", "/mnt", "ota-", "ext4", 0UL, session);
+    auto res = MountSession::MountDevice("/dev/mock", "/mnt", "ota-", "ext4", 0UL, "", session);
     ASSERT_FALSE(res.is_ok());
     EXPECT_EQ(res.msg, "mkdtemp failed");
     EXPECT_TRUE(session.Dir().empty());
@@ -108,7 +136,7 @@ TEST(MountSessionTest, MoveTransfersActiveSession) {
     auto ops = std::make_shared<FakeSystemOps>();
     MountSession original(ops);
     ASSERT_TRUE(
-        MountSession::MountDevice("/dev/mock", "/mnt", "ota-", "ext4", 0UL, original).is_ok());
+        MountSession::MountDevice("/dev/mock", "/mnt", "ota-", "ext4", 0UL, "", original).is_ok());
 
     MountSession moved(std::move(original));
     EXPECT_EQ(moved.Dir(), ops->created_dir);
@@ -119,5 +147,86 @@ TEST(MountSessionTest, MoveTransfersActiveSession) {
     EXPECT_EQ(ops->remove_calls, 1);
 }
 
+TEST(MountSessionTest, FormatAndMountFormatsBeforeMounting) {
+    auto ops = std::make_shared<FakeSystemOps>();
+    MountSession session(ops);
+
+    auto res =
+        MountSession::FormatAndMountDevice("/dev/mock", "/mnt", "ota-", "ext4", 0UL, "", session);
+    ASSERT_TRUE(res.is_ok()) << res.msg;
+    EXPECT_EQ(ops->format_calls, 1);
+    EXPECT_EQ(ops->mount_calls_at_format, 0);
+    EXPECT_EQ(ops->mount_calls, 1);
+    EXPECT_EQ(session.Dir(), ops->created_dir);
+}
+
+TEST(MountSessionTest, FormatFailureSkipsMount) {
+    auto ops = std::make_shared<FakeSystemOps>();
+    ops->format_result = Result::Fail(1, "mkfs failed");
+    MountSession session(ops);
+
+    auto res =
+        MountSession::FormatAndMountDevice("/dev/mock", "/mnt", "ota-", "ext4", 0UL, "", session);
+    ASSERT_FALSE(res.is_ok());
+    EXPECT_EQ(res.msg, "mkfs failed");
+    EXPECT_TRUE(session.Dir().empty());
+    EXPECT_EQ(ops->create_calls, 0);
+    EXPECT_EQ(ops->mount_calls, 0);
+}
+
+TEST(MountSessionTest, PassesMountDataAndRemountsWithNormalOptions) {
+    auto ops = std::make_shared<FakeSystemOps>();
+    MountSession session(ops);
+
+    auto res = MountSession::MountDevice(
+        "/dev/mock", "/mnt", "ota-", "ext4", MS_NOATIME, "data=writeback,commit=60", session);
+    ASSERT_TRUE(res.is_ok()) << res.msg;
+    EXPECT_EQ(ops->last_mount_flags, static_cast<unsigned long>(MS_NOATIME));
+    EXPECT_EQ(ops->last_mount_data, "data=writeback,commit=60");
+
+    ASSERT_TRUE(session.Remount(MS_RELATIME, "barrier=1").is_ok());
+    EXPECT_EQ(ops->mount_calls, 2);
+    EXPECT_EQ(ops->last_mount_flags, static_cast<unsigned long>(MS_RELATIME | MS_REMOUNT));
+    EXPECT_EQ(ops->last_mount_data, "barrier=1");
+
+    ASSERT_TRUE(session.Sync().is_ok());
+    EXPECT_EQ(ops->sync_calls, 1);
+    ASSERT_TRUE(session.Unmount().is_ok());
+
+    EXPECT_FALSE(session.Remount(MS_RELATIME, "").is_ok());
+    EXPECT_FALSE(session.Sync().is_ok());
+}
+
+TEST(MountSessionTest, DefaultOpsFormatsLoopFileTarget) {
+    testutil::TemporaryDirectory tmp;
+    const std::string image = tmp.Path() + "/slot.img";
+
+    const int fd = ::open(image.c_str(), O_CREAT | O_WRONLY | O_TRUNC, 0644);
+    ASSERT_GE(fd, 0);
+    ASSERT_EQ(::ftruncate(fd, 16 * 1024 * 1024), 0);
+    ::close(fd);
+
+    auto res = MountSession::DefaultSystemOps()->Format(image, "ext4");
+    if (res.err == ENOENT) {
+        GTEST_SKIP() << "mkfs.ext4 not available: " << res.msg;
+    }
+    ASSERT_TRUE(res.is_ok()) << res.msg;
+
+    // ext4 superblock lives at byte 1024; s_magic is at offset 0x38 within it.
+    const int rfd = ::open(image.c_str(), O_RDONLY);
+    ASSERT_GE(rfd, 0);
+    std::uint8_t magic[2]{};
+    ASSERT_EQ(::pread(rfd, magic, sizeof(magic), 1024 + 0x38), 2);
+    ::close(rfd);
+    EXPECT_EQ(magic[0], 0x53);
+    EXPECT_EQ(magic[1], 0xEF);
+}
+
+TEST(MountSessionTest, DefaultOpsRejectsUnknownFsType) {
+    auto res = MountSession::DefaultSystemOps()->Format("/dev/null", "no-such-fs");
+    ASSERT_FALSE(res.is_ok());
+    EXPECT_NE(res.msg.find("format not supported"), std::string::npos);
+}
+
 } // namespace
 } // namespace flash
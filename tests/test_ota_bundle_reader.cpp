@@ -4,6 +4,7 @@
 #include <gtest/gtest.h>
 #include <memory>
 #include <string>
+#include <vector>
 
 namespace flash {
 namespace {
@@ -66,6 +67,49 @@ TEST(OtaTarBundleReaderTest, EnforcesEntryCompletionBeforeNext) {
     EXPECT_EQ(info.name, "two.txt");
 }
 
+TEST(OtaTarBundleReaderTest, EntryReaderLendsBlocksWithoutCopying) {
+    std::string payload(200 * 1024, '\0');
+    for (std::size_t i = 0; i < payload.size(); ++i)
+        payload[i] = static_cast<char>(i * 31 + 7);
+    auto tar = testutil::BuildTar({{"big.bin", payload, AE_IFREG}});
+
+    testutil::MemoryReader source(std::move(tar));
+    OtaTarBundleReader reader;
+    ASSERT_TRUE(reader.Open(source).is_ok());
+    BundleEntryInfo info{};
+    bool eof = false;
+    ASSERT_TRUE(reader.Next(info, eof).is_ok());
+
+    std::unique_ptr<IReader> entry_reader;
+    ASSERT_TRUE(reader.OpenCurrentEntryReader(entry_reader).is_ok());
+
+    // Views are capped at the scratch size and never point into it; Read() interleaves.
+    std::vector<std::uint8_t> scratch(1000);
+    std::string got;
+    bool use_view = true;
+    while (true) {
+        std::span<const std::uint8_t> view;
+        const ssize_t n = use_view ? entry_reader->ReadView(view, scratch)
+                                   : entry_reader->Read(scratch);
+        ASSERT_GE(n, 0);
+        if (n == 0)
+            break;
+        ASSERT_LE(static_cast<std::size_t>(n), scratch.size());
+        if (use_view) {
+            ASSERT_EQ(view.size(), static_cast<std::size_t>(n));
+            EXPECT_NE(view.data(), scratch.data());
+            got.append(reinterpret_cast<const char*>(view.data()), view.size());
+        } else {
+            got.append(reinterpret_cast<const char*>(scratch.data()), static_cast<size_t>(n));
+        }
+        use_view = !use_view;
+    }
+    EXPECT_TRUE(got == payload);
+
+    ASSERT_TRUE(reader.Next(info, eof).is_ok());
+    EXPECT_TRUE(eof);
+}
+
 TEST(OtaTarBundleReaderTest, HandlesMissingOpenAndMissingCurrentEntry) {
     OtaTarBundleReader reader;
     BundleEntryInfo info{};
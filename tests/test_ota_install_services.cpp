@@ -1,11 +1,25 @@
 #include "crypto/sha256.hpp"
+#include "io/file_reader.hpp"
+#include "ota/async_finalizer.hpp"
 #include "ota/ota_bundle_reader.hpp"
+#include "ota/component_installers.hpp"
 #include "ota/ota_install_services.hpp"
+#include "ota/staging_cache.hpp"
 #include "ota/update_module.hpp"
 #include "testing.hpp"
 
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <cstddef>
+#include <chrono>
+#include <filesystem>
 #include <gtest/gtest.h>
+#include <memory>
+#include <mutex>
 #include <string>
+#include <thread>
+#include <vector>
 
 namespace flash {
 namespace {
@@ -15,6 +29,130 @@ std::string HashOf(const std::string& s) {
         std::span<const std::uint8_t>(reinterpret_cast<const std::uint8_t*>(s.data()), s.size()));
 }
 
+std::unique_ptr<IReader> OpenFile(const std::string& path) {
+    auto reader = std::make_unique<FileOrStdinReader>();
+    EXPECT_TRUE(FileOrStdinReader::Open(path, *reader).ok);
+    return reader;
+}
+
+std::size_t CountFiles(const std::string& dir) {
+    std::error_code ec;
+    std::size_t n = 0;
+    for (auto it = std::filesystem::directory_iterator(dir, ec);
+         !ec && it != std::filesystem::directory_iterator();
+         it.increment(ec))
+        ++n;
+    return n;
+}
+
+// Records payloads in install order. Installing `wait_for` blocks until a second entry shows
+// up in the staging directory (or a timeout), recording whether it did.
+class RecordingStrategy final : public UpdateModule::IInstallerStrategy {
+  public:
+    RecordingStrategy(std::string staging_dir, std::string wait_for, std::string fail)
+        : staging_dir_(std::move(staging_dir)), wait_for_(std::move(wait_for)),
+          fail_(std::move(fail)) {}
+
+    bool Supports(const Component&) const override { return true; }
+
+    Result Install(const Component& comp,
+                   IReader& reader,
+                   const UpdateModule::Options&,
+                   const char*,
+                   const std::uint64_t*) const override {
+        if (comp.name == wait_for_) {
+            const auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+            while (CountFiles(staging_dir_) < 2 && std::chrono::steady_clock::now() < deadline)
+                std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            overlapped_ = CountFiles(staging_dir_) >= 2;
+        }
+        if (comp.name == fail_)
+            return Result::Fail(-1, "injected");
+        std::lock_guard<std::mutex> lock(mu_);
+        installed_.push_back(testutil::ReadAll(reader));
+        return Result::Ok();
+    }
+
+    std::vector<std::string> Installed() const {
+        std::lock_guard<std::mutex> lock(mu_);
+        return installed_;
+    }
+    bool Overlapped() const { return overlapped_; }
+
+  private:
+    std::string staging_dir_;
+    std::string wait_for_;
+    std::string fail_;
+    mutable std::mutex mu_;
+    mutable std::vector<std::string> installed_;
+    mutable std::atomic<bool> overlapped_{false};
+};
+
+struct PipelineRun {
+    Result result;
+    std::vector<std::string> installed;
+    bool overlapped = false;
+};
+
+PipelineRun RunPipeline(std::uint64_t budget, const std::string& fail) {
+    const std::vector<std::string> payloads = {"first", "second", "third"};
+    std::string components;
+    std::vector<testutil::TarEntry> entries;
+    for (std::size_t i = 0; i < payloads.size(); ++i) {
+        const std::string name = "c" + std::to_string(i);
+        if (!components.empty())
+            components += ",";
+        components += "{\"name\":\"" + name + "\",\"type\":\"test\",\"filename\":\"" +
+                      name + ".bin\",\"sha256\":\"" + HashOf(payloads[i]) + "\"}";
+        entries.push_back({name + ".bin", payloads[i], AE_IFREG});
+    }
+    entries.insert(entries.begin(),
+                   testutil::TarEntry{"manifest.json",
+                    "{\"version\":\"1.0.0\",\"hw_compatibility\":\"board-x\",\"components\":[" +
+                        components + "]}",
+                    AE_IFREG});
+
+    testutil::TemporaryDirectory tmp;
+    testutil::MemoryReader source(testutil::BuildTar(entries));
+    OtaTarBundleReader bundle;
+    EXPECT_TRUE(bundle.Open(source).is_ok());
+    Manifest manifest;
+    EXPECT_TRUE(ManifestLoader::LoadFromFirstBundleEntry(bundle, manifest).is_ok());
+
+    // c1 only finishes early if c2 is staged meanwhile.
+    auto strategy = std::make_unique<RecordingStrategy>(tmp.Path(), "c1", fail);
+    RecordingStrategy* recorder = strategy.get();
+    std::vector<std::unique_ptr<UpdateModule::IInstallerStrategy>> strategies;
+    strategies.push_back(std::move(strategy));
+    UpdateModule module(std::move(strategies));
+
+    const ComponentIndex index(manifest);
+    InstallCoordinator coordinator(module, nullptr);
+    StagingBackend::Options staging_opt;
+    staging_opt.dir = tmp.Path();
+    staging_opt.memory_threshold_bytes = 0;
+    staging_opt.min_free_bytes = 0;
+    coordinator.SetStagingOptions(staging_opt);
+    coordinator.SetPipelineBudget(budget);
+    PipelineRun run;
+    run.result = coordinator.InstallMatchingEntries(bundle, index, 0);
+    run.installed = recorder->Installed();
+    run.overlapped = recorder->Overlapped();
+    return run;
+}
+
+TEST(OtaInstallServicesTest, StagesNextComponentWhileCurrentOneInstalls) {
+    auto run = RunPipeline(1024 * 1024, "");
+    ASSERT_TRUE(run.result.is_ok()) << run.result.msg;
+    EXPECT_TRUE(run.overlapped);
+    EXPECT_EQ(run.installed, (std::vector<std::string>{"first", "second", "third"}));
+
+    run = RunPipeline(0, "c0");
+    ASSERT_FALSE(run.result.is_ok());
+    EXPECT_NE(run.result.msg.find("component 'c0' failed: injected"), std::string::npos);
+    EXPECT_TRUE(run.installed.empty());
+}
+
 TEST(OtaInstallServicesTest, FailsWhenManifestEntryIsMissingFromBundle) {
     testutil::TemporaryDirectory tmp;
     const std::string payload_a = "a-content";
@@ -52,5 +190,227 @@ TEST(OtaInstallServicesTest, FailsWhenManifestEntryIsMissingFromBundle) {
               std::string::npos);
 }
 
+TEST(OtaInstallServicesTest, RetryReusesCachedPayloads) {
+    testutil::TemporaryDirectory tmp;
+    const std::string payload_a = "a-content";
+    const std::string payload_b = "b-content";
+    const std::string file_a = tmp.Path() + "/a.txt";
+    const std::string file_b = tmp.Path() + "/later/b.txt";
+
+    const std::string manifest_json =
+        std::string("{\"version\":\"1.0.0\",\"hw_compatibility\":\"board-x\",\"components\":[") +
+        "{\"name\":\"a\",\"type\":\"file\",\"filename\":\"a.bin\",\"path\":\"" + file_a +
+        "\",\"sha256\":\"" + HashOf(payload_a) + "\"}," +
+        "{\"name\":\"b\",\"type\":\"file\",\"filename\":\"b.bin\",\"path\":\"" + file_b +
+        "\",\"sha256\":\"" + HashOf(payload_b) + "\"}" + "]}";
+
+    StagingCache::Options cache_opt;
+    cache_opt.dir = tmp.Path() + "/cache";
+
+    // The second run's a.bin is corrupt: it only succeeds if the cached copy is used.
+    auto run = [&](const std::string& bundle_a) {
+        testutil::MemoryReader source(testutil::BuildTar({
+            {"manifest.json", manifest_json, AE_IFREG},
+            {"a.bin", bundle_a, AE_IFREG},
+            {"b.bin", payload_b, AE_IFREG},
+        }));
+        OtaTarBundleReader bundle;
+        EXPECT_TRUE(bundle.Open(source).is_ok());
+        Manifest manifest;
+        EXPECT_TRUE(ManifestLoader::LoadFromFirstBundleEntry(bundle, manifest).is_ok());
+
+        StagingCache cache;
+        EXPECT_TRUE(StagingCache::Open(cache_opt, cache).is_ok());
+        const ComponentIndex index(manifest);
+        UpdateModule module;
+        InstallCoordinator coordinator(module, nullptr);
+        coordinator.SetStagingCache(&cache);
+        return coordinator.InstallMatchingEntries(bundle, index, 0);
+    };
+
+    auto first = run(payload_a);
+    ASSERT_FALSE(first.is_ok());
+    EXPECT_NE(first.msg.find("component 'b' failed"), std::string::npos);
+
+    std::filesystem::create_directories(tmp.Path() + "/later");
+    auto second = run("A-CONTENT");
+    ASSERT_TRUE(second.is_ok()) << second.msg;
+    EXPECT_EQ(testutil::ReadAll(*OpenFile(file_a)), payload_a);
+    EXPECT_EQ(testutil::ReadAll(*OpenFile(file_b)), payload_b);
+}
+
+TEST(OtaInstallServicesTest, PublishesFileComponentStagedInDestinationDirectory) {
+    testutil::TemporaryDirectory tmp;
+    const std::string payload = "key=value\n";
+    const std::string dir = tmp.Path() + "/etc";
+    const std::string file = dir + "/app.conf";
+    std::filesystem::create_directories(dir);
+
+    const std::string manifest_json =
+        std::string("{\"version\":\"1.0.0\",\"hw_compatibility\":\"board-x\",\"components\":[") +
+        "{\"name\":\"conf\",\"type\":\"file\",\"filename\":\"app.conf\",\"path\":\"" + file +
+        "\",\"permissions\":\"0640\",\"sha256\":\"" + HashOf(payload) + "\"}]}";
+
+    testutil::MemoryReader source(testutil::BuildTar({
+        {"manifest.json", manifest_json, AE_IFREG},
+        {"app.conf", payload, AE_IFREG},
+    }));
+    OtaTarBundleReader bundle;
+    ASSERT_TRUE(bundle.Open(source).is_ok());
+    Manifest manifest;
+    ASSERT_TRUE(ManifestLoader::LoadFromFirstBundleEntry(bundle, manifest).is_ok());
+
+    const ComponentIndex index(manifest);
+    UpdateModule module;
+    InstallCoordinator coordinator(module, nullptr);
+    auto res = coordinator.InstallMatchingEntries(bundle, index, 0);
+    ASSERT_TRUE(res.is_ok()) << res.msg;
+
+    EXPECT_EQ(testutil::ReadAll(*OpenFile(file)), payload);
+    EXPECT_EQ(std::filesystem::status(file).permissions(),
+              std::filesystem::perms::owner_read | std::filesystem::perms::owner_write |
+                  std::filesystem::perms::group_read);
+    // Nothing but the published file is left in the directory.
+    std::vector<std::string> names;
+    for (const auto& de : std::filesystem::directory_iterator(dir))
+        names.push_back(de.path().filename().string());
+    EXPECT_EQ(names, std::vector<std::string>{"app.conf"});
+}
+
+TEST(OtaInstallServicesTest, AcceptsUpperCaseDigestForBatchedFile) {
+    testutil::TemporaryDirectory tmp;
+    const std::string payload = "key=value\n";
+    const std::string file = tmp.Path() + "/app.conf";
+    std::string digest = HashOf(payload);
+    std::transform(digest.begin(), digest.end(), digest.begin(), [](unsigned char c) {
+        return static_cast<char>(std::toupper(c));
+    });
+
+    const std::string manifest_json =
+        std::string("{\"version\":\"1.0.0\",\"hw_compatibility\":\"board-x\",\"components\":[") +
+        "{\"name\":\"conf\",\"type\":\"file\",\"filename\":\"app.conf\",\"path\":\"" + file +
+        "\",\"sha256\":\"" + digest + "\"}]}";
+    testutil::MemoryReader source(testutil::BuildTar({
+        {"manifest.json", manifest_json, AE_IFREG},
+        {"app.conf", payload, AE_IFREG},
+    }));
+    OtaTarBundleReader bundle;
+    ASSERT_TRUE(bundle.Open(source).is_ok());
+    Manifest manifest;
+    ASSERT_TRUE(ManifestLoader::LoadFromFirstBundleEntry(bundle, manifest).is_ok());
+
+    const ComponentIndex index(manifest);
+    UpdateModule module;
+    InstallCoordinator coordinator(module, nullptr);
+    auto res = coordinator.InstallMatchingEntries(bundle, index, 0);
+    ASSERT_TRUE(res.is_ok()) << res.msg;
+    EXPECT_EQ(testutil::ReadAll(*OpenFile(file)), payload);
+}
+
+// Installs nothing and queues a commit whose sync fails, like a flush hitting an I/O error.
+class FailingSyncStrategy final : public UpdateModule::IInstallerStrategy {
+  public:
+    bool Supports(const Component& comp) const override { return comp.type == ComponentType::Raw; }
+
+    Result Install(const Component& comp,
+                   IReader& reader,
+                   const UpdateModule::Options& opt,
+                   const char*,
+                   const std::uint64_t*) const override {
+        testutil::ReadAll(reader);
+        opt.finalizer->SubmitCommit(
+            {comp.name + " fsync", [] { return Result::Fail(EIO, "injected fsync failure"); }});
+        return Result::Ok();
+    }
+};
+
+TEST(OtaInstallServicesTest, GroupCommitPublishesNothingWhenASyncFails) {
+    testutil::TemporaryDirectory tmp;
+    const std::string payload(300 * 1024, 'p');
+    const std::string dir = tmp.Path() + "/etc";
+    const std::string file = dir + "/app.bin";
+    std::filesystem::create_directories(dir);
+
+    const std::string manifest_json =
+        std::string("{\"version\":\"1.0.0\",\"hw_compatibility\":\"board-x\",\"components\":[") +
+        "{\"name\":\"app\",\"type\":\"file\",\"filename\":\"app.bin\",\"path\":\"" + file +
+        "\",\"sha256\":\"" + HashOf(payload) + "\"}," +
+        "{\"name\":\"boot\",\"type\":\"raw\",\"filename\":\"boot.img\",\"install_to\":\"" +
+        tmp.Path() + "/boot.img\",\"sha256\":\"" + HashOf("boot") + "\"}]}";
+    testutil::MemoryReader source(testutil::BuildTar({
+        {"manifest.json", manifest_json, AE_IFREG},
+        {"app.bin", payload, AE_IFREG},
+        {"boot.img", "boot", AE_IFREG},
+    }));
+    OtaTarBundleReader bundle;
+    ASSERT_TRUE(bundle.Open(source).is_ok());
+    Manifest manifest;
+    ASSERT_TRUE(ManifestLoader::LoadFromFirstBundleEntry(bundle, manifest).is_ok());
+
+    auto strategies = CreateDefaultInstallerStrategies();
+    strategies.insert(strategies.begin(), std::make_unique<FailingSyncStrategy>());
+    UpdateModule module(std::move(strategies));
+    const ComponentIndex index(manifest);
+    InstallCoordinator coordinator(module, nullptr);
+    StagingBackend::Options staging_opt;
+    staging_opt.memory_threshold_bytes = 0;
+    staging_opt.min_free_bytes = 0;
+    coordinator.SetStagingOptions(staging_opt);
+    coordinator.SetGroupCommit(true);
+    auto res = coordinator.InstallMatchingEntries(bundle, index, 0);
+    ASSERT_FALSE(res.is_ok());
+    EXPECT_NE(res.msg.find("injected fsync failure"), std::string::npos) << res.msg;
+
+    // The file was staged in etc/ for a rename that must not happen.
+    EXPECT_FALSE(std::filesystem::exists(file));
+    EXPECT_EQ(CountFiles(dir), 0u);
+}
+
+TEST(OtaInstallServicesTest, InstallsManySmallFileComponentsInBatches) {
+    testutil::TemporaryDirectory tmp;
+    std::string components;
+    std::vector<testutil::TarEntry> entries;
+    for (int i = 0; i < 40; ++i) {
+        const std::string dir = tmp.Path() + (i % 2 ? "/odd" : "/even");
+        std::filesystem::create_directories(dir);
+        const std::string name = "f" + std::to_string(i);
+        const std::string payload = "value=" + std::to_string(i) + "\n";
+        if (!components.empty())
+            components += ",";
+        components += "{\"name\":\"" + name + "\",\"type\":\"file\",\"filename\":\"" + name +
+                      "\",\"path\":\"" + dir + "/" + name + "\",\"permissions\":\"0600\"," +
+                      "\"sha256\":\"" + HashOf(payload) + "\"}";
+        entries.push_back({name, payload, AE_IFREG});
+    }
+    entries.insert(entries.begin(),
+                   testutil::TarEntry{"manifest.json",
+                                      "{\"version\":\"1.0.0\",\"hw_compatibility\":\"b\","
+                                      "\"components\":[" +
+                                          components + "]}",
+                                      AE_IFREG});
+
+    testutil::MemoryReader source(testutil::BuildTar(entries));
+    OtaTarBundleReader bundle;
+    ASSERT_TRUE(bundle.Open(source).is_ok());
+    Manifest manifest;
+    ASSERT_TRUE(ManifestLoader::LoadFromFirstBundleEntry(bundle, manifest).is_ok());
+
+    const ComponentIndex index(manifest);
+    UpdateModule module;
+    InstallCoordinator coordinator(module, nullptr);
+    auto res = coordinator.InstallMatchingEntries(bundle, index, 0);
+    ASSERT_TRUE(res.is_ok()) << res.msg;
+
+    for (int i = 0; i < 40; ++i) {
+        const std::string path = tmp.Path() + (i % 2 ? "/odd/f" : "/even/f") + std::to_string(i);
+        EXPECT_EQ(testutil::ReadAll(*OpenFile(path)), "value=" + std::to_string(i) + "\n");
+        EXPECT_EQ(std::filesystem::status(path).permissions(),
+                  std::filesystem::perms::owner_read | std::filesystem::perms::owner_write);
+    }
+    EXPECT_EQ(std::distance(std::filesystem::directory_iterator(tmp.Path() + "/odd"),
+                            std::filesystem::directory_iterator()),
+              20);
+}
+
 } // namespace
 } // namespace flash
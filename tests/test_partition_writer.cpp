@@ -57,4 +57,30 @@ TEST_F(PartitionWriterTests, WriteAll_WritesExactBytes) {
     EXPECT_EQ(read_back, data);
 }
 
+TEST_F(PartitionWriterTests, WriteV_WritesPiecesInOrder) {
+    const std::string out_path = MakePath("outv.bin");
+
+    flash::PartitionWriter w;
+    auto res = flash::PartitionWriter::Open(out_path, w);
+    ASSERT_TRUE(res.ok) << res.msg;
+
+    // More pieces than one writev() takes, including empty ones.
+    std::vector<std::vector<std::uint8_t>> bufs;
+    std::vector<std::uint8_t> expected;
+    for (size_t i = 0; i < 40; ++i) {
+        std::vector<std::uint8_t> b((i % 5) * 3001);
+        for (size_t j = 0; j < b.size(); ++j)
+            b[j] = static_cast<std::uint8_t>(i * 13 + j);
+        expected.insert(expected.end(), b.begin(), b.end());
+        bufs.push_back(std::move(b));
+    }
+    std::vector<std::span<const std::uint8_t>> pieces(bufs.begin(), bufs.end());
+
+    auto wr = w.WriteV(pieces);
+    ASSERT_TRUE(wr.ok) << wr.msg;
+    ASSERT_TRUE(w.FsyncNow().ok);
+
+    EXPECT_EQ(ReadFile(out_path), expected);
+}
+
 } // namespace
@@ -0,0 +1,59 @@
+#include "io/reader_pipeline.hpp"
+#include "testing.hpp"
+
+#include <gtest/gtest.h>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace flash {
+namespace {
+
+// echo -n "hello" | gzip -c | xxd -i
+const std::vector<std::uint8_t> kHelloGz = {0x1f, 0x8b, 0x08, 0x00, 0x00, 0x00, 0x00,
+                                            0x00, 0x00, 0x03, 0xcb, 0x48, 0xcd, 0xc9,
+                                            0xc9, 0x07, 0x00, 0x86, 0xa6, 0x10, 0x36,
+                                            0x05, 0x00, 0x00, 0x00};
+
+TEST(ReaderPipelineTest, FusedStagesCountDecodeHashAndReportProgress) {
+    using Counted = CountStage<SourceStage>;
+    std::vector<std::uint64_t> seen;
+    auto on_read = [&seen](std::uint64_t done) { seen.push_back(done); };
+    PipelineReader reader(HashStage(ProgressStage(
+        InflateStage(Counted(SourceStage(std::make_unique<testutil::MemoryReader>(kHelloGz)))),
+        on_read)));
+    const std::uint64_t* counter = reader.Stages().ConsumedCounter();
+
+    EXPECT_EQ(testutil::ReadAll(reader), "hello");
+    EXPECT_EQ(*counter, kHelloGz.size());
+    EXPECT_EQ(reader.Stages().Consumed(), kHelloGz.size());
+    ASSERT_FALSE(seen.empty());
+    EXPECT_EQ(seen.back(), kHelloGz.size());
+    EXPECT_FALSE(reader.TotalSize().has_value());
+    // sha256("hello")
+    EXPECT_EQ(reader.Stages().FinalHex(),
+              "2cf24dba5fb0a30e26e83b2ac5b9e29e1b161e5c1fa7425e73043362938b9824");
+}
+
+TEST(ReaderPipelineTest, PassesSizeAndSkipThroughCountingStages) {
+    using Counted = CountStage<SourceStage>;
+    std::uint64_t last = 0;
+    auto on_read = [&last](std::uint64_t done) { last = done; };
+    PipelineReader reader(ProgressStage(
+        Counted(SourceStage(std::make_unique<testutil::MemoryReader>(std::string("abcdef")))),
+        on_read));
+
+    EXPECT_EQ(reader.TotalSize(), 6u);
+    // MemoryReader cannot seek; the stage reports that instead of pretending.
+    EXPECT_EQ(reader.Skip(2), 0);
+    std::vector<std::uint8_t> scratch(4);
+    std::span<const std::uint8_t> view;
+    ASSERT_EQ(reader.ReadView(view, scratch), 4);
+    EXPECT_EQ(std::string(view.begin(), view.end()), "abcd");
+    EXPECT_EQ(last, 4u);
+    EXPECT_EQ(testutil::ReadAll(reader), "ef");
+    EXPECT_EQ(reader.Stages().Consumed(), 6u);
+}
+
+} // namespace
+} // namespace flash
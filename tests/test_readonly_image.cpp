@@ -0,0 +1,152 @@
+#include "io/partition_writer.hpp"
+#include "io/readback_verifying_writer.hpp"
+#include "ota/readonly_image.hpp"
+#include "ota/update_module.hpp"
+#include "testing.hpp"
+
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <gtest/gtest.h>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace flash {
+
+namespace {
+
+void StoreLe(std::vector<std::uint8_t>& buf, size_t off, std::uint64_t v, size_t width) {
+    for (size_t i = 0; i < width; ++i) {
+        buf[off + i] = static_cast<std::uint8_t>(v >> (8 * i));
+    }
+}
+
+std::vector<std::uint8_t> MakeSquashfsImage(size_t total, std::uint64_t bytes_used) {
+    std::vector<std::uint8_t> img(total, 0xA5);
+    StoreLe(img, 0, 0x73717368, 4);
+    StoreLe(img, 12, 128 * 1024, 4);
+    StoreLe(img, 22, 17, 2);
+    StoreLe(img, 28, 4, 2);
+    StoreLe(img, 40, bytes_used, 8);
+    return img;
+}
+
+std::vector<std::uint8_t> MakeErofsImage(size_t total, std::uint32_t blocks) {
+    std::vector<std::uint8_t> img(total, 0x5A);
+    StoreLe(img, 1024, 0xE0F5E1E2, 4);
+    img[1024 + 12] = 12;
+    StoreLe(img, 1024 + 36, blocks, 4);
+    return img;
+}
+
+std::vector<std::uint8_t> ReadFile(const std::string& path) {
+    std::ifstream ifs(path, std::ios::binary);
+    return {std::istreambuf_iterator<char>(ifs), std::istreambuf_iterator<char>()};
+}
+
+// Writes through to a real file but flips one byte, as a misbehaving device would.
+class CorruptingWriter final : public IWriter {
+  public:
+    explicit CorruptingWriter(PartitionWriter& inner) : inner_(inner) {}
+
+    Result WriteAll(std::span<const std::uint8_t> in) override {
+        std::vector<std::uint8_t> copy(in.begin(), in.end());
+        if (!copy.empty())
+            copy[0] ^= 0xFF;
+        return inner_.WriteAll(copy);
+    }
+    Result FsyncNow() override { return inner_.FsyncNow(); }
+
+  private:
+    PartitionWriter& inner_;
+};
+
+} // namespace
+
+class ReadOnlyImageTest : public ::testing::Test {
+  protected:
+    testutil::TemporaryDirectory temp_dir;
+
+    Component MakeComponent(const std::string& type) {
+        Component comp;
+        comp.name = "rootfs";
+        comp.type = ComponentTypeFromName(type);
+        comp.filename = "rootfs." + type;
+        comp.install_to = temp_dir.Path() + "/part";
+        return comp;
+    }
+};
+
+TEST_F(ReadOnlyImageTest, ParsesSquashfsAndErofsSuperblocks) {
+    ReadOnlyImageInfo info;
+    auto sq = MakeSquashfsImage(8192, 6000);
+    ASSERT_TRUE(ParseReadOnlyImageHeader(ReadOnlyImageType::Squashfs, sq, info).is_ok());
+    EXPECT_EQ(info.fs_bytes, 6000u);
+
+    auto ero = MakeErofsImage(8192, 2);
+    ASSERT_TRUE(ParseReadOnlyImageHeader(ReadOnlyImageType::Erofs, ero, info).is_ok());
+    EXPECT_EQ(info.fs_bytes, 8192u);
+
+    EXPECT_FALSE(ParseReadOnlyImageHeader(ReadOnlyImageType::Erofs, sq, info).is_ok());
+    EXPECT_FALSE(ReadOnlyImageTypeFromName("ext4").has_value());
+}
+
+TEST_F(ReadOnlyImageTest, InstallsSquashfsImageWithReadback) {
+    UpdateModule module;
+    Component comp = MakeComponent("squashfs");
+    comp.verify_readback = true;
+    auto img = MakeSquashfsImage(3 * 1024 * 1024 + 17, 3 * 1024 * 1024);
+
+    UpdateModule::Options opt;
+    opt.fsync_interval_bytes = 1024 * 1024;
+    auto res = module.Execute(comp, std::make_unique<testutil::MemoryReader>(img), opt);
+    ASSERT_TRUE(res.is_ok()) << res.msg;
+    EXPECT_EQ(ReadFile(comp.install_to), img);
+}
+
+TEST_F(ReadOnlyImageTest, BadMagicNeverTouchesTarget) {
+    UpdateModule module;
+    Component comp = MakeComponent("erofs");
+    auto img = MakeErofsImage(16384, 4);
+    img[1024] = 0;
+
+    auto res = module.Execute(comp, std::make_unique<testutil::MemoryReader>(img));
+    ASSERT_FALSE(res.is_ok());
+    EXPECT_NE(res.msg.find("bad superblock magic"), std::string::npos) << res.msg;
+    EXPECT_TRUE(ReadFile(comp.install_to).empty());
+}
+
+TEST_F(ReadOnlyImageTest, TruncatedImageFails) {
+    UpdateModule module;
+    Component comp = MakeComponent("erofs");
+    auto img = MakeErofsImage(16384, 8); // superblock claims 32 KiB
+
+    auto res = module.Execute(comp, std::make_unique<testutil::MemoryReader>(img));
+    ASSERT_FALSE(res.is_ok());
+    EXPECT_NE(res.msg.find("truncated"), std::string::npos) << res.msg;
+
+    auto tiny = std::vector<std::uint8_t>(img.begin(), img.begin() + 2048);
+    res = module.Execute(comp, std::make_unique<testutil::MemoryReader>(tiny));
+    ASSERT_FALSE(res.is_ok());
+    EXPECT_NE(res.msg.find("too small"), std::string::npos) << res.msg;
+}
+
+TEST_F(ReadOnlyImageTest, ReadbackDetectsCorruptedWrite) {
+    const std::string path = temp_dir.Path() + "/part";
+    PartitionWriter part;
+    ASSERT_TRUE(PartitionWriter::Open(path, part).is_ok());
+    CorruptingWriter corrupting(part);
+
+    ReadbackVerifyingWriter verifier(corrupting);
+    ASSERT_TRUE(verifier.Start(path).is_ok());
+
+    std::vector<std::uint8_t> data(64 * 1024, 0x11);
+    ASSERT_TRUE(verifier.WriteAll(data).is_ok());
+    auto res = verifier.Finish();
+    ASSERT_FALSE(res.is_ok());
+    EXPECT_NE(res.msg.find("readback mismatch"), std::string::npos) << res.msg;
+    EXPECT_EQ(verifier.VerifiedBytes(), 0u);
+}
+
+} // namespace flash
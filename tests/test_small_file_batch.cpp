@@ -0,0 +1,70 @@
+#include "ota/small_file_batch.hpp"
+#include "testing.hpp"
+
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <gtest/gtest.h>
+#include <iterator>
+#include <string>
+#include <sys/stat.h>
+#include <vector>
+
+namespace flash {
+namespace {
+
+namespace fs = std::filesystem;
+
+std::vector<std::uint8_t> Bytes(const std::string& s) { return {s.begin(), s.end()}; }
+
+std::string ReadFile(const std::string& path) {
+    std::ifstream is(path, std::ios::binary);
+    return std::string((std::istreambuf_iterator<char>(is)), std::istreambuf_iterator<char>());
+}
+
+mode_t ModeOf(const std::string& path) {
+    struct stat st {};
+    return ::stat(path.c_str(), &st) == 0 ? (st.st_mode & 07777) : 0;
+}
+
+TEST(SmallFileBatchTest, StagesThenPublishesPerDirectory) {
+    testutil::TemporaryDirectory tmp;
+    const std::string etc = tmp.Path() + "/etc";
+    const std::string certs = tmp.Path() + "/certs";
+    fs::create_directories(etc);
+    fs::create_directories(certs);
+
+    SmallFileBatch batch;
+    batch.Add(etc + "/a.conf", Bytes("stale"), 0644);
+    batch.Add(certs + "/ca.pem", Bytes("cert"), 0600);
+    batch.Add(etc + "/b.conf", Bytes("b=2"), 0640);
+    batch.Add(etc + "/a.conf", Bytes("a=1"), 0644);
+    EXPECT_EQ(batch.Files(), 3u);
+    EXPECT_EQ(batch.Bytes(), 10u);
+
+    ASSERT_TRUE(batch.Stage().is_ok());
+    EXPECT_FALSE(fs::exists(etc + "/a.conf"));
+    EXPECT_EQ(ReadFile(etc + "/a.conf.tmp"), "a=1");
+
+    ASSERT_TRUE(batch.Publish().is_ok());
+    EXPECT_EQ(ReadFile(etc + "/a.conf"), "a=1");
+    EXPECT_EQ(ReadFile(etc + "/b.conf"), "b=2");
+    EXPECT_EQ(ReadFile(certs + "/ca.pem"), "cert");
+    EXPECT_EQ(ModeOf(etc + "/b.conf"), 0640u);
+    EXPECT_EQ(ModeOf(certs + "/ca.pem"), 0600u);
+    EXPECT_FALSE(fs::exists(etc + "/a.conf.tmp"));
+}
+
+TEST(SmallFileBatchTest, DropsTemporariesThatWereNeverPublished) {
+    testutil::TemporaryDirectory tmp;
+    {
+        SmallFileBatch batch;
+        batch.Add(tmp.Path() + "/x.bin", Bytes("x"), 0644);
+        ASSERT_TRUE(batch.Stage().is_ok());
+        EXPECT_TRUE(fs::exists(tmp.Path() + "/x.bin.tmp"));
+    }
+    EXPECT_TRUE(fs::is_empty(tmp.Path()));
+}
+
+} // namespace
+} // namespace flash
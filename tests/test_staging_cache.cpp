@@ -0,0 +1,96 @@
+#include "crypto/sha256.hpp"
+#include "ota/staging_cache.hpp"
+#include "ota/staging_verifier.hpp"
+#include "testing.hpp"
+
+#include <filesystem>
+#include <fstream>
+#include <gtest/gtest.h>
+#include <memory>
+#include <string>
+
+namespace flash {
+namespace {
+
+std::string Sha256Of(const std::string& s) {
+    return Sha256Hex(std::span<const std::uint8_t>(
+        reinterpret_cast<const std::uint8_t*>(s.data()), s.size()));
+}
+
+// Stages payload through the cache directory like InstallCoordinator does.
+void StageInto(StagingCache& cache, const std::string& payload) {
+    OtaEntryStager stager(cache.Dir());
+    StagedEntry staged;
+    std::unique_ptr<IReader> source = std::make_unique<testutil::MemoryReader>(payload);
+    ASSERT_TRUE(stager.StageAndVerify(source, Sha256Of(payload), staged).is_ok());
+    ASSERT_TRUE(cache.Insert(Sha256Of(payload), staged.temp.Path()).is_ok());
+}
+
+TEST(StagingCacheTest, ReusesVerifiedPayloadsAcrossInstances) {
+    testutil::TemporaryDirectory tmp;
+    StagingCache::Options opt;
+    opt.dir = tmp.Path() + "/cache";
+
+    StagingCache cache;
+    ASSERT_TRUE(StagingCache::Open(opt, cache).is_ok());
+    std::unique_ptr<IReader> reader;
+    EXPECT_FALSE(cache.Lookup(Sha256Of("kernel"), reader));
+    StageInto(cache, "kernel");
+    EXPECT_EQ(cache.Size(), 1u);
+
+    // Only the published entry is left once the staged temp file is gone.
+    size_t files = 0;
+    for ([[maybe_unused]] const auto& de : std::filesystem::directory_iterator(opt.dir))
+        ++files;
+    EXPECT_EQ(files, 1u);
+
+    StagingCache reopened;
+    ASSERT_TRUE(StagingCache::Open(opt, reopened).is_ok());
+    ASSERT_TRUE(reopened.Lookup(Sha256Of("kernel"), reader));
+    EXPECT_EQ(testutil::ReadAll(*reader), "kernel");
+}
+
+TEST(StagingCacheTest, EvictsLeastRecentlyUsedWithinBudget) {
+    testutil::TemporaryDirectory tmp;
+    StagingCache::Options opt;
+    opt.dir = tmp.Path() + "/cache";
+    opt.max_bytes = 10;
+
+    StagingCache cache;
+    ASSERT_TRUE(StagingCache::Open(opt, cache).is_ok());
+    StageInto(cache, "aaaa");
+    StageInto(cache, "bbbb");
+    std::unique_ptr<IReader> reader;
+    ASSERT_TRUE(cache.Lookup(Sha256Of("aaaa"), reader));
+
+    StageInto(cache, "cccc");
+    EXPECT_LE(cache.Bytes(), opt.max_bytes);
+    EXPECT_TRUE(cache.Lookup(Sha256Of("aaaa"), reader));
+    EXPECT_FALSE(cache.Lookup(Sha256Of("bbbb"), reader));
+    EXPECT_TRUE(cache.Lookup(Sha256Of("cccc"), reader));
+
+    // Too large for the budget: not cached, nothing evicted.
+    StageInto(cache, std::string(11, 'x'));
+    EXPECT_FALSE(cache.Lookup(Sha256Of(std::string(11, 'x')), reader));
+    EXPECT_EQ(cache.Size(), 2u);
+}
+
+TEST(StagingCacheTest, DropsEntryWhoseContentNoLongerMatches) {
+    testutil::TemporaryDirectory tmp;
+    StagingCache::Options opt;
+    opt.dir = tmp.Path() + "/cache";
+
+    StagingCache cache;
+    ASSERT_TRUE(StagingCache::Open(opt, cache).is_ok());
+    StageInto(cache, "kernel");
+    // Same size, different bytes, as a power cut during writeback can leave it.
+    std::ofstream(opt.dir + "/" + Sha256Of("kernel"), std::ios::trunc) << "kernek";
+
+    std::unique_ptr<IReader> reader;
+    EXPECT_FALSE(cache.Lookup(Sha256Of("kernel"), reader));
+    EXPECT_EQ(cache.Size(), 0u);
+    EXPECT_FALSE(std::filesystem::exists(opt.dir + "/" + Sha256Of("kernel")));
+}
+
+} // namespace
+} // namespace flash
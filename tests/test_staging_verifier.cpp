@@ -68,5 +68,42 @@ TEST(StagingVerifierTest, StageAndVerifyRejectsEmptyExpectedHash) {
     EXPECT_NE(res.msg.find("expected sha256 is empty"), std::string::npos);
 }
 
+TEST(StagingVerifierTest, ChoosesTierBySizeAndFreeSpace) {
+    testutil::TemporaryDirectory tmp;
+    StagingBackend::Options opt;
+    opt.dir = tmp.Path();
+    opt.memory_threshold_bytes = 1024;
+    opt.min_free_bytes = 0;
+    const StagingBackend backend(opt);
+
+    StagingPlacement placement;
+    ASSERT_TRUE(backend.Choose(10, "", placement).is_ok());
+    EXPECT_EQ(placement.tier, StagingPlacement::Tier::kMemory);
+    ASSERT_TRUE(backend.Choose(4096, "", placement).is_ok());
+    EXPECT_EQ(placement.tier, StagingPlacement::Tier::kDirectory);
+    EXPECT_EQ(placement.dir, tmp.Path());
+    ASSERT_TRUE(backend.Choose(10, tmp.Path(), placement).is_ok());
+    EXPECT_EQ(placement.tier, StagingPlacement::Tier::kDestination);
+
+    // More than the filesystem can hold: only the memory tier would fit, and it is too small.
+    const std::uint64_t huge = StagingBackend::FreeBytes(tmp.Path()) + 1;
+    EXPECT_FALSE(backend.Choose(huge, tmp.Path(), placement).is_ok());
+}
+
+TEST(StagingVerifierTest, StagesInMemoryAndCannotPublishIt) {
+    const std::string payload = "small-config";
+    const std::string expected = Sha256Hex(std::span<const std::uint8_t>(
+        reinterpret_cast<const std::uint8_t*>(payload.data()), payload.size()));
+
+    OtaEntryStager stager(StagingPlacement{StagingPlacement::Tier::kMemory, {}});
+    StagedEntry staged;
+    std::unique_ptr<IReader> source = std::make_unique<testutil::MemoryReader>(payload);
+    const auto res = stager.StageAndVerify(source, expected, staged);
+    ASSERT_TRUE(res.is_ok()) << res.msg;
+    EXPECT_EQ(staged.reader->TotalSize(), payload.size());
+    EXPECT_EQ(testutil::ReadAll(*staged.reader), payload);
+    EXPECT_FALSE(staged.temp.Publish("/tmp/never-published", 0644).is_ok());
+}
+
 } // namespace
 } // namespace flash
@@ -6,6 +6,8 @@
 #include <fstream>
 #include <gtest/gtest.h>
 #include <string>
+#include <utility>
+#include <vector>
 
 namespace flash {
 namespace {
@@ -129,5 +131,220 @@ TEST_F(TarStreamExtractorTest, ReportsProgressToSink) {
     EXPECT_EQ(last.overall_total, 200U);
 }
 
+TEST_F(TarStreamExtractorTest, StreamsLargeFilesAndKeepsMetadata) {
+    namespace fs = std::filesystem;
+    testutil::TemporaryDirectory temp;
+    const fs::path dst = fs::path(temp.Path()) / "extract";
+    fs::create_directories(dst);
+
+    std::string big(600 * 1024, '\0');
+    for (size_t i = 0; i < big.size(); ++i) {
+        big[i] = static_cast<char>('a' + (i * 7) % 26);
+    }
+    auto tar = testutil::BuildTar({
+        {"small.txt", "tiny", AE_IFREG},
+        {"data/large.bin", big, AE_IFREG},
+    });
+
+    testutil::MemoryReader reader(std::move(tar));
+    TarStreamExtractor::Options opt;
+    opt.large_file_threshold_bytes = 64 * 1024;
+    TarStreamExtractor extractor(opt);
+
+    auto res = extractor.ExtractToDir(reader, dst.string(), "archive");
+    ASSERT_TRUE(res.is_ok()) << res.msg;
+    EXPECT_EQ(ReadFile(dst / "small.txt"), "tiny");
+    EXPECT_EQ(ReadFile(dst / "data" / "large.bin"), big);
+    EXPECT_EQ(fs::file_size(dst / "data" / "large.bin"), big.size());
+    EXPECT_EQ(fs::status(dst / "data" / "large.bin").permissions(),
+              fs::perms::owner_read | fs::perms::owner_write | fs::perms::group_read |
+                  fs::perms::others_read);
+}
+
+TEST_F(TarStreamExtractorTest, LeavesHolesForZeroRuns) {
+    namespace fs = std::filesystem;
+    testutil::TemporaryDirectory temp;
+    const fs::path dst = fs::path(temp.Path()) / "extract";
+    fs::create_directories(dst);
+
+    std::string blob(384 * 1024, '\0');
+    blob.replace(128 * 1024, 5, "hello");
+    auto tar = testutil::BuildTar({
+        {"regular.img", blob, AE_IFREG},
+        {"streamed.img", blob, AE_IFREG},
+    });
+
+    // The second copy takes the large-file path.
+    testutil::MemoryReader reader(std::move(tar));
+    TarStreamExtractor::Options opt;
+    opt.large_file_threshold_bytes = 256 * 1024;
+    TarStreamExtractor extractor(opt);
+
+    auto res = extractor.ExtractToDir(reader, dst.string(), "archive");
+    ASSERT_TRUE(res.is_ok()) << res.msg;
+    for (const char* name : {"regular.img", "streamed.img"}) {
+        EXPECT_EQ(ReadFile(dst / name), blob) << name;
+        struct stat st {};
+        ASSERT_EQ(::stat((dst / name).c_str(), &st), 0);
+        EXPECT_EQ(static_cast<size_t>(st.st_size), blob.size());
+        EXPECT_LT(static_cast<size_t>(st.st_blocks) * 512, blob.size() / 4) << name;
+    }
+}
+
+TEST_F(TarStreamExtractorTest, CollectsStatsAndSlowestEntries) {
+    namespace fs = std::filesystem;
+    testutil::TemporaryDirectory temp;
+    const fs::path dst = fs::path(temp.Path()) / "extract";
+    fs::create_directories(dst);
+
+    auto tar = testutil::BuildTar({
+        {"etc", "", AE_IFDIR},
+        {"etc/a.conf", "alpha", AE_IFREG},
+        {"etc/b.conf", "beta", AE_IFREG},
+        {"zeros.bin", std::string(8192, '\0'), AE_IFREG},
+    });
+
+    testutil::MemoryReader reader(std::move(tar));
+    ExtractStats stats;
+    TarStreamExtractor::Options opt;
+    opt.stats_out = &stats;
+    opt.slow_entry_count = 2;
+    TarStreamExtractor extractor(opt);
+
+    auto res = extractor.ExtractToDir(reader, dst.string(), "archive");
+    ASSERT_TRUE(res.is_ok()) << res.msg;
+    EXPECT_EQ(stats.Entries(), 4u);
+    EXPECT_EQ(stats.dirs, 1u);
+    EXPECT_EQ(stats.files, 3u);
+    EXPECT_EQ(stats.bytes, 5u + 4u + 8192u);
+    EXPECT_EQ(stats.sparse_bytes, 8192u);
+    ASSERT_EQ(stats.slowest.size(), 2u);
+    EXPECT_GE(stats.slowest[0].ns, stats.slowest[1].ns);
+    EXPECT_GE(stats.total_ns, stats.slowest[0].ns);
+    EXPECT_NE(stats.Summary().find("entries=4 files=3 dirs=1"), std::string::npos);
+}
+
+TEST_F(TarStreamExtractorTest, ResumesFromEntryCheckpoint) {
+    namespace fs = std::filesystem;
+    testutil::TemporaryDirectory temp;
+    const fs::path dst = fs::path(temp.Path()) / "extract";
+    fs::create_directories(dst);
+
+    const std::vector<testutil::TarEntry> entries = {
+        {"etc", "", AE_IFDIR, {}, 0755, 1600000000},
+        {"etc/a.conf", "alpha", AE_IFREG, {}, 0644, 1600000000},
+        {"etc/b.conf", "bravo", AE_IFREG, {}, 0644, 1600000000},
+        {"etc/link", "", AE_IFLNK, "a.conf", 0777, 1600000000},
+        {"etc/c.conf", "charlie", AE_IFREG, {}, 0644, 1600000000},
+        {"etc/d.conf", "delta", AE_IFREG, {}, 0644, 1600000000},
+    };
+
+    std::vector<std::pair<std::uint64_t, std::uint64_t>> checkpoints;
+    TarStreamExtractor::Options opt;
+    opt.checkpoint_interval_bytes = 1;
+    opt.on_checkpoint = [&](std::uint64_t bytes, std::uint64_t entries_done) {
+        checkpoints.emplace_back(bytes, entries_done);
+        return Result::Ok();
+    };
+    {
+        testutil::MemoryReader reader(testutil::BuildTar(entries));
+        auto res = TarStreamExtractor(opt).ExtractToDir(reader, dst.string(), "archive");
+        ASSERT_TRUE(res.is_ok()) << res.msg;
+    }
+    ASSERT_FALSE(checkpoints.empty());
+    EXPECT_EQ(checkpoints.back().first, 5u + 5u + 7u + 5u);
+    EXPECT_EQ(checkpoints.back().second, entries.size());
+
+    // Pretend the run died after the fourth entry: a.conf was altered without changing its
+    // size or mtime (so it must be left alone), b.conf lost its data (so it is extracted
+    // again), and c.conf was never written.
+    const auto mtime = fs::last_write_time(dst / "etc/a.conf");
+    {
+        std::ofstream os(dst / "etc/a.conf", std::ios::trunc);
+        os << "ALPHA";
+    }
+    fs::last_write_time(dst / "etc/a.conf", mtime);
+    fs::resize_file(dst / "etc/b.conf", 0);
+    fs::remove(dst / "etc/c.conf");
+
+    ExtractStats stats;
+    checkpoints.clear();
+    opt.resume_entries = 4;
+    opt.unlink_existing = false;
+    opt.stats_out = &stats;
+    testutil::MemoryReader reader(testutil::BuildTar(entries));
+    auto res = TarStreamExtractor(opt).ExtractToDir(reader, dst.string(), "archive");
+    ASSERT_TRUE(res.is_ok()) << res.msg;
+
+    EXPECT_EQ(stats.resumed, 3u);
+    EXPECT_EQ(stats.files, 3u);
+    EXPECT_EQ(ReadFile(dst / "etc/a.conf"), "ALPHA");
+    EXPECT_EQ(ReadFile(dst / "etc/b.conf"), "bravo");
+    EXPECT_EQ(ReadFile(dst / "etc/c.conf"), "charlie");
+    EXPECT_EQ(ReadFile(dst / "etc/d.conf"), "delta");
+    EXPECT_EQ(fs::read_symlink(dst / "etc/link"), "a.conf");
+    ASSERT_FALSE(checkpoints.empty());
+    EXPECT_EQ(checkpoints.back().second, entries.size());
+}
+
+class SmallFileBatchingTest : public TarStreamExtractorTest,
+                              public ::testing::WithParamInterface<bool> {};
+
+TEST_P(SmallFileBatchingTest, PreservesOrderModesAndTimes) {
+    namespace fs = std::filesystem;
+    testutil::TemporaryDirectory temp;
+    const fs::path dst = fs::path(temp.Path()) / "extract";
+    fs::create_directories(dst / "d" / "clash");
+
+    auto tar = testutil::BuildTar({
+        {"d", "", AE_IFDIR, "", 0755},
+        {"d/clash", "replaces an empty directory", AE_IFREG},
+        {"d/a.txt", "one", AE_IFREG, "", 0600},
+        {"d/a.txt", "two", AE_IFREG, "", 0640, 1000000},
+        {"d/link", "", AE_IFREG, "d/a.txt"},
+        {"d/open", "rwx", AE_IFREG, "", 0777},
+        {"d/empty", "", AE_IFREG},
+        {"s", "", AE_IFLNK, "d"},
+        {"new/deeper/x.txt", "no dir entries", AE_IFREG},
+    });
+
+    testutil::MemoryReader reader(std::move(tar));
+    ExtractStats stats;
+    TarStreamExtractor::Options opt;
+    opt.batch_small_files = GetParam();
+    opt.stats_out = &stats;
+    TarStreamExtractor extractor(opt);
+
+    auto res = extractor.ExtractToDir(reader, dst.string(), "archive");
+    ASSERT_TRUE(res.is_ok()) << res.msg;
+
+    EXPECT_EQ(ReadFile(dst / "d" / "a.txt"), "two");
+    EXPECT_EQ(ReadFile(dst / "d" / "clash"), "replaces an empty directory");
+    EXPECT_EQ(ReadFile(dst / "d" / "open"), "rwx");
+    EXPECT_EQ(ReadFile(dst / "new" / "deeper" / "x.txt"), "no dir entries");
+    EXPECT_TRUE(fs::exists(dst / "d" / "empty"));
+    EXPECT_TRUE(fs::is_symlink(dst / "s"));
+
+    struct stat a {};
+    struct stat link {};
+    struct stat open {};
+    ASSERT_EQ(::stat((dst / "d" / "a.txt").c_str(), &a), 0);
+    ASSERT_EQ(::stat((dst / "d" / "link").c_str(), &link), 0);
+    ASSERT_EQ(::stat((dst / "d" / "open").c_str(), &open), 0);
+    EXPECT_EQ(a.st_mode & 07777, 0640u);
+    EXPECT_EQ(a.st_mtime, 1000000);
+    EXPECT_EQ(a.st_ino, link.st_ino);
+    EXPECT_EQ(open.st_mode & 07777, 0777u);
+    EXPECT_EQ(stats.files + stats.hardlinks, 7u);
+    if (GetParam() && stats.batched_files > 0) {
+        EXPECT_EQ(stats.batch_fallbacks, 1u); // d/clash goes through libarchive
+    }
+    if (!GetParam()) {
+        EXPECT_EQ(stats.batched_files, 0u);
+    }
+}
+
+INSTANTIATE_TEST_SUITE_P(BatchOnOff, SmallFileBatchingTest, ::testing::Bool());
+
 } // namespace
 } // namespace flash
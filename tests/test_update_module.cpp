@@ -25,7 +25,7 @@ TEST_F(UpdateModuleTest, ExecuteAtomicFile) {
 
     Component comp;
     comp.name = "test_config";
-    comp.type = "file";
+    comp.type = ComponentType::File;
     comp.path = target_path;
     comp.permissions = "0600";
 
@@ -54,7 +54,7 @@ TEST_F(UpdateModuleTest, ExecuteGzippedRaw) {
 
     Component comp;
     comp.name = "kernel";
-    comp.type = "raw";
+    comp.type = ComponentType::Raw;
     comp.filename = "image.gz";
     comp.install_to = partition_path;
 
@@ -77,7 +77,7 @@ TEST_F(UpdateModuleTest, ExecuteGzippedRaw) {
 TEST_F(UpdateModuleTest, ExecuteAtomicFile_MissingDirectoryWithoutCreateDestination_Fails) {
     Component comp;
     comp.name = "cfg";
-    comp.type = "file";
+    comp.type = ComponentType::File;
     comp.path = GetTestPath("missing/dir/config.txt");
     comp.create_destination = false;
 
@@ -90,7 +90,7 @@ TEST_F(UpdateModuleTest, ExecuteAtomicFile_MissingDirectoryWithoutCreateDestinat
 TEST_F(UpdateModuleTest, ExecuteAtomicFile_CreateDestination_Succeeds) {
     Component comp;
     comp.name = "cfg";
-    comp.type = "file";
+    comp.type = ComponentType::File;
     comp.path = GetTestPath("new/dir/config.txt");
     comp.create_destination = true;
     comp.permissions = "0640";
@@ -116,7 +116,7 @@ TEST_F(UpdateModuleTest, ExecuteValidationFailures) {
     {
         Component comp;
         comp.name = "cfg";
-        comp.type = "file";
+        comp.type = ComponentType::File;
         comp.path = GetTestPath("config-invalid-perm.txt");
         comp.permissions = "invalid";
         cases.push_back({std::move(comp), "content", "Invalid permissions value", false});
@@ -124,19 +124,19 @@ TEST_F(UpdateModuleTest, ExecuteValidationFailures) {
     {
         Component comp;
         comp.name = "x";
-        comp.type = "unknown";
+        comp.type = ComponentType::Unknown;
         cases.push_back({std::move(comp), "content", "Unsupported component type", false});
     }
     {
         Component comp;
         comp.name = "kernel";
-        comp.type = "raw";
+        comp.type = ComponentType::Raw;
         cases.push_back({std::move(comp), "payload", "install_to empty", false});
     }
     {
         Component comp;
         comp.name = "cfg";
-        comp.type = "file";
+        comp.type = ComponentType::File;
         comp.path = GetTestPath("config-null-reader.txt");
         cases.push_back({std::move(comp), "", "Null source reader", true});
     }
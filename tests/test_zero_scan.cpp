@@ -0,0 +1,50 @@
+#include "io/zero_scan.hpp"
+
+#include <cstdint>
+#include <gtest/gtest.h>
+#include <vector>
+
+namespace flash {
+
+TEST(ZeroScanTest, DetectsAllZeroBuffers) {
+    std::vector<std::uint8_t> buf(8192, 0);
+    EXPECT_TRUE(IsAllZero(buf));
+    EXPECT_TRUE(IsAllZero({}));
+    buf[8191] = 1;
+    EXPECT_FALSE(IsAllZero(buf));
+    buf[8191] = 0;
+    buf[0] = 1;
+    EXPECT_FALSE(IsAllZero(buf));
+}
+
+TEST(ZeroScanTest, SplitsOnFileBlockBoundaries) {
+    // 3 blocks starting half-way into a block: [half][full][full][half]
+    std::vector<std::uint8_t> buf(3 * 4096, 0);
+    buf[100] = 1;         // first partial slice (file offsets 2048..4095)
+    buf[2048 + 4096] = 2; // third slice (file offsets 8192..12287)
+
+    std::vector<DataPiece> pieces;
+    SplitNonZero(buf, 2048, 4096, pieces);
+    ASSERT_EQ(pieces.size(), 2u);
+    EXPECT_EQ(pieces[0].offset, 2048u);
+    EXPECT_EQ(pieces[0].data.size(), 2048u);
+    EXPECT_EQ(pieces[1].offset, 8192u);
+    EXPECT_EQ(pieces[1].data.size(), 4096u);
+    EXPECT_EQ(pieces[1].data[0], 2);
+}
+
+TEST(ZeroScanTest, MergesAdjacentDataAndDisablesWithZeroBlock) {
+    std::vector<std::uint8_t> buf(4 * 4096, 7);
+    std::vector<DataPiece> pieces;
+    SplitNonZero(buf, 0, 4096, pieces);
+    ASSERT_EQ(pieces.size(), 1u);
+    EXPECT_EQ(pieces[0].data.size(), buf.size());
+
+    std::vector<std::uint8_t> zeros(4096, 0);
+    SplitNonZero(zeros, 0, 4096, pieces);
+    EXPECT_TRUE(pieces.empty());
+    SplitNonZero(zeros, 0, 0, pieces);
+    ASSERT_EQ(pieces.size(), 1u);
+}
+
+} // namespace flash
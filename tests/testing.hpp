@@ -47,6 +47,30 @@ class TemporaryDirectory {
     std::string path_;
 };
 
+// Sets an environment variable for the current scope and restores the previous value.
+class ScopedEnv {
+  public:
+    ScopedEnv(std::string name, const std::string& value) : name_(std::move(name)) {
+        if (const char* old = std::getenv(name_.c_str()))
+            old_ = old;
+        ::setenv(name_.c_str(), value.c_str(), 1);
+    }
+
+    ~ScopedEnv() {
+        if (old_)
+            ::setenv(name_.c_str(), old_->c_str(), 1);
+        else
+            ::unsetenv(name_.c_str());
+    }
+
+    ScopedEnv(const ScopedEnv&) = delete;
+    ScopedEnv& operator=(const ScopedEnv&) = delete;
+
+  private:
+    std::string name_;
+    std::optional<std::string> old_;
+};
+
 class MemoryReader final : public flash::IReader {
   public:
     explicit MemoryReader(std::string data) : data_(data.begin(), data.end()) {}
@@ -77,10 +101,17 @@ struct TarEntry {
     std::string path;
     std::string contents;
     mode_t file_type;
+    // Symlink target for AE_IFLNK, hardlink target for AE_IFREG.
+    std::string link_target = {};
+    mode_t perm = 0644;
+    time_t mtime = 0;
 };
 
 inline std::vector<std::uint8_t> BuildTar(const std::vector<TarEntry>& entries) {
-    std::vector<std::uint8_t> out(1024 * 1024);
+    size_t capacity = 1024 * 1024;
+    for (const auto& entry : entries)
+        capacity += entry.contents.size() + 4096;
+    std::vector<std::uint8_t> out(capacity);
     size_t used = 0;
 
     archive* a = archive_write_new();
@@ -103,7 +134,13 @@ inline std::vector<std::uint8_t> BuildTar(const std::vector<TarEntry>& entries)
         }
         archive_entry_set_pathname(hdr, entry.path.c_str());
         archive_entry_set_filetype(hdr, entry.file_type);
-        archive_entry_set_perm(hdr, 0644);
+        archive_entry_set_perm(hdr, entry.perm);
+        if (entry.mtime != 0)
+            archive_entry_set_mtime(hdr, entry.mtime, 0);
+        if (!entry.link_target.empty() && entry.file_type == AE_IFLNK)
+            archive_entry_set_symlink(hdr, entry.link_target.c_str());
+        else if (!entry.link_target.empty())
+            archive_entry_set_hardlink(hdr, entry.link_target.c_str());
         archive_entry_set_size(hdr, static_cast<la_int64_t>(entry.contents.size()));
         if (archive_write_header(a, hdr) != ARCHIVE_OK) {
             archive_entry_free(hdr);